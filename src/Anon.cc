@@ -14,6 +14,7 @@
 #include "ID.h"
 #include "IPAddr.h"
 #include "Event.h"
+#include "Hash.h"
 
 namespace zeek::detail {
 
@@ -59,18 +60,223 @@ static int bi_ffs(uint32_t value)
 
 #define first_n_bit_mask(n)	(~(0xFFFFFFFFU >> n))
 
-ipaddr32_t AnonymizeIPAddr::Anonymize(ipaddr32_t addr)
+using Addr6 = AnonymizeIPAddr_A50::Addr6;
+
+// Helpers for 128-bit addresses in host order. Bit positions count from
+// the most significant bit, starting at 1, like bi_ffs() does.
+
+static Addr6 to_addr6(const ipaddr128_t& a)
+	{
+	return {(uint64_t(ntohl(a[0])) << 32) | ntohl(a[1]),
+	        (uint64_t(ntohl(a[2])) << 32) | ntohl(a[3])};
+	}
+
+static ipaddr128_t from_addr6(const Addr6& a)
 	{
-	std::map<ipaddr32_t, ipaddr32_t>::iterator p = mapping.find(addr);
-	if ( p != mapping.end() )
-		return p->second;
+	return {htonl(a.hi >> 32), htonl(a.hi & 0xffffffff),
+	        htonl(a.lo >> 32), htonl(a.lo & 0xffffffff)};
+	}
+
+// The first n bits set.
+static Addr6 prefix_mask6(int n)
+	{
+	Addr6 m;
+	m.hi = n >= 64 ? ~uint64_t(0) : (n <= 0 ? 0 : ~uint64_t(0) << (64 - n));
+	m.lo = n >= 128 ? ~uint64_t(0) : (n <= 64 ? 0 : ~uint64_t(0) << (128 - n));
+	return m;
+	}
+
+// Only bit n set.
+static Addr6 bit6(int n)
+	{
+	Addr6 a = prefix_mask6(n);
+	Addr6 b = prefix_mask6(n - 1);
+	return {a.hi & ~b.hi, a.lo & ~b.lo};
+	}
+
+static int bi_ffs(const Addr6& value)
+	{
+	if ( value.hi )
+		return __builtin_clzll(value.hi) + 1;
+
+	if ( value.lo )
+		return 64 + __builtin_clzll(value.lo) + 1;
+
+	return 0;
+	}
+
+static Addr6 rand128()
+	{
+	uint64_t hi = (uint64_t(rand32()) << 32) | rand32();
+	uint64_t lo = (uint64_t(rand32()) << 32) | rand32();
+	return {hi, lo};
+	}
+
+// The following overloads let the mapping tree handle both address sizes.
+
+static int first_diff_bit(ipaddr32_t a, ipaddr32_t b)
+	{
+	return bi_ffs(a ^ b);
+	}
+
+static int first_diff_bit(const Addr6& a, const Addr6& b)
+	{
+	return bi_ffs(Addr6{a.hi ^ b.hi, a.lo ^ b.lo});
+	}
+
+static int bit_at(ipaddr32_t a, int pos)
+	{
+	return (a >> (32 - pos)) & 1;
+	}
+
+static int bit_at(const Addr6& a, int pos)
+	{
+	return pos <= 64 ? (a.hi >> (64 - pos)) & 1 : (a.lo >> (128 - pos)) & 1;
+	}
+
+static void init_special(ipaddr32_t* a, bool ones)
+	{
+	*a = ones ? 0xFFFFFFFFU : 0;
+	}
+
+static void init_special(Addr6* a, bool ones)
+	{
+	a->hi = a->lo = ones ? ~uint64_t(0) : 0;
+	}
+
+// Returns -1 for regular addresses, otherwise the index of the special
+// node for the all-zeroes or all-ones address.
+static int special_index(ipaddr32_t a)
+	{
+	return a == 0 ? 0 : (a == 0xFFFFFFFFU ? 1 : -1);
+	}
+
+static int special_index(const Addr6& a)
+	{
+	if ( a.hi == 0 && a.lo == 0 )
+		return 0;
+
+	if ( a.hi == ~uint64_t(0) && a.lo == ~uint64_t(0) )
+		return 1;
+
+	return -1;
+	}
+
+static void random_addr(ipaddr32_t* a)
+	{
+	*a = rand32();
+	}
+
+static void random_addr(Addr6* a)
+	{
+	*a = rand128();
+	}
+
+// -A50 anonymization: bits up to swivel are unchanged, bit swivel is
+// flipped, the remainder of bits are random.
+static ipaddr32_t make_output(ipaddr32_t old_output, int swivel)
+	{
+	if ( swivel == 32 )
+		return old_output ^ 1;
 	else
 		{
-		ipaddr32_t new_addr = anonymize(addr);
-		mapping[addr] = new_addr;
+		ipaddr32_t known_part =
+			((old_output >> (32 - swivel)) ^ 1) << (32 - swivel);
+
+		return known_part | ((rand32() & 0x7FFFFFFF) >> swivel);
+		}
+	}
+
+static Addr6 make_output(const Addr6& old_output, int swivel)
+	{
+	if ( swivel == 128 )
+		return {old_output.hi, old_output.lo ^ 1};
+
+	Addr6 keep = prefix_mask6(swivel - 1);
+	Addr6 flip = bit6(swivel);
+	Addr6 random = prefix_mask6(swivel);
+	Addr6 r = rand128();
+
+	return {(old_output.hi & keep.hi) | (~old_output.hi & flip.hi) | (r.hi & ~random.hi),
+	        (old_output.lo & keep.lo) | (~old_output.lo & flip.lo) | (r.lo & ~random.lo)};
+	}
+
+static uint64_t addr_hash(ipaddr32_t a)
+	{
+	return KeyedHash::Hash64(&a, sizeof(a));
+	}
+
+static uint64_t addr_hash(const ipaddr128_t& a)
+	{
+	return KeyedHash::Hash64(a.data(), sizeof(a));
+	}
+
+template <typename Addr>
+size_t AnonymizeIPAddr::Mapping<Addr>::Slot(const Addr& input) const
+	{
+	size_t mask = entries.size() - 1;
+	size_t i = addr_hash(input) & mask;
+
+	while ( entries[i].used && ! (entries[i].input == input) )
+		i = (i + 1) & mask;
+
+	return i;
+	}
+
+template <typename Addr>
+const Addr* AnonymizeIPAddr::Mapping<Addr>::Lookup(const Addr& input) const
+	{
+	if ( entries.empty() )
+		return nullptr;
+
+	const Entry& e = entries[Slot(input)];
+	return e.used ? &e.output : nullptr;
+	}
+
+template <typename Addr>
+void AnonymizeIPAddr::Mapping<Addr>::Insert(const Addr& input, const Addr& output)
+	{
+	// Keep the load factor at or below one half.
+	if ( (num_entries + 1) * 2 > entries.size() )
+		{
+		std::vector<Entry> old(entries.empty() ? 64 : entries.size() * 2);
+		old.swap(entries);
 
-		return new_addr;
+		for ( const auto& e : old )
+			if ( e.used )
+				entries[Slot(e.input)] = e;
 		}
+
+	Entry& e = entries[Slot(input)];
+
+	if ( ! e.used )
+		{
+		e.used = true;
+		e.input = input;
+		++num_entries;
+		}
+
+	e.output = output;
+	}
+
+ipaddr32_t AnonymizeIPAddr::Anonymize(ipaddr32_t addr)
+	{
+	if ( const ipaddr32_t* p = mapping.Lookup(addr) )
+		return *p;
+
+	ipaddr32_t new_addr = anonymize(addr);
+	mapping.Insert(addr, new_addr);
+	return new_addr;
+	}
+
+ipaddr128_t AnonymizeIPAddr::Anonymize(const ipaddr128_t& addr)
+	{
+	if ( const ipaddr128_t* p = mapping6.Lookup(addr) )
+		return *p;
+
+	ipaddr128_t new_addr = anonymize(addr);
+	mapping6.Insert(addr, new_addr);
+	return new_addr;
 	}
 
 // Keep the specified prefix unchanged.
@@ -80,6 +286,12 @@ bool AnonymizeIPAddr::PreservePrefix(ipaddr32_t /* input */, int /* num_bits */)
 	return false;
 	}
 
+bool AnonymizeIPAddr::PreservePrefix(const ipaddr128_t& /* input */, int /* num_bits */)
+	{
+	reporter->InternalError("prefix preserving is not supported for the anonymizer");
+	return false;
+	}
+
 bool AnonymizeIPAddr::PreserveNet(ipaddr32_t input)
 	{
 	switch ( addr_to_class(ntohl(input)) ) {
@@ -100,6 +312,12 @@ ipaddr32_t AnonymizeIPAddr_Seq::anonymize(ipaddr32_t /* input */)
 	return htonl(seq);
 	}
 
+ipaddr128_t AnonymizeIPAddr_Seq::anonymize(const ipaddr128_t& /* input */)
+	{
+	++seq6;
+	return from_addr6({0, seq6});
+	}
+
 ipaddr32_t AnonymizeIPAddr_RandomMD5::anonymize(ipaddr32_t input)
 	{
 	uint8_t digest[16];
@@ -113,6 +331,17 @@ ipaddr32_t AnonymizeIPAddr_RandomMD5::anonymize(ipaddr32_t input)
 	return output;
 	}
 
+ipaddr128_t AnonymizeIPAddr_RandomMD5::anonymize(const ipaddr128_t& input)
+	{
+	uint8_t digest[16];
+	ipaddr128_t output;
+
+	util::detail::hmac_md5(sizeof(input), (u_char*) input.data(), digest);
+	memcpy(output.data(), digest, sizeof(output));
+
+	return output;
+	}
+
 
 // This code is from "On the Design and Performance of Prefix-Preserving
 // IP Traffic Trace Anonymization", by Xu et al (IMW 2001)
@@ -145,218 +374,236 @@ ipaddr32_t AnonymizeIPAddr_PrefixMD5::anonymize(ipaddr32_t input)
 	return htonl(output);
 	}
 
-AnonymizeIPAddr_A50::~AnonymizeIPAddr_A50()
+ipaddr128_t AnonymizeIPAddr_PrefixMD5::anonymize(const ipaddr128_t& arg_input)
 	{
-	for ( auto& b : blocks )
-		delete [] b;
-	}
+	uint8_t digest[16];
+	Addr6 input = to_addr6(arg_input);
+	Addr6 output = input;
 
-void AnonymizeIPAddr_A50::init()
-	{
-	root = next_free_node = nullptr;
+	for ( int i = 0; i < 128; ++i )
+		{
+		// PAD(x_0 ... x_{i-1}) = x_0 ... x_{i-1} 1 0 ... 0 .
+		Addr6 mask = prefix_mask6(i);
+		Addr6 one = bit6(i + 1);
+		prefix6.len = htonl(i + 1);
+		prefix6.prefix = from_addr6({(input.hi & mask.hi) | one.hi,
+		                             (input.lo & mask.lo) | one.lo});
 
-	// Prepare special nodes for 0.0.0.0 and 255.255.255.255.
-	memset(&special_nodes[0], 0, sizeof(special_nodes));
-	special_nodes[0].input = special_nodes[0].output = 0;
-	special_nodes[1].input = special_nodes[1].output = 0xFFFFFFFF;
+		// HK(PAD(x_0 ... x_{i-1})).
+		util::detail::hmac_md5(sizeof(prefix6), (u_char*) &prefix6, digest);
 
-	method = 0;
-	before_anonymization = 1;
-	new_mapping = 0;
+		// x_i' = x_i ^ LSB(HK(PAD(x_0 ... x_{i-1}))).
+		if ( digest[0] & 1 )
+			{
+			output.hi ^= one.hi;
+			output.lo ^= one.lo;
+			}
+		}
+
+	return from_addr6(output);
 	}
 
-bool AnonymizeIPAddr_A50::PreservePrefix(ipaddr32_t input, int num_bits)
+template <typename Addr>
+AnonymizeIPAddr_A50::Tree<Addr>::Tree()
 	{
-	DEBUG_MSG("%s/%d\n",
-			IPAddr(IPv4, &input, IPAddr::Network).AsString().c_str(),
-			num_bits);
+	root = NIL;
 
-	if ( ! before_anonymization )
+	// Prepare special nodes for the all-zeroes and all-ones addresses.
+	for ( int i = 0; i < 2; ++i )
 		{
-		reporter->Error("prefix perservation specified after anonymization begun");
-		return false;
+		init_special(&special_nodes[i].input, i == 1);
+		special_nodes[i].output = special_nodes[i].input;
+		special_nodes[i].child[0] = special_nodes[i].child[1] = NIL;
 		}
+	}
 
-	input = ntohl(input);
+template <typename Addr>
+uint32_t AnonymizeIPAddr_A50::Tree<Addr>::NewNode()
+	{
+	nodes.emplace_back();
+	return nodes.size() - 1;
+	}
 
-	// Sanitize input.
-	input = input & first_n_bit_mask(num_bits);
+template <typename Addr>
+uint32_t AnonymizeIPAddr_A50::Tree<Addr>::MakePeer(const Addr& a, uint32_t n)
+	{
+	if ( special_index(a) >= 0 )
+		reporter->InternalError("all-zeroes and all-ones addresses should never get into the tree");
+
+	// Become a peer.
+	// Algorithm: create two nodes, the two peers.  Leave orig node as
+	// the parent of the two new ones.
 
-	Node* n = find_node(input);
+	uint32_t down[2];
+	down[0] = NewNode();
+	down[1] = NewNode();
 
-	// Preserve the first num_bits bits of addr.
-	if ( num_bits == 32 )
-		n->output = input;
+	// swivel is first bit 'a' and 'old->input' differ.
+	int swivel = first_diff_bit(a, nodes[n].input);
 
-	else if ( num_bits > 0 )
-		{
-		assert((0xFFFFFFFFU >> 1) == 0x7FFFFFFFU);
-		uint32_t suffix_mask = (0xFFFFFFFFU >> num_bits);
-		uint32_t prefix_mask = ~suffix_mask;
-		n->output = (input & prefix_mask) | (rand32() & suffix_mask);
-		}
+	// bitvalue is the value of that bit of 'a'.
+	int bitvalue = bit_at(a, swivel);
 
-	return true;
+	Node& peer = nodes[down[bitvalue]];
+	peer.input = a;
+	peer.output = make_output(nodes[n].output, swivel);
+	peer.child[0] = peer.child[1] = NIL;
+
+	nodes[down[1 - bitvalue]] = nodes[n];	// copy orig node down one level
+
+	Node& orig = nodes[n];
+	orig.input = nodes[down[1]].input;	// NB: 1s to the right (0s to the left)
+	orig.output = nodes[down[1]].output;
+	orig.child[0] = down[0];		// point to children
+	orig.child[1] = down[1];
+
+	return down[bitvalue];
 	}
 
-ipaddr32_t AnonymizeIPAddr_A50::anonymize(ipaddr32_t a)
+template <typename Addr>
+typename AnonymizeIPAddr_A50::Tree<Addr>::Node* AnonymizeIPAddr_A50::Tree<Addr>::Find(const Addr& a)
 	{
-	before_anonymization = 0;
-	new_mapping = 0;
+	// Watch out for special IP addresses, which never make it
+	// into the tree.
+	int special = special_index(a);
+	if ( special >= 0 )
+		return &special_nodes[special];
 
-	if ( Node* n = find_node(ntohl(a)) )
+	if ( root == NIL )
 		{
-		ipaddr32_t output = htonl(n->output);
-		return output;
-		}
-	else
-		return 0;
-	}
+		root = NewNode();
+		nodes[root].input = a;
+		random_addr(&nodes[root].output);
+		nodes[root].child[0] = nodes[root].child[1] = NIL;
 
-AnonymizeIPAddr_A50::Node* AnonymizeIPAddr_A50::new_node_block()
-	{
-	assert(! next_free_node);
+		return &nodes[root];
+		}
 
-	int block_size = 1024;
-	Node* block = new Node[block_size];
-	if ( ! block )
-		reporter->InternalError("out of memory!");
+	// Straight from tcpdpriv. Nodes are referred to by index, since
+	// adding peers may move the array.
+	uint32_t n = root;
 
-	blocks.push_back(block);
+	for ( ;; )
+		{
+		const Node& node = nodes[n];
 
-	for ( int i = 1; i < block_size - 1; ++i )
-		block[i].child[0] = &block[i+1];
+		if ( node.input == a )
+			return &nodes[n];
 
-	block[block_size - 1].child[0] = nullptr;
-	next_free_node = &block[1];
+		if ( node.child[0] == NIL )
+			n = MakePeer(a, n);
 
-	return &block[0];
-	}
+		else
+			{
+			// swivel is the first bit in which the two children
+			// differ.
+			int swivel = first_diff_bit(nodes[node.child[0]].input,
+			                            nodes[node.child[1]].input);
 
-inline AnonymizeIPAddr_A50::Node* AnonymizeIPAddr_A50::new_node()
-	{
-	new_mapping = 1;
+			if ( first_diff_bit(a, node.input) < swivel )
+				// Input differs earlier.
+				n = MakePeer(a, n);
 
-	if ( next_free_node )
-		{
-		Node* n = next_free_node;
-		next_free_node = n->child[0];
-		return n;
+			else
+				n = node.child[bit_at(a, swivel)];
+			}
 		}
-	else
-		return new_node_block();
 	}
 
-inline void AnonymizeIPAddr_A50::free_node(Node *n)
+AnonymizeIPAddr_A50::AnonymizeIPAddr_A50()
 	{
-	n->child[0] = next_free_node;
-	next_free_node = n;
+	init();
 	}
 
-ipaddr32_t AnonymizeIPAddr_A50::make_output(ipaddr32_t old_output, int swivel) const
+AnonymizeIPAddr_A50::~AnonymizeIPAddr_A50()
 	{
-	// -A50 anonymization
-	if ( swivel == 32 )
-		return old_output ^ 1;
-	else
-		{
-		// Bits up to swivel are unchanged; bit swivel is flipped.
-		ipaddr32_t known_part =
-			((old_output >> (32 - swivel)) ^ 1) << (32 - swivel);
-
-		// Remainder of bits are random.
-		return known_part | ((rand32() & 0x7FFFFFFF) >> swivel);
-		}
 	}
 
-AnonymizeIPAddr_A50::Node* AnonymizeIPAddr_A50::make_peer(ipaddr32_t a, Node* n)
+void AnonymizeIPAddr_A50::init()
 	{
-	if ( a == 0 || a == 0xFFFFFFFFU )
-		reporter->InternalError("0.0.0.0 and 255.255.255.255 should never get into the tree");
-
-	// Become a peer.
-	// Algorithm: create two nodes, the two peers.  Leave orig node as
-	// the parent of the two new ones.
-
-	Node* down[2];
+	method = 0;
+	before_anonymization = 1;
+	}
 
-	if ( ! (down[0] = new_node()) )
-		return nullptr;
+bool AnonymizeIPAddr_A50::PreservePrefix(ipaddr32_t input, int num_bits)
+	{
+	DEBUG_MSG("%s/%d\n",
+			IPAddr(IPv4, &input, IPAddr::Network).AsString().c_str(),
+			num_bits);
 
-	if ( ! (down[1] = new_node()) )
+	if ( ! before_anonymization )
 		{
-		free_node(down[0]);
-		return nullptr;
+		reporter->Error("prefix perservation specified after anonymization begun");
+		return false;
 		}
 
-	// swivel is first bit 'a' and 'old->input' differ.
-	int swivel = bi_ffs(a ^ n->input);
+	input = ntohl(input);
 
-	// bitvalue is the value of that bit of 'a'.
-	int bitvalue = (a >> (32 - swivel)) & 1;
+	// Sanitize input.
+	if ( num_bits < 32 )
+		input = input & first_n_bit_mask(num_bits);
 
-	down[bitvalue]->input = a;
-	down[bitvalue]->output = make_output(n->output, swivel);
-	down[bitvalue]->child[0] = down[bitvalue]->child[1] = nullptr;
+	auto n = tree.Find(input);
 
-	*down[1 - bitvalue] = *n;	// copy orig node down one level
+	// Preserve the first num_bits bits of addr.
+	if ( num_bits >= 32 )
+		n->output = input;
 
-	n->input = down[1]->input;	// NB: 1s to the right (0s to the left)
-	n->output = down[1]->output;
-	n->child[0] = down[0];		// point to children
-	n->child[1] = down[1];
+	else if ( num_bits > 0 )
+		{
+		assert((0xFFFFFFFFU >> 1) == 0x7FFFFFFFU);
+		uint32_t suffix_mask = (0xFFFFFFFFU >> num_bits);
+		uint32_t prefix_mask = ~suffix_mask;
+		n->output = (input & prefix_mask) | (rand32() & suffix_mask);
+		}
 
-	return down[bitvalue];
+	return true;
 	}
 
-AnonymizeIPAddr_A50::Node* AnonymizeIPAddr_A50::find_node(ipaddr32_t a)
+bool AnonymizeIPAddr_A50::PreservePrefix(const ipaddr128_t& arg_input, int num_bits)
 	{
-	// Watch out for special IP addresses, which never make it
-	// into the tree.
-	if ( a == 0 || a == 0xFFFFFFFFU )
-		return &special_nodes[a & 1];
+	DEBUG_MSG("%s/%d\n",
+			IPAddr(IPv6, arg_input.data(), IPAddr::Network).AsString().c_str(),
+			num_bits);
 
-	if ( ! root )
+	if ( ! before_anonymization )
 		{
-		root = new_node();
-		root->input = a;
-		root->output = rand32();
-		root->child[0] = root->child[1] = nullptr;
-
-		return root;
+		reporter->Error("prefix perservation specified after anonymization begun");
+		return false;
 		}
 
-	// Straight from tcpdpriv.
-	Node* n = root;
-	while ( n )
-		{
-		if ( n->input == a )
-			return n;
+	// Sanitize input.
+	Addr6 prefix_mask = prefix_mask6(num_bits);
+	Addr6 input = to_addr6(arg_input);
+	input.hi &= prefix_mask.hi;
+	input.lo &= prefix_mask.lo;
 
-		if ( ! n->child[0] )
-			n = make_peer(a, n);
+	auto n = tree6.Find(input);
 
-		else
-			{
-			// swivel is the first bit in which the two children
-			// differ.
-			int swivel =
-				bi_ffs(n->child[0]->input ^ n->child[1]->input);
+	// Preserve the first num_bits bits of addr.
+	if ( num_bits >= 128 )
+		n->output = input;
 
-			if ( bi_ffs(a ^ n->input) < swivel )
-				// Input differs earlier.
-				n = make_peer(a, n);
+	else if ( num_bits > 0 )
+		{
+		Addr6 r = rand128();
+		n->output = {input.hi | (r.hi & ~prefix_mask.hi),
+		             input.lo | (r.lo & ~prefix_mask.lo)};
+		}
 
-			else if ( a & (1 << (32 - swivel)) )
-				n = n->child[1];
+	return true;
+	}
 
-			else
-				n = n->child[0];
-			}
-		}
+ipaddr32_t AnonymizeIPAddr_A50::anonymize(ipaddr32_t a)
+	{
+	before_anonymization = 0;
+	return htonl(tree.Find(ntohl(a))->output);
+	}
 
-	reporter->InternalError("out of memory!");
-	return nullptr;
+ipaddr128_t AnonymizeIPAddr_A50::anonymize(const ipaddr128_t& a)
+	{
+	before_anonymization = 0;
+	return from_addr6(tree6.Find(to_addr6(a))->output);
 	}
 
 static TableValPtr anon_preserve_orig_addr;
@@ -387,11 +634,12 @@ void init_ip_addr_anonymizers()
 		anon_preserve_other_addr = cast_intrusive<TableVal>(id->GetVal());
 	}
 
-ipaddr32_t anonymize_ip(ipaddr32_t ip, enum ip_addr_anonymization_class_t cl)
+// Returns the anonymizer to use for an address of the given class, or
+// null if the address is to be kept as is.
+static AnonymizeIPAddr* get_anonymizer(const AddrValPtr& addr,
+                                       enum ip_addr_anonymization_class_t cl)
 	{
 	TableVal* preserve_addr = nullptr;
-	auto addr = make_intrusive<AddrVal>(ip);
-
 	int method = -1;
 
 	switch ( cl ) {
@@ -411,25 +659,39 @@ ipaddr32_t anonymize_ip(ipaddr32_t ip, enum ip_addr_anonymization_class_t cl)
 		break;
 	}
 
-	ipaddr32_t new_ip = 0;
-
 	if ( preserve_addr && preserve_addr->FindOrDefault(addr) )
-		new_ip = ip;
+		return nullptr;
 
-	else if ( method >= 0 && method < NUM_ADDR_ANONYMIZATION_METHODS )
+	if ( method < 0 || method >= NUM_ADDR_ANONYMIZATION_METHODS )
 		{
-		if ( method == KEEP_ORIG_ADDR )
-			new_ip = ip;
+		reporter->InternalError("invalid IP anonymization method");
+		return nullptr;
+		}
 
-		else if ( ! ip_anonymizer[method] )
-			reporter->InternalError("IP anonymizer not initialized");
+	if ( method == KEEP_ORIG_ADDR )
+		return nullptr;
 
-		else
-			new_ip = ip_anonymizer[method]->Anonymize(ip);
-		}
+	if ( ! ip_anonymizer[method] )
+		reporter->InternalError("IP anonymizer not initialized");
 
-	else
-		reporter->InternalError("invalid IP anonymization method");
+	return ip_anonymizer[method];
+	}
+
+ipaddr32_t anonymize_ip(ipaddr32_t ip, enum ip_addr_anonymization_class_t cl)
+	{
+	auto anonymizer = get_anonymizer(make_intrusive<AddrVal>(ip), cl);
+	ipaddr32_t new_ip = anonymizer ? anonymizer->Anonymize(ip) : ip;
+
+#ifdef LOG_ANONYMIZATION_MAPPING
+	log_anonymization_mapping(ip, new_ip);
+#endif
+	return new_ip;
+	}
+
+ipaddr128_t anonymize_ip(const ipaddr128_t& ip, enum ip_addr_anonymization_class_t cl)
+	{
+	auto anonymizer = get_anonymizer(make_intrusive<AddrVal>(ip.data()), cl);
+	ipaddr128_t new_ip = anonymizer ? anonymizer->Anonymize(ip) : ip;
 
 #ifdef LOG_ANONYMIZATION_MAPPING
 	log_anonymization_mapping(ip, new_ip);
@@ -448,6 +710,15 @@ void log_anonymization_mapping(ipaddr32_t input, ipaddr32_t output)
 		);
 	}
 
+void log_anonymization_mapping(const ipaddr128_t& input, const ipaddr128_t& output)
+	{
+	if ( anonymization_mapping )
+		event_mgr.Enqueue(anonymization_mapping,
+		                  make_intrusive<AddrVal>(input.data()),
+		                  make_intrusive<AddrVal>(output.data())
+		);
+	}
+
 #endif
 
 } // namespace zeek::detail
@@ -10,8 +10,9 @@
 
 #pragma once
 
+#include <array>
 #include <vector>
-#include <map>
+#include <cstddef>
 #include <cstdint>
 
 namespace zeek::detail {
@@ -35,6 +36,7 @@ enum ip_addr_anonymization_method_t {
 };
 
 typedef uint32_t ipaddr32_t;
+typedef std::array<uint32_t, 4> ipaddr128_t;
 
 // NOTE: all addresses in parameters of *public* functions are in
 // network order.
@@ -44,80 +46,130 @@ public:
 	virtual ~AnonymizeIPAddr() = default;
 
 	ipaddr32_t Anonymize(ipaddr32_t addr);
+	ipaddr128_t Anonymize(const ipaddr128_t& addr);
 
 	virtual bool PreservePrefix(ipaddr32_t input, int num_bits);
+	virtual bool PreservePrefix(const ipaddr128_t& input, int num_bits);
 
 	virtual ipaddr32_t anonymize(ipaddr32_t addr) = 0;
+	virtual ipaddr128_t anonymize(const ipaddr128_t& addr) = 0;
 
 	bool PreserveNet(ipaddr32_t input);
 
 protected:
-	std::map<ipaddr32_t, ipaddr32_t> mapping;
+	// An open-addressed table memoizing the anonymized addresses.
+	template <typename Addr>
+	class Mapping {
+	public:
+		const Addr* Lookup(const Addr& input) const;
+		void Insert(const Addr& input, const Addr& output);
+
+	private:
+		struct Entry {
+			Addr input;
+			Addr output;
+			bool used;
+		};
+
+		size_t Slot(const Addr& input) const;
+
+		std::vector<Entry> entries;
+		size_t num_entries = 0;
+	};
+
+	Mapping<ipaddr32_t> mapping;
+	Mapping<ipaddr128_t> mapping6;
 };
 
 class AnonymizeIPAddr_Seq : public AnonymizeIPAddr {
 public:
-	AnonymizeIPAddr_Seq()	{ seq = 1; }
+	AnonymizeIPAddr_Seq()	{ seq = 1; seq6 = 0; }
 	ipaddr32_t anonymize(ipaddr32_t addr) override;
+	ipaddr128_t anonymize(const ipaddr128_t& addr) override;
 
 protected:
 	ipaddr32_t seq;
+	uint64_t seq6;
 };
 
 class AnonymizeIPAddr_RandomMD5 : public AnonymizeIPAddr {
 public:
 	ipaddr32_t anonymize(ipaddr32_t addr) override;
+	ipaddr128_t anonymize(const ipaddr128_t& addr) override;
 };
 
 class AnonymizeIPAddr_PrefixMD5 : public AnonymizeIPAddr {
 public:
 	ipaddr32_t anonymize(ipaddr32_t addr) override;
+	ipaddr128_t anonymize(const ipaddr128_t& addr) override;
 
 protected:
 	struct anon_prefix {
 		int len;
 		ipaddr32_t prefix;
 	} prefix;
+
+	struct anon_prefix6 {
+		int len;
+		ipaddr128_t prefix;
+	} prefix6;
 };
 
 class AnonymizeIPAddr_A50 : public AnonymizeIPAddr {
 public:
-	AnonymizeIPAddr_A50()	{ init(); }
+	AnonymizeIPAddr_A50();
 	~AnonymizeIPAddr_A50() override;
 
 	ipaddr32_t anonymize(ipaddr32_t addr) override;
+	ipaddr128_t anonymize(const ipaddr128_t& addr) override;
 	bool PreservePrefix(ipaddr32_t input, int num_bits) override;
+	bool PreservePrefix(const ipaddr128_t& input, int num_bits) override;
 
-protected:
-	struct Node {
-		ipaddr32_t input;
-		ipaddr32_t output;
-		Node* child[2];
+	// An IPv6 address as a 128-bit number, in host order.
+	struct Addr6 {
+		uint64_t hi;
+		uint64_t lo;
+
+		bool operator==(const Addr6& other) const
+			{ return hi == other.hi && lo == other.lo; }
 	};
 
-	int method;
-	int before_anonymization;
-	int new_mapping;
+protected:
+	// The prefix preserving mapping tree. Its nodes live in one array
+	// and refer to their children by index.
+	template <typename Addr>
+	class Tree {
+	public:
+		struct Node {
+			Addr input;
+			Addr output;
+			uint32_t child[2];
+		};
 
-	// The root of prefix preserving mapping tree.
-	Node* root;
+		Tree();
 
-	// A node pool for new_node.
-	Node* next_free_node;
-	std::vector<Node*> blocks;
+		Node* Find(const Addr& a);
 
-	// for 0.0.0.0 and 255.255.255.255.
-	Node special_nodes[2];
+	private:
+		static constexpr uint32_t NIL = UINT32_MAX;
 
-	void init();
+		uint32_t NewNode();
+		uint32_t MakePeer(const Addr& a, uint32_t n);
+
+		std::vector<Node> nodes;
+		uint32_t root;
+
+		// for the all-zeroes and all-ones addresses.
+		Node special_nodes[2];
+	};
 
-	Node* new_node();
-	Node* new_node_block();
-	void free_node(Node*);
+	int method;
+	int before_anonymization;
 
-	ipaddr32_t make_output(ipaddr32_t, int) const;
-	Node* make_peer(ipaddr32_t, Node*);
-	Node* find_node(ipaddr32_t);
+	Tree<ipaddr32_t> tree;
+	Tree<Addr6> tree6;
+
+	void init();
 };
 
 // The global IP anonymizers.
@@ -125,8 +177,10 @@ extern AnonymizeIPAddr* ip_anonymizer[NUM_ADDR_ANONYMIZATION_METHODS];
 
 void init_ip_addr_anonymizers();
 ipaddr32_t anonymize_ip(ipaddr32_t ip, enum ip_addr_anonymization_class_t cl);
+ipaddr128_t anonymize_ip(const ipaddr128_t& ip, enum ip_addr_anonymization_class_t cl);
 
 #define LOG_ANONYMIZATION_MAPPING
 void log_anonymization_mapping(ipaddr32_t input, ipaddr32_t output);
+void log_anonymization_mapping(const ipaddr128_t& input, const ipaddr128_t& output);
 
 } // namespace zeek::detail
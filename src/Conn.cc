@@ -19,6 +19,7 @@
 #include "TunnelEncapsulation.h"
 #include "analyzer/Analyzer.h"
 #include "analyzer/Manager.h"
+#include "telemetry/Latency.h"
 #include "iosource/IOSource.h"
 
 namespace zeek {
@@ -81,6 +82,7 @@ Connection::Connection(NetSessions* s, const detail::ConnIDKey& k, double t,
 	saw_first_orig_packet = 1;
 	saw_first_resp_packet = 0;
 	is_successful = false;
+	conn_val_dirty = CONN_VAL_ALL;
 
 	if ( pkt->l2_src )
 		memcpy(orig_l2_addr, pkt->l2_src, sizeof(orig_l2_addr));
@@ -200,6 +202,8 @@ void Connection::NextPacket(double t, bool is_orig,
 	if ( Skipping() )
 		return;
 
+	telemetry::LatencyTimer latency(telemetry::StageLatency(telemetry::Stage::Connection));
+
 	if ( root_analyzer )
 		{
 		auto was_successful = is_successful;
@@ -209,14 +213,14 @@ void Connection::NextPacket(double t, bool is_orig,
 		record_packet = record_current_packet;
 		record_content = record_current_content;
 
-		if ( ConnTransport() != TRANSPORT_TCP )
-			is_successful = true;
+		if ( ConnTransport() != TRANSPORT_TCP && ! is_successful )
+			SetSuccessful();
 
 		if ( ! was_successful && is_successful && connection_successful )
 			EnqueueEvent(connection_successful, nullptr, ConnVal());
 		}
 	else
-		last_time = t;
+		SetLastTime(t);
 
 	run_state::current_timestamp = 0;
 	run_state::current_pkt = nullptr;
@@ -402,15 +406,25 @@ const RecordValPtr& Connection::ConnVal()
 		if ( inner_vlan != 0 )
 			conn_val->Assign(10, val_mgr->Int(inner_vlan));
 
+		conn_val_dirty = CONN_VAL_ALL;
 		}
 
 	if ( root_analyzer )
 		root_analyzer->UpdateConnVal(conn_val.get());
 
-	conn_val->Assign(3, make_intrusive<TimeVal>(start_time));	// ###
-	conn_val->Assign(4, make_intrusive<IntervalVal>(last_time - start_time));
-	conn_val->Assign(6, make_intrusive<StringVal>(history.c_str()));
-	conn_val->Assign(11, val_mgr->Bool(is_successful));
+	if ( conn_val_dirty & CONN_VAL_TIMES )
+		{
+		conn_val->Assign(3, make_intrusive<TimeVal>(start_time));	// ###
+		conn_val->Assign(4, make_intrusive<IntervalVal>(last_time - start_time));
+		}
+
+	if ( conn_val_dirty & CONN_VAL_HISTORY )
+		conn_val->Assign(6, make_intrusive<StringVal>(history.c_str()));
+
+	if ( conn_val_dirty & CONN_VAL_SUCCESSFUL )
+		conn_val->Assign(11, val_mgr->Bool(is_successful));
+
+	conn_val_dirty = 0;
 
 	conn_val->SetOrigin(this);
 
@@ -440,6 +454,10 @@ void Connection::AppendAddl(const char* str)
 	const char* format = *old ? "%s %s" : "%s%s";
 
 	cv->Assign(6, make_intrusive<StringVal>(util::fmt(format, old, str)));
+
+	// As before, the next update of the record replaces this with the
+	// history.
+	conn_val_dirty |= CONN_VAL_HISTORY;
 	}
 
 // Returns true if the character at s separates a version number.
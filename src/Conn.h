@@ -16,6 +16,7 @@
 #include "WeirdState.h"
 #include "ZeekArgs.h"
 #include "IntrusivePtr.h"
+#include "ObjectPool.h"
 #include "iosource/Packet.h"
 
 #include "analyzer/Tag.h"
@@ -62,7 +63,7 @@ static inline int addr_port_canon_lt(const IPAddr& addr1, uint32_t p1,
 	return addr1 < addr2 || (addr1 == addr2 && p1 < p2);
 	}
 
-class Connection final : public Obj {
+class Connection final : public Obj, public detail::PoolAllocated<Connection> {
 public:
 	Connection(NetSessions* s, const detail::ConnIDKey& k, double t, const ConnID* id,
 	           uint32_t flow, const Packet* pkt, const EncapsulationStack* arg_encap);
@@ -105,9 +106,11 @@ public:
 	bool IsKeyValid() const			{ return key_valid; }
 
 	double StartTime() const		{ return start_time; }
-	void SetStartTime(double t)		{ start_time = t; }
+	void SetStartTime(double t)
+		{ start_time = t; conn_val_dirty |= CONN_VAL_TIMES; }
 	double LastTime() const			{ return last_time; }
-	void SetLastTime(double t) 		{ last_time = t; }
+	void SetLastTime(double t)
+		{ last_time = t; conn_val_dirty |= CONN_VAL_TIMES; }
 
 	const IPAddr& OrigAddr() const		{ return orig_addr; }
 	const IPAddr& RespAddr() const		{ return resp_addr; }
@@ -124,7 +127,8 @@ public:
 	TransportProto ConnTransport() const { return proto; }
 
 	bool IsSuccessful() const	{ return is_successful; };
-	void SetSuccessful()	{ is_successful = true; }
+	void SetSuccessful()
+		{ is_successful = true; conn_val_dirty |= CONN_VAL_SUCCESSFUL; }
 
 	// True if we should record subsequent packets (either headers or
 	// in their entirety, depending on record_contents).  We still
@@ -296,7 +300,8 @@ public:
 	void HistoryThresholdEvent(EventHandlerPtr e, bool is_orig,
 	                           uint32_t threshold);
 
-	void AddHistory(char code)	{ history += code; }
+	void AddHistory(char code)
+		{ history += code; conn_val_dirty |= CONN_VAL_HISTORY; }
 
 	void DeleteTimer(double t);
 
@@ -357,6 +362,18 @@ protected:
 	double start_time, last_time;
 	double inactivity_timeout;
 	RecordValPtr conn_val;
+
+	// Fields of conn_val that have changed since it was last updated.
+	// Updating them only then saves creating new values for each event
+	// referring to the connection.
+	enum {
+		CONN_VAL_TIMES = 0x1,	// start_time and duration
+		CONN_VAL_HISTORY = 0x2,
+		CONN_VAL_SUCCESSFUL = 0x4,
+		CONN_VAL_ALL = 0x7,
+	};
+
+	unsigned int conn_val_dirty;
 	LoginConn* login_conn;	// either nil, or this
 	const EncapsulationStack* encapsulation; // tunnels
 	int suppress_event;	// suppress certain events to once per conn.
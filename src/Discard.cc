@@ -13,6 +13,7 @@
 #include "Val.h"
 #include "IP.h"
 #include "Reporter.h" // for InterpreterException
+#include "iosource/BPF_Program.h"
 
 namespace zeek::detail {
 
@@ -24,6 +25,20 @@ Discarder::Discarder()
 	check_icmp = id::find_func("discarder_check_icmp");
 
 	discarder_maxlen = static_cast<int>(id::find_val("discarder_maxlen")->AsCount());
+
+	const auto& filter_val = id::find_val("discarder_filter");
+	const char* filter_str = filter_val ? filter_val->AsString()->CheckString() : "";
+
+	if ( *filter_str )
+		{
+		char errbuf[PCAP_ERRBUF_SIZE];
+		filter = std::make_unique<zeek::iosource::detail::BPF_Program>();
+
+		if ( ! filter->Compile(IP_MAXPACKET, DLT_RAW, filter_str, 0,
+		                       errbuf, sizeof(errbuf)) )
+			reporter->FatalError("cannot compile discarder_filter '%s': %s",
+			                     filter_str, errbuf);
+		}
 	}
 
 Discarder::~Discarder()
@@ -32,13 +47,27 @@ Discarder::~Discarder()
 
 bool Discarder::IsActive()
 	{
-	return check_ip || check_tcp || check_udp || check_icmp;
+	return filter || check_ip || check_tcp || check_udp || check_icmp;
 	}
 
 bool Discarder::NextPacket(const IP_Hdr* ip, int len, int caplen)
 	{
 	bool discard_packet = false;
 
+	if ( filter )
+		{
+		const u_char* data = ip->IP4_Hdr() ?
+			reinterpret_cast<const u_char*>(ip->IP4_Hdr()) :
+			reinterpret_cast<const u_char*>(ip->IP6_Hdr());
+
+		struct pcap_pkthdr hdr;
+		hdr.caplen = caplen;
+		hdr.len = len;
+
+		if ( pcap_offline_filter(filter->GetProgram(), &hdr, data) )
+			return true;
+		}
+
 	if ( check_ip )
 		{
 		zeek::Args args{ip->ToPktHdrVal()};
@@ -4,12 +4,16 @@
 
 #include <sys/types.h> // for u_char
 
+#include <memory>
+
 #include "IntrusivePtr.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(IP_Hdr, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Func, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
 
+namespace zeek::iosource::detail { class BPF_Program; }
+
 namespace zeek {
 using FuncPtr = IntrusivePtr<Func>;
 
@@ -32,6 +36,9 @@ protected:
 	FuncPtr check_udp;
 	FuncPtr check_icmp;
 
+	// Compiled from discarder_filter, if set.
+	std::unique_ptr<zeek::iosource::detail::BPF_Program> filter;
+
 	// Maximum amount of application data passed to filtering functions.
 	int discarder_maxlen;
 };
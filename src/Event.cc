@@ -12,6 +12,7 @@
 #include "iosource/Manager.h"
 #include "iosource/PktSrc.h"
 #include "RunState.h"
+#include "telemetry/Latency.h"
 
 zeek::EventMgr zeek::event_mgr;
 zeek::EventMgr& mgr = zeek::event_mgr;
@@ -163,6 +164,7 @@ void EventMgr::Drain()
 		Enqueue(event_queue_flush_point, Args{});
 
 	detail::SegmentProfiler prof(detail::segment_logger, "draining-events");
+	telemetry::LatencyTimer latency(telemetry::StageLatency(telemetry::Stage::EventDrain));
 
 	PLUGIN_HOOK_VOID(HOOK_DRAIN_EVENTS, HookDrainEvents());
 
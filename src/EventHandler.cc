@@ -9,6 +9,7 @@
 
 #include "broker/Manager.h"
 #include "broker/Data.h"
+#include "telemetry/Manager.h"
 
 namespace zeek {
 
@@ -58,6 +59,15 @@ void EventHandler::Call(Args* vl, bool no_remote)
 	DEBUG_MSG("Event: %s\n", Name());
 #endif
 
+	if ( ! call_counter && telemetry_mgr )
+		call_counter = telemetry_mgr->CounterInstance(
+			"zeek_event_handler_invocations_total",
+			"Invocations of event handlers, by event.",
+			{{"name", name}});
+
+	if ( call_counter )
+		call_counter->Inc();
+
 	if ( new_event )
 		NewEvent(vl);
 
@@ -10,6 +10,7 @@
 #include <string>
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Func, zeek);
+namespace zeek::telemetry { class Counter; }
 
 namespace zeek {
 using FuncPtr = IntrusivePtr<Func>;
@@ -79,6 +80,9 @@ private:
 	bool generate_always;
 
 	std::unordered_set<std::string> auto_publish;
+
+	// Counts invocations, created on the first one.
+	telemetry::Counter* call_counter = nullptr;
 };
 
 // Encapsulates a ptr to an event handler to overload the boolean operator.
@@ -2,6 +2,8 @@
 
 #include "zeek-config.h"
 
+#include <algorithm>
+
 #include "Frag.h"
 #include "Hash.h"
 #include "IP.h"
@@ -13,6 +15,10 @@
 constexpr uint32_t MIN_ACCEPTABLE_FRAG_SIZE = 64;
 constexpr uint32_t MAX_ACCEPTABLE_FRAG_SIZE = 64000;
 
+// The most payload any IP datagram can carry. Data beyond it is dropped,
+// so that the datagram never reassembles.
+constexpr uint32_t MAX_FRAG_DATA = 65535;
+
 namespace zeek::detail {
 
 FragTimer::~FragTimer()
@@ -32,7 +38,6 @@ void FragTimer::Dispatch(double t, bool /* is_expire */)
 FragReassembler::FragReassembler(NetSessions* arg_s,
                                  const IP_Hdr* ip, const u_char* pkt,
                                  const FragReassemblerKey& k, double t)
-	: Reassembler(0, REASSEM_FRAG)
 	{
 	s = arg_s;
 	key = k;
@@ -72,6 +77,8 @@ FragReassembler::~FragReassembler()
 	DeleteTimer();
 	delete [] proto_hdr;
 	delete reassembled_pkt;
+	delete [] buffer;
+	Reassembler::AdjustMemoryAllocation(REASSEM_FRAG, -int64_t(memory_allocation));
 	}
 
 void FragReassembler::AddFragment(double t, const IP_Hdr* ip, const u_char* pkt)
@@ -151,11 +158,114 @@ void FragReassembler::AddFragment(double t, const IP_Hdr* ip, const u_char* pkt)
 	// Do we need to check for consistent options?  That's tricky
 	// for things like LSRR that get modified in route.
 
+	if ( reassembled_pkt )
+		// The datagram is complete already, and its buffer now
+		// belongs to the reassembled packet.
+		return;
+
 	// Remove header.
 	pkt += hdr_len;
 	len -= hdr_len;
 
-	NewBlock(run_state::network_time, offset, len, pkt);
+	if ( offset + len > MAX_FRAG_DATA )
+		len = MAX_FRAG_DATA - offset;
+
+	NewBlock(offset, len, pkt);
+	}
+
+void FragReassembler::NewBlock(uint32_t seq, uint32_t len, const u_char* data)
+	{
+	if ( len == 0 )
+		return;
+
+	uint32_t upper = seq + len;
+
+	CheckOverlap(seq, upper, data);
+	Reserve(upper);
+
+	u_char* payload = buffer + proto_hdr_len;
+
+	// The blocks that overlap the new data or abut it, [i, j). All of
+	// them merge with it into a single block.
+	auto first = std::partition_point(blocks.begin(), blocks.end(),
+	                                  [seq](const Block& b) { return b.upper < seq; });
+	auto last = std::partition_point(first, blocks.end(),
+	                                 [upper](const Block& b) { return b.seq <= upper; });
+	size_t i = first - blocks.begin();
+	size_t j = last - blocks.begin();
+
+	// Fill in the gaps between them.
+	uint32_t pos = seq;
+
+	for ( size_t k = i; k < j && pos < upper; ++k )
+		{
+		if ( blocks[k].seq > pos )
+			memcpy(payload + pos, data + (pos - seq), blocks[k].seq - pos);
+
+		pos = std::max(pos, blocks[k].upper);
+		}
+
+	if ( pos < upper )
+		memcpy(payload + pos, data + (pos - seq), upper - pos);
+
+	if ( i == j )
+		blocks.insert(blocks.begin() + i, {seq, upper});
+	else
+		{
+		blocks[i] = {std::min(seq, blocks[i].seq), std::max(upper, blocks[j - 1].upper)};
+		blocks.erase(blocks.begin() + i + 1, blocks.begin() + j);
+		}
+
+	UpdateMemoryAllocation();
+	BlockInserted();
+	}
+
+void FragReassembler::CheckOverlap(uint32_t seq, uint32_t upper, const u_char* data)
+	{
+	if ( blocks.empty() || seq == blocks.back().upper )
+		// Special case check for common case of appending to the end.
+		return;
+
+	auto it = std::partition_point(blocks.begin(), blocks.end(),
+	                               [seq](const Block& b) { return b.upper <= seq; });
+
+	for ( ; it != blocks.end() && it->seq < upper; ++it )
+		{
+		uint32_t nseq = std::max(seq, it->seq);
+		uint32_t nupper = std::min(upper, it->upper);
+
+		Overlap(buffer + proto_hdr_len + nseq, data + (nseq - seq), nupper - nseq);
+		}
+	}
+
+void FragReassembler::Reserve(uint32_t upper)
+	{
+	uint32_t needed = proto_hdr_len + upper;
+
+	if ( needed <= buffer_size )
+		return;
+
+	// Grow geometrically, but no further than the largest datagram
+	// needs.
+	uint32_t size = std::max(needed, std::min(2 * buffer_size,
+	                                          proto_hdr_len + MAX_FRAG_DATA));
+	u_char* new_buffer = new u_char[size];
+
+	if ( buffer )
+		memcpy(new_buffer, buffer, buffer_size);
+	else
+		memcpy(new_buffer, proto_hdr, proto_hdr_len);
+
+	delete [] buffer;
+	buffer = new_buffer;
+	buffer_size = size;
+	}
+
+void FragReassembler::UpdateMemoryAllocation()
+	{
+	uint64_t m = buffer_size + blocks.capacity() * sizeof(Block);
+	Reassembler::AdjustMemoryAllocation(REASSEM_FRAG, int64_t(m) - int64_t(memory_allocation));
+	memory_allocation = m;
 	}
 
 void FragReassembler::Weird(const char* name) const
@@ -189,32 +299,20 @@ void FragReassembler::Overlap(const u_char* b1, const u_char* b2, uint64_t n)
 		Weird("fragment_overlap");
 	}
 
-void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
+void FragReassembler::BlockInserted()
 	{
-	auto it = block_list.Begin();
-
-	if ( it->second.seq > 0 || ! frag_size )
+	if ( blocks.front().seq > 0 || ! frag_size )
 		// For sure don't have it all yet.
 		return;
 
-	auto next = std::next(it);
-
-	// We might have it all - look for contiguous all the way.
-	while ( next != block_list.End() )
-		{
-		if ( it->second.upper != next->second.seq )
-			break;
-
-		++it;
-		++next;
-		}
-
-	const auto& last = block_list.LastBlock();
+	// We might have it all. Blocks never abut, so the first one is
+	// all that's contiguous from the start.
+	const auto& last = blocks.back();
 
-	if ( next != block_list.End() )
+	if ( blocks.size() > 1 )
 		{
 		// We have a hole.
-		if ( it->second.upper >= frag_size )
+		if ( blocks[0].upper >= frag_size )
 			{
 			// We're stuck.  The point where we stopped is
 			// contiguous up through the expected end of
@@ -227,7 +325,7 @@ void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
 			// We decide to analyze the contiguous portion now.
 			// Extend the fragment up through the end of what
 			// we have.
-			frag_size = it->second.upper;
+			frag_size = blocks[0].upper;
 			}
 		else
 			return;
@@ -243,89 +341,60 @@ void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
 		// Missing the tail.
 		return;
 
-	// We have it all.  Compute the expected size of the fragment.
+	// We have it all.  The buffer holds the header followed by the
+	// payload, which may extend beyond frag_size if we saw MF fragments
+	// (which don't lead to us setting frag_size) that went beyond the
+	// size indicated by the final, non-MF fragment.  This can happen for
+	// benign reasons due to intermingling of fragments from an older
+	// datagram with those for a more recent one.
 	uint64_t n = proto_hdr_len + frag_size;
-
-	// It's possible that we have blocks associated with this fragment
-	// that exceed this size, if we saw MF fragments (which don't lead
-	// to us setting frag_size) that went beyond the size indicated by
-	// the final, non-MF fragment.  This can happen for benign reasons
-	// due to intermingling of fragments from an older datagram with those
-	// for a more recent one.
-
-	u_char* pkt = new u_char[n];
-	memcpy((void*) pkt, (const void*) proto_hdr, proto_hdr_len);
-
-	u_char* pkt_start = pkt;
-
-	pkt += proto_hdr_len;
-
-	for ( it = block_list.Begin(); it != block_list.End(); ++it )
-		{
-		const auto& b = it->second;
-
-		if ( it != block_list.Begin() )
-			{
-			const auto& prev = std::prev(it)->second;
-
-			// If we're above a hole, stop.  This can happen because
-			// the logic above regarding a hole that's above the
-			// expected fragment size.
-			if ( prev.upper < b.seq )
-				break;
-			}
-
-		if ( b.upper > n )
-			{
-			reporter->InternalWarning("bad fragment reassembly");
-			DeleteTimer();
-			Expire(run_state::network_time);
-			delete [] pkt_start;
-			return;
-			}
-
-		memcpy(&pkt[b.seq], b.block, b.upper - b.seq);
-		}
-
-	delete reassembled_pkt;
-	reassembled_pkt = nullptr;
-
-	unsigned int version = ((const struct ip*)pkt_start)->ip_v;
+	unsigned int version = ((const struct ip*)buffer)->ip_v;
 
 	if ( version == 4 )
 		{
-		struct ip* reassem4 = (struct ip*) pkt_start;
+		struct ip* reassem4 = (struct ip*) buffer;
 		reassem4->ip_len = htons(frag_size + proto_hdr_len);
 		reassembled_pkt = new IP_Hdr(reassem4, true);
-		DeleteTimer();
 		}
 
 	else if ( version == 6 )
 		{
-		struct ip6_hdr* reassem6 = (struct ip6_hdr*) pkt_start;
+		struct ip6_hdr* reassem6 = (struct ip6_hdr*) buffer;
 		reassem6->ip6_plen = htons(frag_size + proto_hdr_len - 40);
 		const IPv6_Hdr_Chain* chain = new IPv6_Hdr_Chain(reassem6, next_proto, n);
 		reassembled_pkt = new IP_Hdr(reassem6, true, n, chain);
-		DeleteTimer();
 		}
 
 	else
 		{
 		reporter->InternalWarning("bad IP version in fragment reassembly: %d",
 		                                version);
-		delete [] pkt_start;
+		return;
 		}
+
+	// The reassembled packet owns the buffer now.
+	buffer = nullptr;
+	buffer_size = 0;
+	blocks = {};
+	UpdateMemoryAllocation();
+
+	DeleteTimer();
 	}
 
 void FragReassembler::Expire(double t)
 	{
-	block_list.Clear();
 	expire_timer->ClearReassembler();
 	expire_timer = nullptr;	// timer manager will delete it
 
 	sessions->Remove(this);
 	}
 
+void FragReassembler::Evict()
+	{
+	Weird("fragment_reassembly_evicted");
+	s->Remove(this);
+	}
+
 void FragReassembler::DeleteTimer()
 	{
 	if ( expire_timer )
@@ -336,4 +405,189 @@ void FragReassembler::DeleteTimer()
 		}
 	}
 
+FragmentTable::~FragmentTable()
+	{
+	Clear();
+	}
+
+uint64_t FragmentTable::Hash(const FragReassemblerKey& key)
+	{
+	struct {
+		uint32_t src[4];
+		uint32_t dst[4];
+		uint64_t id;
+	} k;
+
+	std::get<0>(key).CopyIPv6(k.src);
+	std::get<1>(key).CopyIPv6(k.dst);
+	k.id = std::get<2>(key);
+
+	return KeyedHash::Hash64(&k, sizeof(k));
+	}
+
+FragReassembler* FragmentTable::Lookup(const FragReassemblerKey& key)
+	{
+	if ( num_entries == 0 )
+		return nullptr;
+
+	uint64_t h = Hash(key);
+	size_t mask = slots.size() - 1;
+
+	for ( size_t i = h & mask; slots[i]; i = (i + 1) & mask )
+		{
+		FragReassembler* f = slots[i];
+
+		if ( f->hash == h && f->key == key )
+			{
+			if ( f != lru_head )
+				{
+				Unlink(f);
+				PushFront(f);
+				}
+
+			return f;
+			}
+		}
+
+	return nullptr;
+	}
+
+void FragmentTable::Insert(FragReassembler* f)
+	{
+	// Keep the table at most half full, so that probe sequences
+	// stay short.
+	if ( 2 * (num_entries + 1) > slots.size() )
+		Grow();
+
+	f->hash = Hash(f->key);
+	Place(f);
+	PushFront(f);
+	++num_entries;
+	}
+
+bool FragmentTable::Remove(FragReassembler* f)
+	{
+	if ( num_entries == 0 )
+		return false;
+
+	size_t mask = slots.size() - 1;
+	size_t i = f->hash & mask;
+
+	while ( slots[i] != f )
+		{
+		if ( ! slots[i] )
+			return false;
+
+		i = (i + 1) & mask;
+		}
+
+	// Move back any following entries of the same cluster that the
+	// hole would otherwise cut off from their home slot.
+	size_t hole = i;
+
+	for ( size_t j = (i + 1) & mask; slots[j]; j = (j + 1) & mask )
+		{
+		size_t home = slots[j]->hash & mask;
+
+		if ( ((j - home) & mask) >= ((j - hole) & mask) )
+			{
+			slots[hole] = slots[j];
+			hole = j;
+			}
+		}
+
+	slots[hole] = nullptr;
+	--num_entries;
+
+	Unlink(f);
+	Unref(f);
+
+	return true;
+	}
+
+void FragmentTable::Clear()
+	{
+	FragReassembler* f = lru_head;
+
+	slots = {};
+	num_entries = 0;
+	lru_head = lru_tail = nullptr;
+
+	while ( f )
+		{
+		FragReassembler* next = f->lru_next;
+		f->lru_prev = f->lru_next = nullptr;
+		Unref(f);
+		f = next;
+		}
+	}
+
+FragReassembler* FragmentTable::LeastRecentlyActive() const
+	{
+	for ( FragReassembler* f = lru_tail; f; f = f->lru_prev )
+		{
+		if ( ! f->reassembled_pkt )
+			return f;
+		}
+
+	return nullptr;
+	}
+
+unsigned int FragmentTable::MemoryAllocation() const
+	{
+	return padded_sizeof(*this)
+		+ util::pad_size(slots.capacity() * sizeof(FragReassembler*));
+	}
+
+void FragmentTable::Grow()
+	{
+	std::vector<FragReassembler*> old(std::max(slots.size() * 2, size_t(1024)));
+	old.swap(slots);
+
+	for ( auto f : old )
+		{
+		if ( f )
+			Place(f);
+		}
+	}
+
+void FragmentTable::Place(FragReassembler* f)
+	{
+	size_t mask = slots.size() - 1;
+	size_t i = f->hash & mask;
+
+	while ( slots[i] )
+		i = (i + 1) & mask;
+
+	slots[i] = f;
+	}
+
+void FragmentTable::Unlink(FragReassembler* f)
+	{
+	if ( f->lru_prev )
+		f->lru_prev->lru_next = f->lru_next;
+	else
+		lru_head = f->lru_next;
+
+	if ( f->lru_next )
+		f->lru_next->lru_prev = f->lru_prev;
+	else
+		lru_tail = f->lru_prev;
+
+	f->lru_prev = f->lru_next = nullptr;
+	}
+
+void FragmentTable::PushFront(FragReassembler* f)
+	{
+	f->lru_prev = nullptr;
+	f->lru_next = lru_head;
+
+	if ( lru_head )
+		lru_head->lru_prev = f;
+	else
+		lru_tail = f;
+
+	lru_head = f;
+	}
+
 } // namespace zeek::detail
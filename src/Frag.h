@@ -8,6 +8,7 @@
 #include "Timer.h"
 
 #include <tuple>
+#include <vector>
 
 #include <sys/types.h> // for u_char
 
@@ -20,7 +21,13 @@ namespace zeek::detail {
 
 using FragReassemblerKey = std::tuple<IPAddr, IPAddr, bro_uint_t>;
 
-class FragReassembler : public Reassembler {
+/**
+ * Reassembles the fragments of one IP datagram. The datagram builds up in
+ * a single buffer, sized to the highest offset seen so far and bounded by
+ * the 64KB limit of IP, which becomes the reassembled packet once
+ * complete.
+ */
+class FragReassembler : public Obj {
 public:
 	FragReassembler(NetSessions* s, const IP_Hdr* ip, const u_char* pkt,
 	                const FragReassemblerKey& k, double t);
@@ -32,12 +39,30 @@ public:
 	void DeleteTimer();
 	void ClearTimer()	{ expire_timer = nullptr; }
 
+	// Gives up on the datagram to make room for others.
+	void Evict();
+
 	const IP_Hdr* ReassembledPkt()	{ return reassembled_pkt; }
 	const FragReassemblerKey& Key() const	{ return key; }
 
 protected:
-	void BlockInserted(DataBlockMap::const_iterator it) override;
-	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
+	friend class FragmentTable;
+
+	// A range of the payload held in the buffer. Blocks neither overlap
+	// nor abut: as with the generic Reassembler, data overlapping what's
+	// already there only fills in the gaps, and new data merges with the
+	// blocks it touches, so a contiguous datagram is a single block.
+	struct Block {
+		uint32_t seq;
+		uint32_t upper;
+	};
+
+	void NewBlock(uint32_t seq, uint32_t len, const u_char* data);
+	void CheckOverlap(uint32_t seq, uint32_t upper, const u_char* data);
+	void Reserve(uint32_t upper);
+	void UpdateMemoryAllocation();
+	void BlockInserted();
+	void Overlap(const u_char* b1, const u_char* b2, uint64_t n);
 	void Weird(const char* name) const;
 
 	u_char* proto_hdr;
@@ -48,7 +73,88 @@ protected:
 	uint16_t next_proto; // first IPv6 fragment header's next proto field
 	uint16_t proto_hdr_len;
 
+	// The header of the first fragment seen, followed by the payload.
+	u_char* buffer = nullptr;
+	uint32_t buffer_size = 0;
+	std::vector<Block> blocks;	// sorted by seq
+	uint64_t memory_allocation = 0;
+
 	FragTimer* expire_timer;
+
+	// Maintained by FragmentTable.
+	uint64_t hash = 0;
+	FragReassembler* lru_prev = nullptr;
+	FragReassembler* lru_next = nullptr;
+};
+
+/**
+ * The reassemblers of the datagrams currently being reassembled, in an
+ * open-addressing hash table keyed with the process-wide hash seed, so that
+ * floods of fragments can't provoke collisions. The table also keeps its
+ * reassemblers in the order of their most recent fragment, for evicting
+ * the least recently active ones once the number of datagrams reaches
+ * its limit.
+ */
+class FragmentTable {
+public:
+	FragmentTable() = default;
+	~FragmentTable();
+
+	FragmentTable(const FragmentTable&) = delete;
+	FragmentTable& operator=(const FragmentTable&) = delete;
+
+	/**
+	 * Finds the reassembler for a datagram and marks it as the most
+	 * recently active one.
+	 *
+	 * @return The reassembler, or null if there's none.
+	 */
+	FragReassembler* Lookup(const FragReassemblerKey& key);
+
+	/**
+	 * Adds a reassembler as the most recently active one. The table
+	 * takes over the caller's reference.
+	 *
+	 * @param f  A reassembler whose key isn't in the table yet.
+	 */
+	void Insert(FragReassembler* f);
+
+	/**
+	 * Removes a reassembler and releases the table's reference to it.
+	 *
+	 * @return False if the reassembler wasn't in the table.
+	 */
+	bool Remove(FragReassembler* f);
+
+	/**
+	 * Removes all reassemblers.
+	 */
+	void Clear();
+
+	/**
+	 * @return The least recently active reassembler that hasn't completed
+	 * its datagram yet, or null if there's none. A completed one is about
+	 * to be removed anyway once its packet has been processed.
+	 */
+	FragReassembler* LeastRecentlyActive() const;
+
+	size_t Size() const	{ return num_entries; }
+
+	unsigned int MemoryAllocation() const;
+
+private:
+	static uint64_t Hash(const FragReassemblerKey& key);
+
+	void Grow();
+	void Place(FragReassembler* f);
+	void Unlink(FragReassembler* f);
+	void PushFront(FragReassembler* f);
+
+	std::vector<FragReassembler*> slots;	// size is a power of two
+	size_t num_entries = 0;
+
+	FragReassembler* lru_head = nullptr;	// most recently active
+	FragReassembler* lru_tail = nullptr;
 };
 
 class FragTimer final : public Timer {
@@ -919,7 +919,10 @@ void init_primary_bifs()
 	FileAnalysisStats = id::find_type<RecordType>("FileAnalysisStats");
 	ThreadStats = id::find_type<RecordType>("ThreadStats");
 	BrokerStats = id::find_type<RecordType>("BrokerStats");
+	BrokerLogBatchStats = id::find_type<RecordType>("BrokerLogBatchStats");
 	ReporterStats = id::find_type<RecordType>("ReporterStats");
+	LatencyStats = id::find_type<RecordType>("LatencyStats");
+	ObjectPoolStats = id::find_type<RecordType>("ObjectPoolStats");
 
 	var_sizes = id::find_type("var_sizes")->AsTableType();
 
@@ -116,6 +116,7 @@ int tcp_match_undelivered;
 int encap_hdr_size;
 
 double frag_timeout;
+int frag_max_datagrams;
 
 double tcp_SYN_timeout;
 double tcp_session_timer;
@@ -264,6 +265,7 @@ void init_net_var()
 	encap_hdr_size = id::find_val("encap_hdr_size")->AsCount();
 
 	frag_timeout = id::find_val("frag_timeout")->AsInterval();
+	frag_max_datagrams = id::find_val("frag_max_datagrams")->AsCount();
 
 	tcp_SYN_timeout = id::find_val("tcp_SYN_timeout")->AsInterval();
 	tcp_session_timer = id::find_val("tcp_session_timer")->AsInterval();
@@ -20,6 +20,7 @@ extern int tcp_match_undelivered;
 extern int encap_hdr_size;
 
 extern double frag_timeout;
+extern int frag_max_datagrams;
 
 extern double tcp_SYN_timeout;
 extern double tcp_session_timer;
@@ -0,0 +1,56 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "ObjectPool.h"
+
+#include <cxxabi.h>
+#include <cstdlib>
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ZEEK_OBJECT_POOL_ASAN
+#endif
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+#define ZEEK_OBJECT_POOL_ASAN
+#endif
+
+namespace zeek::detail {
+
+// The maximum number of free blocks a pool keeps. With AddressSanitizer,
+// pools don't keep any, as reusing memory would hide use-after-free bugs.
+#ifdef ZEEK_OBJECT_POOL_ASAN
+static constexpr size_t max_free_blocks = 0;
+#else
+static constexpr size_t max_free_blocks = 4096;
+#endif
+
+static std::vector<const ObjectPool*>& pools()
+	{
+	static auto p = new std::vector<const ObjectPool*>;
+	return *p;
+	}
+
+ObjectPool::ObjectPool(const std::type_info& type, size_t size)
+	: object_size(size), max_free(max_free_blocks)
+	{
+	int status;
+	char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+
+	if ( demangled )
+		{
+		name = demangled;
+		free(demangled);
+		}
+	else
+		name = type.name();
+
+	pools().push_back(this);
+	}
+
+const std::vector<const ObjectPool*>& ObjectPool::Pools()
+	{
+	return pools();
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,169 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * A free list of memory blocks for objects of one class. Connections and
+ * their analyzers are created and destroyed at high rates, in particular
+ * for scans and DNS, where most connections see a single packet. Keeping
+ * the memory of recently freed ones around saves the trips through the
+ * general-purpose allocator.
+ *
+ * Pools aren't thread-safe; they are for objects that only the main
+ * thread creates and destroys. Classes use them by way of
+ * PoolAllocated.
+ */
+class ObjectPool {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param type  The class whose objects the pool holds.
+	 *
+	 * @param size  The size of these objects.
+	 */
+	ObjectPool(const std::type_info& type, size_t size);
+
+	/**
+	 * Returns memory for an object, from the free list if possible.
+	 *
+	 * @param size  The size of the object. Requests for any size other
+	 * than the pool's, like for derived classes, go to the
+	 * general-purpose allocator.
+	 */
+	void* Allocate(size_t size)
+		{
+		if ( size != object_size )
+			return ::operator new(size);
+
+		++num_in_use;
+
+		if ( ! free_list )
+			{
+			++num_allocated;
+			return ::operator new(size);
+			}
+
+		Block* b = free_list;
+		free_list = b->next;
+		--num_free;
+		++num_reused;
+
+		return b;
+		}
+
+	/**
+	 * Returns an object's memory to the free list, or to the
+	 * general-purpose allocator if the free list is full.
+	 *
+	 * @param p  Memory obtained from Allocate().
+	 *
+	 * @param size  The size passed to Allocate().
+	 */
+	void Release(void* p, size_t size)
+		{
+		if ( size != object_size )
+			{
+			::operator delete(p);
+			return;
+			}
+
+		--num_in_use;
+
+		if ( num_free >= max_free )
+			{
+			::operator delete(p);
+			return;
+			}
+
+		Block* b = static_cast<Block*>(p);
+		b->next = free_list;
+		free_list = b;
+		++num_free;
+		}
+
+	/**
+	 * @return The name of the class whose objects the pool holds.
+	 */
+	const std::string& Name() const	{ return name; }
+
+	/**
+	 * @return The size of the objects in the pool.
+	 */
+	size_t ObjectSize() const	{ return object_size; }
+
+	/**
+	 * @return The number of objects whose memory came from the
+	 * general-purpose allocator.
+	 */
+	uint64_t NumAllocated() const	{ return num_allocated; }
+
+	/**
+	 * @return The number of objects whose memory came from the free list.
+	 */
+	uint64_t NumReused() const	{ return num_reused; }
+
+	/**
+	 * @return The number of objects currently allocated.
+	 */
+	uint64_t NumInUse() const	{ return num_in_use; }
+
+	/**
+	 * @return The number of blocks on the free list.
+	 */
+	size_t NumFree() const	{ return num_free; }
+
+	/**
+	 * @return All pools that have been used so far.
+	 */
+	static const std::vector<const ObjectPool*>& Pools();
+
+private:
+	struct Block {
+		Block* next;
+	};
+
+	std::string name;
+	size_t object_size;
+	size_t max_free;
+
+	Block* free_list = nullptr;
+	size_t num_free = 0;
+	uint64_t num_allocated = 0;
+	uint64_t num_reused = 0;
+	uint64_t num_in_use = 0;
+};
+
+/**
+ * Base class making the objects of class T allocate from an ObjectPool.
+ * T's destructor must be virtual if its objects are deleted through
+ * pointers to a base class, as usual.
+ */
+template <typename T>
+class PoolAllocated {
+public:
+	static void* operator new(size_t size)
+		{ return Pool()->Allocate(size); }
+
+	static void operator delete(void* p, size_t size)
+		{ Pool()->Release(p, size); }
+
+private:
+	static ObjectPool* Pool()
+		{
+		// Never destroyed, as objects may get deleted during
+		// static destruction.
+		static ObjectPool* pool = new ObjectPool(typeid(T), sizeof(T));
+		return pool;
+		}
+};
+
+} // namespace zeek::detail
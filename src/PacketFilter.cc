@@ -1,98 +1,139 @@
 #include "PacketFilter.h"
 #include "IP.h"
+#include "Reporter.h"
+#include "Val.h"
 
 namespace zeek::detail {
 
-void PacketFilter::DeleteFilter(void* data)
+PacketFilter::PacketFilter(bool arg_default)
 	{
-	auto f = static_cast<Filter*>(data);
-	delete f;
+	default_match = arg_default;
 	}
 
-PacketFilter::PacketFilter(bool arg_default)
+bool PacketFilter::ToPrefix(const Val* v, IPPrefix* prefix)
 	{
-	default_match = arg_default;
-	src_filter.SetDeleteFunction(PacketFilter::DeleteFilter);
-	dst_filter.SetDeleteFunction(PacketFilter::DeleteFilter);
+	switch ( v->GetType()->Tag() ) {
+	case TYPE_ADDR:
+		*prefix = IPPrefix(v->AsAddr(), 128, true);
+		return true;
+
+	case TYPE_SUBNET:
+		*prefix = v->AsSubNet();
+		return true;
+
+	default:
+		reporter->InternalWarning("Wrong index type for PacketFilter");
+		return false;
+	}
+	}
+
+void PacketFilter::Add(FilterMap* filters, bool* dirty, const IPPrefix& prefix,
+                       uint32_t tcp_flags, double probability)
+	{
+	Filter& f = (*filters)[prefix];
+	f.tcp_flags = tcp_flags;
+	f.probability = probability * static_cast<double>(util::detail::max_random());
+	*dirty = true;
+	}
+
+bool PacketFilter::Remove(FilterMap* filters, bool* dirty, const IPPrefix& prefix)
+	{
+	if ( filters->erase(prefix) == 0 )
+		return false;
+
+	// The index may now point to the removed filter, but Match() won't
+	// use it before rebuilding.
+	*dirty = true;
+	return true;
+	}
+
+void PacketFilter::Rebuild(const FilterMap& filters, PrefixIndex* index)
+	{
+	std::vector<PrefixIndex::Prefix> prefixes;
+	prefixes.reserve(filters.size());
+
+	for ( const auto& [prefix, f] : filters )
+		prefixes.push_back({prefix, const_cast<Filter*>(&f)});
+
+	index->Build(std::move(prefixes));
 	}
 
 void PacketFilter::AddSrc(const IPAddr& src, uint32_t tcp_flags, double probability)
 	{
-	Filter* f = new Filter;
-	f->tcp_flags = tcp_flags;
-	f->probability = probability * static_cast<double>(util::detail::max_random());
-	auto prev = static_cast<Filter*>(src_filter.Insert(src, 128, f));
-	delete prev;
+	Add(&src_filters, &src_dirty, IPPrefix(src, 128, true), tcp_flags, probability);
 	}
 
 void PacketFilter::AddSrc(Val* src, uint32_t tcp_flags, double probability)
 	{
-	Filter* f = new Filter;
-	f->tcp_flags = tcp_flags;
-	f->probability = probability * static_cast<double>(util::detail::max_random());
-	auto prev = static_cast<Filter*>(src_filter.Insert(src, f));
-	delete prev;
+	IPPrefix prefix;
+
+	if ( ToPrefix(src, &prefix) )
+		Add(&src_filters, &src_dirty, prefix, tcp_flags, probability);
 	}
 
 void PacketFilter::AddDst(const IPAddr& dst, uint32_t tcp_flags, double probability)
 	{
-	Filter* f = new Filter;
-	f->tcp_flags = tcp_flags;
-	f->probability = probability * static_cast<double>(util::detail::max_random());
-	auto prev = static_cast<Filter*>(dst_filter.Insert(dst, 128, f));
-	delete prev;
+	Add(&dst_filters, &dst_dirty, IPPrefix(dst, 128, true), tcp_flags, probability);
 	}
 
 void PacketFilter::AddDst(Val* dst, uint32_t tcp_flags, double probability)
 	{
-	Filter* f = new Filter;
-	f->tcp_flags = tcp_flags;
-	f->probability = probability * static_cast<double>(util::detail::max_random());
-	auto prev = static_cast<Filter*>(dst_filter.Insert(dst, f));
-	delete prev;
+	IPPrefix prefix;
+
+	if ( ToPrefix(dst, &prefix) )
+		Add(&dst_filters, &dst_dirty, prefix, tcp_flags, probability);
 	}
 
 bool PacketFilter::RemoveSrc(const IPAddr& src)
 	{
-	auto f = static_cast<Filter*>(src_filter.Remove(src, 128));
-	delete f;
-	return f != nullptr;
+	return Remove(&src_filters, &src_dirty, IPPrefix(src, 128, true));
 	}
 
 bool PacketFilter::RemoveSrc(Val* src)
 	{
-	auto f = static_cast<Filter*>(src_filter.Remove(src));
-	delete f;
-	return f != nullptr;
+	IPPrefix prefix;
+	return ToPrefix(src, &prefix) && Remove(&src_filters, &src_dirty, prefix);
 	}
 
 bool PacketFilter::RemoveDst(const IPAddr& dst)
 	{
-	auto f = static_cast<Filter*>(dst_filter.Remove(dst, 128));
-	delete f;
-	return f != nullptr;
+	return Remove(&dst_filters, &dst_dirty, IPPrefix(dst, 128, true));
 	}
 
 bool PacketFilter::RemoveDst(Val* dst)
 	{
-	auto f = static_cast<Filter*>(dst_filter.Remove(dst));
-	delete f;
-	return f != nullptr;
+	IPPrefix prefix;
+	return ToPrefix(dst, &prefix) && Remove(&dst_filters, &dst_dirty, prefix);
 	}
 
 bool PacketFilter::Match(const IP_Hdr* ip, int len, int caplen)
 	{
-	Filter* f = (Filter*) src_filter.Lookup(ip->SrcAddr(), 128);
-	if ( f )
-		return MatchFilter(*f, *ip, len, caplen);
+	if ( src_dirty )
+		{
+		Rebuild(src_filters, &src_index);
+		src_dirty = false;
+		}
 
-	f = (Filter*) dst_filter.Lookup(ip->DstAddr(), 128);
-	if ( f )
-		return MatchFilter(*f, *ip, len, caplen);
+	if ( dst_dirty )
+		{
+		Rebuild(dst_filters, &dst_index);
+		dst_dirty = false;
+		}
+
+	if ( ! src_index.Empty() )
+		{
+		if ( auto f = static_cast<const Filter*>(src_index.Lookup(ip->SrcAddr())) )
+			return MatchFilter(*f, *ip, len, caplen);
+		}
+
+	if ( ! dst_index.Empty() )
+		{
+		if ( auto f = static_cast<const Filter*>(dst_index.Lookup(ip->DstAddr())) )
+			return MatchFilter(*f, *ip, len, caplen);
+		}
 
 	return default_match;
 	}
-
 bool PacketFilter::MatchFilter(const Filter& f, const IP_Hdr& ip,
                                int len, int caplen)
 	{
@@ -2,8 +2,10 @@
 
 #pragma once
 
+#include <map>
+
 #include "IPAddr.h"
-#include "PrefixTable.h"
+#include "PrefixIndex.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(IP_Hdr, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
@@ -39,13 +41,29 @@ private:
 		double probability;
 	};
 
-	static void DeleteFilter(void* data);
+	using FilterMap = std::map<IPPrefix, Filter>;
+
+	// Converts an addr or subnet value into the prefix it stands for.
+	static bool ToPrefix(const Val* v, IPPrefix* prefix);
+
+	static void Add(FilterMap* filters, bool* dirty, const IPPrefix& prefix,
+	                uint32_t tcp_flags, double probability);
+	static bool Remove(FilterMap* filters, bool* dirty, const IPPrefix& prefix);
+	static void Rebuild(const FilterMap& filters, PrefixIndex* index);
 
 	bool MatchFilter(const Filter& f, const IP_Hdr& ip, int len, int caplen);
 
 	bool default_match;
-	PrefixTable src_filter;
-	PrefixTable dst_filter;
+
+	// The filters, and the indices that Match() searches. Changes only
+	// mark an index dirty, and the next Match() rebuilds it, so that
+	// installing many filters at once costs a single rebuild.
+	FilterMap src_filters;
+	FilterMap dst_filters;
+	PrefixIndex src_index;
+	PrefixIndex dst_index;
+	bool src_dirty = false;
+	bool dst_dirty = false;
 };
 
 } // namespace zeek::detail
@@ -0,0 +1,174 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "PrefixIndex.h"
+
+#include <algorithm>
+
+#include "util.h"
+
+namespace zeek::detail {
+
+// The number of ranges from which on an index gets the IPv4 table. The
+// table itself takes 256KB.
+static constexpr size_t min_ranges_for_v4_blocks = 1024;
+
+static constexpr uint64_t v4_mapped = uint64_t(0xffff) << 32;
+
+PrefixIndex::Key PrefixIndex::MakeKey(const IPAddr& addr)
+	{
+	uint32_t w[4];
+	addr.CopyIPv6(w, IPAddr::Host);
+
+	return {(uint64_t(w[0]) << 32) | w[1], (uint64_t(w[2]) << 32) | w[3]};
+	}
+
+void PrefixIndex::Build(std::vector<Prefix> prefixes)
+	{
+	struct Span {
+		Key start;
+		Key end;
+		int width;
+		void* data;
+	};
+
+	std::vector<Span> spans;
+	spans.reserve(prefixes.size());
+
+	for ( const auto& p : prefixes )
+		{
+		Key start = MakeKey(p.prefix.Prefix());
+		Key end = start;
+		int width = p.prefix.LengthIPv6();
+
+		if ( width < 64 )
+			{
+			uint64_t host = width == 0 ? ~uint64_t(0) : ~uint64_t(0) >> width;
+			start.hi &= ~host;
+			start.lo = 0;
+			end.hi = start.hi | host;
+			end.lo = ~uint64_t(0);
+			}
+		else
+			{
+			uint64_t host = width == 64 ? ~uint64_t(0) :
+			                (width == 128 ? 0 : ~uint64_t(0) >> (width - 64));
+			start.lo &= ~host;
+			end.lo = start.lo | host;
+			}
+
+		spans.push_back({start, end, width, p.data});
+		}
+
+	// Containing prefixes go before the ones they contain.
+	std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b)
+		{
+		if ( a.start == b.start )
+			return a.width < b.width;
+
+		return a.start < b.start;
+		});
+
+	starts.clear();
+	data.clear();
+	starts.push_back({0, 0});
+	data.push_back(nullptr);
+
+	auto emit = [this](const Key& start, void* d)
+		{
+		if ( starts.back() == start )
+			{
+			data.back() = d;
+
+			if ( data.size() > 1 && data[data.size() - 2] == d )
+				{
+				starts.pop_back();
+				data.pop_back();
+				}
+			}
+
+		else if ( data.back() != d )
+			{
+			starts.push_back(start);
+			data.push_back(d);
+			}
+		};
+
+	// The prefixes containing the current position, innermost last.
+	std::vector<const Span*> stack;
+
+	auto pop = [&]()
+		{
+		const Span* top = stack.back();
+		stack.pop_back();
+
+		Key next = top->end;
+
+		if ( ++next.lo == 0 && ++next.hi == 0 )
+			// Reached the end of the address space.
+			return;
+
+		emit(next, stack.empty() ? nullptr : stack.back()->data);
+		};
+
+	for ( const auto& s : spans )
+		{
+		while ( ! stack.empty() && stack.back()->end < s.start )
+			pop();
+
+		stack.push_back(&s);
+		emit(s.start, s.data);
+		}
+
+	while ( ! stack.empty() )
+		pop();
+
+	starts.shrink_to_fit();
+	data.shrink_to_fit();
+	num_prefixes = spans.size();
+
+	v4_blocks.clear();
+
+	if ( starts.size() >= min_ranges_for_v4_blocks )
+		{
+		v4_blocks.resize(65537);
+
+		for ( uint64_t i = 0; i < 65536; ++i )
+			v4_blocks[i] = FindRange({0, v4_mapped | (i << 16)}, 0, starts.size());
+
+		v4_blocks[65536] = FindRange({0, v4_mapped | 0xffffffff}, 0, starts.size());
+		}
+
+	v4_blocks.shrink_to_fit();
+	}
+
+size_t PrefixIndex::FindRange(const Key& k, size_t begin, size_t end) const
+	{
+	auto it = std::upper_bound(starts.begin() + begin, starts.begin() + end, k);
+	return (it - starts.begin()) - 1;
+	}
+
+void* PrefixIndex::Lookup(const IPAddr& addr) const
+	{
+	if ( num_prefixes == 0 )
+		return nullptr;
+
+	Key k = MakeKey(addr);
+
+	if ( ! v4_blocks.empty() && k.hi == 0 && (k.lo >> 32) == 0xffff )
+		{
+		auto block = (k.lo >> 16) & 0xffff;
+		return data[FindRange(k, v4_blocks[block], v4_blocks[block + 1] + 1)];
+		}
+
+	return data[FindRange(k, 0, starts.size())];
+	}
+
+unsigned int PrefixIndex::MemoryAllocation() const
+	{
+	return padded_sizeof(*this)
+		+ util::pad_size(starts.capacity() * sizeof(Key))
+		+ util::pad_size(data.capacity() * sizeof(void*))
+		+ util::pad_size(v4_blocks.capacity() * sizeof(uint32_t));
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,89 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "IPAddr.h"
+
+namespace zeek::detail {
+
+/**
+ * A longest-prefix-match index over a set of prefixes that changes much
+ * less often than it's searched. Building it flattens the prefixes into
+ * a sorted array of disjoint address ranges, each carrying the data of
+ * the most specific prefix covering it; a lookup is a binary search over
+ * that array. IPv4 prefixes live in the IPv4-mapped part of the IPv6
+ * address space, as elsewhere. For larger indices, a table indexed by
+ * the upper 16 bits of IPv4 addresses narrows down their search to the
+ * ranges within the corresponding /16.
+ */
+class PrefixIndex {
+public:
+	struct Prefix {
+		IPPrefix prefix;
+		void* data;	// must not be null
+	};
+
+	PrefixIndex()	{ Build({}); }
+
+	/**
+	 * Replaces the contents of the index.
+	 *
+	 * @param prefixes  The prefixes to index. Each prefix must only
+	 * occur once.
+	 */
+	void Build(std::vector<Prefix> prefixes);
+
+	/**
+	 * Finds the most specific prefix containing an address.
+	 *
+	 * @return The data of that prefix, or null if none contains the
+	 * address.
+	 */
+	void* Lookup(const IPAddr& addr) const;
+
+	/**
+	 * @return True if the index doesn't contain any prefixes.
+	 */
+	bool Empty() const	{ return num_prefixes == 0; }
+
+	/**
+	 * @return The number of address ranges the prefixes were flattened
+	 * into.
+	 */
+	size_t NumRanges() const	{ return starts.size(); }
+
+	unsigned int MemoryAllocation() const;
+
+protected:
+	// An address as a 128-bit number in host order.
+	struct Key {
+		uint64_t hi;
+		uint64_t lo;
+
+		bool operator<(const Key& other) const
+			{ return hi < other.hi || (hi == other.hi && lo < other.lo); }
+		bool operator==(const Key& other) const
+			{ return hi == other.hi && lo == other.lo; }
+	};
+
+	static Key MakeKey(const IPAddr& addr);
+
+	// Returns the index of the range containing the key.
+	size_t FindRange(const Key& k, size_t begin, size_t end) const;
+
+	// The first address of each range, in increasing order, starting
+	// with the all-zeroes address, and the data of each range.
+	std::vector<Key> starts;
+	std::vector<void*> data;
+	size_t num_prefixes = 0;
+
+	// For each IPv4 /16, the range containing its first address, plus
+	// a final entry for the range containing the last IPv4 address.
+	// Empty if the index is too small for this to pay off.
+	std::vector<uint32_t> v4_blocks;
+};
+
+} // namespace zeek::detail
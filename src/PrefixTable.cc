@@ -39,6 +39,7 @@ void* PrefixTable::Insert(const IPAddr& addr, int width, void* data)
 	// If there is no data to be associated with addr, we take the
 	// node itself.
 	node->data = data ? data : node;
+	InvalidateIndex();
 
 	return old;
 	}
@@ -91,6 +92,16 @@ std::list<std::tuple<IPPrefix,void*>> PrefixTable::FindAll(const SubNetVal* valu
 
 void* PrefixTable::Lookup(const IPAddr& addr, int width, bool exact) const
 	{
+	if ( width == 128 && ! exact )
+		{
+		if ( ! index_valid &&
+		     ++lookups_since_change > static_cast<uint64_t>(tree->num_active_node) )
+			BuildIndex();
+
+		if ( index_valid )
+			return index.Lookup(addr);
+		}
+
 	prefix_t* prefix = MakePrefix(addr, width);
 	patricia_node_t* node =
 		exact ? patricia_search_exact(tree, prefix) :
@@ -138,6 +149,7 @@ void* PrefixTable::Remove(const IPAddr& addr, int width)
 
 	void* old = node->data;
 	patricia_remove(tree, node);
+	InvalidateIndex();
 
 	return old;
 	}
@@ -165,6 +177,24 @@ void* PrefixTable::Remove(const Val* value)
 	}
 	}
 
+void PrefixTable::BuildIndex() const
+	{
+	std::vector<PrefixIndex::Prefix> prefixes;
+	prefixes.reserve(tree->num_active_node);
+
+	patricia_node_t* node;
+
+	PATRICIA_WALK(tree->head, node)
+		{
+		if ( node->data )
+			prefixes.push_back({PrefixToIPPrefix(node->prefix), node->data});
+		}
+	PATRICIA_WALK_END;
+
+	index.Build(std::move(prefixes));
+	index_valid = true;
+	}
+
 PrefixTable::iterator PrefixTable::InitIterator()
 	{
 	iterator i;
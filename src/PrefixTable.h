@@ -7,6 +7,7 @@ extern "C" {
 #include <list>
 
 #include "IPAddr.h"
+#include "PrefixIndex.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(SubNetVal, zeek);
@@ -48,7 +49,7 @@ public:
 	void* Remove(const IPAddr& addr, int width);
 	void* Remove(const Val* value);
 
-	void Clear()	{ Clear_Patricia(tree, delete_function); }
+	void Clear()	{ Clear_Patricia(tree, delete_function); InvalidateIndex(); }
 
 	// Sets a function to call for each node when table is cleared/destroyed.
 	void SetDeleteFunction(data_fn_t del_fn)	{ delete_function = del_fn; }
@@ -60,8 +61,20 @@ private:
 	static prefix_t* MakePrefix(const IPAddr& addr, int width);
 	static IPPrefix PrefixToIPPrefix(prefix_t* p);
 
+	void InvalidateIndex() const
+		{ index_valid = false; lookups_since_change = 0; }
+	void BuildIndex() const;
+
 	patricia_tree_t* tree;
 	data_fn_t delete_function;
+
+	// Longest-prefix lookups of addresses go to an index that flattens
+	// the tree into a sorted array, once the table hasn't changed for
+	// as many such lookups as it has entries. That keeps the cost of
+	// rebuilding the index bounded for tables that change frequently.
+	mutable PrefixIndex index;
+	mutable bool index_valid = false;
+	mutable uint64_t lookups_since_change = 0;
 };
 
 } // namespace zeek::detail
@@ -288,6 +288,15 @@ public:
 	// Data buffered by type of reassembler.
 	static uint64_t MemoryAllocation(ReassemblerType rtype);
 
+	// Accounts for data buffered by reassemblers of the given type
+	// that manage their buffers themselves rather than through block
+	// lists.
+	static void AdjustMemoryAllocation(ReassemblerType rtype, int64_t delta)
+		{
+		total_size += delta;
+		sizes[rtype] += delta;
+		}
+
 	void SetMaxOldBlocks(uint32_t count)	{ max_old_blocks = count; }
 
 protected:
@@ -36,6 +36,7 @@ extern "C" {
 #include "iosource/PktDumper.h"
 #include "plugin/Manager.h"
 #include "broker/Manager.h"
+#include "telemetry/Manager.h"
 
 extern "C" {
 extern int select(int, fd_set *, fd_set *, fd_set *, struct timeval *);
@@ -244,6 +245,14 @@ void dispatch_packet(double t, const Packet* pkt, iosource::PktSrc* src_ps)
 			}
 		}
 
+	static auto packets_processed = telemetry_mgr->CounterInstance(
+		"zeek_packets_processed_total", "Packets processed.");
+	static auto bytes_processed = telemetry_mgr->CounterInstance(
+		"zeek_packet_bytes_processed_total", "Bytes of packets processed, as seen on the wire.");
+
+	packets_processed->Inc();
+	bytes_processed->Inc(pkt->len);
+
 	sessions->NextPacket(t, pkt);
 	event_mgr.Drain();
 
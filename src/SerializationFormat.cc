@@ -63,6 +63,14 @@ uint32_t SerializationFormat::EndWrite(char** data)
 	return rval;
 	}
 
+uint32_t SerializationFormat::EndWrite(std::string* data)
+	{
+	uint32_t rval = output_pos;
+	data->assign(output, output_pos);
+	output_pos = 0;
+	return rval;
+	}
+
 bool SerializationFormat::ReadData(void* b, size_t count)
 	{
 	if ( input_pos + count > input_len )
@@ -82,10 +90,13 @@ bool SerializationFormat::ReadData(void* b, size_t count)
 bool SerializationFormat::WriteData(const void* b, size_t count)
 	{
 	// Increase buffer if necessary.
-	while ( output_pos + count > output_size )
-		output_size *= GROWTH_FACTOR;
+	if ( output_pos + count > output_size )
+		{
+		while ( output_pos + count > output_size )
+			output_size *= GROWTH_FACTOR;
 
-	output = (char*)util::safe_realloc(output, output_size);
+		output = (char*)util::safe_realloc(output, output_size);
+		}
 
 	memcpy(output + output_pos, b, count);
 	output_pos += count;
@@ -224,15 +235,23 @@ bool BinarySerializationFormat::Read(char** str, int* len, const char* tag)
 
 bool BinarySerializationFormat::Read(std::string* v, const char* tag)
 	{
-	char* buffer;
-	int len;
+	// Reads straight into the string rather than going through a
+	// temporary buffer like Read(char**, ...).
+	int l;
+	if ( ! ReadData(&l, sizeof(l)) )
+		return false;
 
-	if ( ! Read(&buffer, &len, tag) )
+	l = ntohl(l);
+
+	if ( l < 0 )
 		return false;
 
-	*v = std::string(buffer, len);
+	v->resize(l);
+
+	if ( l > 0 && ! ReadData(&(*v)[0], l) )
+		return false;
 
-	delete [] buffer;
+	DBG_LOG(DBG_SERIAL, "Read %d bytes |%s| [%s]", l, util::fmt_bytes(v->data(), l), tag);
 	return true;
 	}
 
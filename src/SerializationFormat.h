@@ -57,6 +57,15 @@ public:
 	 */
 	virtual uint32_t EndWrite(char** data);
 
+	/**
+	 * Retrieves serialized data by copying it into a string. Unlike the
+	 * other version, this keeps the internal buffer around so that the
+	 * next StartWrite() can reuse it.
+	 * @param data The string to store the serialized data in.
+	 * @return The number of bytes written to \a data.
+	 */
+	virtual uint32_t EndWrite(std::string* data);
+
 	virtual bool Write(int v, const char* tag) = 0;
 	virtual bool Write(uint16_t v, const char* tag) = 0;
 	virtual bool Write(uint32_t v, const char* tag) = 0;
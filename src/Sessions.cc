@@ -28,6 +28,7 @@
 #include "RuleMatcher.h"
 
 #include "TunnelEncapsulation.h"
+#include "telemetry/Latency.h"
 
 #include "analyzer/Manager.h"
 #include "iosource/IOSource.h"
@@ -118,8 +119,8 @@ NetSessions::~NetSessions()
 		Unref(entry.second);
 	for ( const auto& entry : icmp_conns )
 		Unref(entry.second);
-	for ( const auto& entry : fragments )
-		Unref(entry.second);
+
+	fragments.Clear();
 	}
 
 void NetSessions::Done()
@@ -129,6 +130,11 @@ void NetSessions::Done()
 void NetSessions::NextPacket(double t, const Packet* pkt)
 	{
 	detail::SegmentProfiler prof(detail::segment_logger, "dispatching-packet");
+	telemetry::LatencyTimer latency(telemetry::StageLatency(telemetry::Stage::Sessions));
+
+	if ( num_flow_shards > 1 &&
+	     pkt->FlowHash(flow_shard_ports) % num_flow_shards != flow_shard )
+		return;
 
 	if ( raw_packet )
 		event_mgr.Enqueue(raw_packet, pkt->ToRawPktHdrVal());
@@ -667,13 +673,10 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 	}
 
 	detail::ConnIDKey key = detail::BuildConnIDKey(id);
-	Connection* conn = nullptr;
 
 	// FIXME: The following is getting pretty complex. Need to split up
 	// into separate functions.
-	auto it = d->find(key);
-	if ( it != d->end() )
-		conn = it->second;
+	Connection* conn = LookupConn(*d, key);
 
 	if ( ! conn )
 		{
@@ -909,17 +912,27 @@ detail::FragReassembler* NetSessions::NextFragment(double t, const IP_Hdr* ip,
 
 	detail::FragReassemblerKey key = std::make_tuple(ip->SrcAddr(), ip->DstAddr(), frag_id);
 
-	detail::FragReassembler* f = nullptr;
-	auto it = fragments.find(key);
-	if ( it != fragments.end() )
-		f = it->second;
+	detail::FragReassembler* f = fragments.Lookup(key);
 
 	if ( ! f )
 		{
+		// Make room by giving up on the datagrams that have gone the
+		// longest without a fragment.
+		while ( detail::frag_max_datagrams > 0 &&
+		        fragments.Size() >= static_cast<size_t>(detail::frag_max_datagrams) )
+			{
+			auto oldest = fragments.LeastRecentlyActive();
+
+			if ( ! oldest )
+				break;
+
+			oldest->Evict();
+			}
+
 		f = new detail::FragReassembler(this, ip, pkt, key, t);
-		fragments[key] = f;
-		if ( fragments.size() > stats.max_fragments )
-			stats.max_fragments = fragments.size();
+		fragments.Insert(f);
+		if ( fragments.Size() > stats.max_fragments )
+			stats.max_fragments = fragments.Size();
 		return f;
 		}
 
@@ -995,12 +1008,7 @@ Connection* NetSessions::FindConnection(Val* v)
 		return nullptr;
 		}
 
-	Connection* conn = nullptr;
-	auto it = d->find(key);
-	if ( it != d->end() )
-		conn = it->second;
-
-	return conn;
+	return LookupConn(*d, key);
 	}
 
 void NetSessions::Remove(Connection* c)
@@ -1049,6 +1057,7 @@ void NetSessions::Remove(Connection* c)
 			break;
 		}
 
+		FlowCacheRemove(key, c);
 		Unref(c);
 		}
 	}
@@ -1058,10 +1067,8 @@ void NetSessions::Remove(detail::FragReassembler* f)
 	if ( ! f )
 		return;
 
-	if ( fragments.erase(f->Key()) == 0 )
+	if ( ! fragments.Remove(f) )
 		reporter->InternalWarning("fragment reassembler not in dict");
-
-	Unref(f);
 	}
 
 void NetSessions::Insert(Connection* c)
@@ -1140,13 +1147,14 @@ void NetSessions::Clear()
 		Unref(entry.second);
 	for ( const auto& entry : icmp_conns )
 		Unref(entry.second);
-	for ( const auto& entry : fragments )
-		Unref(entry.second);
 
 	tcp_conns.clear();
 	udp_conns.clear();
 	icmp_conns.clear();
-	fragments.clear();
+	fragments.Clear();
+
+	for ( auto& entry : flow_cache )
+		entry = {};
 	}
 
 void NetSessions::GetStats(SessionStats& s) const
@@ -1157,7 +1165,7 @@ void NetSessions::GetStats(SessionStats& s) const
 	s.cumulative_UDP_conns = stats.cumulative_UDP_conns;
 	s.num_ICMP_conns = icmp_conns.size();
 	s.cumulative_ICMP_conns = stats.cumulative_ICMP_conns;
-	s.num_fragments = fragments.size();
+	s.num_fragments = fragments.Size();
 	s.num_packets = num_packets_processed;
 
 	s.max_TCP_conns = stats.max_TCP_conns;
@@ -1228,11 +1236,44 @@ Connection* NetSessions::NewConn(const detail::ConnIDKey& k, double t, const Con
 
 Connection* NetSessions::LookupConn(const ConnectionMap& conns, const detail::ConnIDKey& key)
 	{
+	FlowCacheEntry& slot = FlowCacheSlot(key);
+
+	if ( slot.conn && slot.map == &conns && slot.key == key )
+		return slot.conn;
+
 	auto it = conns.find(key);
-	if ( it != conns.end() )
-		return it->second;
+	if ( it == conns.end() )
+		return nullptr;
 
-	return nullptr;
+	slot.key = key;
+	slot.map = &conns;
+	slot.conn = it->second;
+
+	return it->second;
+	}
+
+NetSessions::FlowCacheEntry& NetSessions::FlowCacheSlot(const detail::ConnIDKey& key)
+	{
+	static_assert(sizeof(key) % sizeof(uint32_t) == 0);
+	static_assert((FLOW_CACHE_SIZE & (FLOW_CACHE_SIZE - 1)) == 0);
+
+	uint32_t words[sizeof(key) / sizeof(uint32_t)];
+	memcpy(words, &key, sizeof(key));
+
+	uint32_t h = 0;
+
+	for ( auto w : words )
+		h = (h ^ w) * 0x9e3779b1;
+
+	return flow_cache[(h ^ (h >> 16)) & (FLOW_CACHE_SIZE - 1)];
+	}
+
+void NetSessions::FlowCacheRemove(const detail::ConnIDKey& key, const Connection* conn)
+	{
+	FlowCacheEntry& slot = FlowCacheSlot(key);
+
+	if ( slot.conn == conn )
+		slot = {};
 	}
 
 bool NetSessions::IsLikelyServerPort(uint32_t port, TransportProto proto) const
@@ -1398,7 +1439,7 @@ unsigned int NetSessions::MemoryAllocation()
 		+ (tcp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
 		+ (udp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
 		+ (icmp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
-		+ (fragments.size() * (sizeof(FragmentMap::key_type) + sizeof(FragmentMap::value_type)))
+		+ fragments.MemoryAllocation()
 		// FIXME: MemoryAllocation() not implemented for rest.
 		;
 	}
@@ -1407,6 +1448,11 @@ void NetSessions::InsertConnection(ConnectionMap* m, const detail::ConnIDKey& ke
 	{
 	(*m)[key] = conn;
 
+	FlowCacheEntry& slot = FlowCacheSlot(key);
+	slot.key = key;
+	slot.map = m;
+	slot.conn = conn;
+
 	switch ( conn->ConnTransport() )
 		{
 		case TRANSPORT_TCP:
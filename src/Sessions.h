@@ -96,6 +96,25 @@ public:
 
 	analyzer::stepping_stone::SteppingStoneManager* GetSTPManager()	{ return stp_manager; }
 
+	/**
+	 * Restricts processing to the packets whose flow hash falls into a
+	 * given shard, so that several processes reading the same traffic
+	 * each analyze a share of its flows. See Packet::FlowHash(). Packets
+	 * other than IP go to shard 0.
+	 *
+	 * @param num_shards The number of shards; 1 processes all packets.
+	 *
+	 * @param shard The shard to process, less than *num_shards*.
+	 *
+	 * @param with_ports Whether the flow hash includes ports.
+	 */
+	void SetFlowShard(uint32_t num_shards, uint32_t shard, bool with_ports)
+		{
+		num_flow_shards = num_shards;
+		flow_shard = shard;
+		flow_shard_ports = with_ports;
+		}
+
 	unsigned int CurrentConnections()
 		{
 		return tcp_conns.size() + udp_conns.size() + icmp_conns.size();
@@ -178,7 +197,6 @@ protected:
 	friend class detail::IPTunnelTimer;
 
 	using ConnectionMap = std::map<detail::ConnIDKey, Connection*>;
-	using FragmentMap = std::map<detail::FragReassemblerKey, detail::FragReassembler*>;
 
 	Connection* NewConn(const detail::ConnIDKey& k, double t, const ConnID* id,
 			const u_char* data, int proto, uint32_t flow_label,
@@ -222,10 +240,27 @@ protected:
 	// avoid unnecessary incrementing of connecting counts).
 	void InsertConnection(ConnectionMap* m, const detail::ConnIDKey& key, Connection* conn);
 
+	// A direct-mapped cache in front of the connection maps. Most
+	// packets belong to one of a few active flows, for which a hit in
+	// the cache saves walking the map. An entry is valid only while its
+	// connection is in the map under the entry's key: everything that
+	// changes the maps must go through InsertConnection(), Remove(),
+	// Insert() or Clear(), which keep the cache in sync.
+	struct FlowCacheEntry {
+		detail::ConnIDKey key;
+		const ConnectionMap* map = nullptr;
+		Connection* conn = nullptr;
+	};
+
+	static constexpr size_t FLOW_CACHE_SIZE = 4096;	// must be a power of two
+
+	FlowCacheEntry& FlowCacheSlot(const detail::ConnIDKey& key);
+	void FlowCacheRemove(const detail::ConnIDKey& key, const Connection* conn);
+
 	ConnectionMap tcp_conns;
 	ConnectionMap udp_conns;
 	ConnectionMap icmp_conns;
-	FragmentMap fragments;
+	detail::FragmentTable fragments;
 
 	SessionStats stats;
 
@@ -240,8 +275,12 @@ protected:
 	detail::Discarder* discarder;
 	detail::PacketFilter* packet_filter;
 	uint64_t num_packets_processed;
+	uint32_t num_flow_shards = 1;
+	uint32_t flow_shard = 0;
+	bool flow_shard_ports = true;
 	detail::PacketProfiler* pkt_profiler;
 	bool dump_this_packet;	// if true, current packet should be recorded
+	FlowCacheEntry flow_cache[FLOW_CACHE_SIZE];
 };
 
 namespace detail {
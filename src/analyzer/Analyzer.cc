@@ -9,6 +9,7 @@
 #include "analyzer/protocol/pia/PIA.h"
 #include "../ZeekString.h"
 #include "../Event.h"
+#include "../telemetry/Latency.h"
 
 namespace zeek::analyzer {
 
@@ -214,6 +215,8 @@ void Analyzer::NextPacket(int len, const u_char* data, bool is_orig, uint64_t se
 	if ( skip )
 		return;
 
+	telemetry::LatencyTimer latency(telemetry::AnalyzerLatency(this, false));
+
 	SupportAnalyzer* next_sibling = FirstSupportAnalyzer(is_orig);
 
 	if ( next_sibling )
@@ -237,6 +240,8 @@ void Analyzer::NextStream(int len, const u_char* data, bool is_orig)
 	if ( skip )
 		return;
 
+	telemetry::LatencyTimer latency(telemetry::AnalyzerLatency(this, true));
+
 	SupportAnalyzer* next_sibling = FirstSupportAnalyzer(is_orig);
 
 	if ( next_sibling )
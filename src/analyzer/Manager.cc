@@ -42,35 +42,43 @@ Manager::ConnIndex::ConnIndex()
 	proto = 0;
 	}
 
-bool Manager::ConnIndex::operator<(const ConnIndex& other) const
+bool Manager::ConnIndex::operator==(const ConnIndex& other) const
 	{
-	if ( orig != other.orig )
-		return orig < other.orig;
+	return orig == other.orig && resp == other.resp &&
+		proto == other.proto && resp_p == other.resp_p;
+	}
 
-	if ( resp != other.resp )
-		return resp < other.resp;
+size_t Manager::ConnIndex::Hasher::operator()(const ConnIndex& c) const
+	{
+	uint32_t orig[4];
+	uint32_t resp[4];
+	c.orig.CopyIPv6(orig);
+	c.resp.CopyIPv6(resp);
 
-	if ( proto != other.proto )
-		return proto < other.proto;
+	uint64_t h = (uint64_t(c.proto) << 16) | c.resp_p;
 
-	if ( resp_p != other.resp_p )
-		return resp_p < other.resp_p;
+	for ( int i = 0; i < 4; ++i )
+		{
+		h = (h ^ orig[i]) * 0x9e3779b97f4a7c15ULL;
+		h = (h ^ resp[i]) * 0x9e3779b97f4a7c15ULL;
+		}
 
-	return false;
+	return h ^ (h >> 32);
 	}
 
 Manager::Manager()
-	: plugin::ComponentManager<analyzer::Tag, analyzer::Component>("Analyzer", "Tag")
+	: plugin::ComponentManager<analyzer::Tag, analyzer::Component>("Analyzer", "Tag"),
+	  analyzers_by_port_tcp(NUM_PORTS), analyzers_by_port_udp(NUM_PORTS)
 	{
 	}
 
 Manager::~Manager()
 	{
-	for ( analyzer_map_by_port::const_iterator i = analyzers_by_port_tcp.begin(); i != analyzers_by_port_tcp.end(); i++ )
-		delete i->second;
+	for ( auto l : analyzers_by_port_tcp )
+		delete l;
 
-	for ( analyzer_map_by_port::const_iterator i = analyzers_by_port_udp.begin(); i != analyzers_by_port_udp.end(); i++ )
-		delete i->second;
+	for ( auto l : analyzers_by_port_udp )
+		delete l;
 
 	// Clean up expected-connection table.
 	while ( conns_by_timeout.size() )
@@ -115,24 +123,34 @@ void Manager::DumpDebug()
 	DBG_LOG(DBG_ANALYZER, " ");
 	DBG_LOG(DBG_ANALYZER, "Analyzers by port:");
 
-	for ( analyzer_map_by_port::const_iterator i = analyzers_by_port_tcp.begin(); i != analyzers_by_port_tcp.end(); i++ )
+	for ( size_t port = 0; port < analyzers_by_port_tcp.size(); ++port )
 		{
+		tag_set* l = analyzers_by_port_tcp[port];
+
+		if ( ! l )
+			continue;
+
 		std::string s;
 
-		for ( tag_set::const_iterator j = i->second->begin(); j != i->second->end(); j++ )
+		for ( tag_set::const_iterator j = l->begin(); j != l->end(); j++ )
 			s += std::string(GetComponentName(*j)) + " ";
 
-		DBG_LOG(DBG_ANALYZER, "    %d/tcp: %s", i->first, s.c_str());
+		DBG_LOG(DBG_ANALYZER, "    %zu/tcp: %s", port, s.c_str());
 		}
 
-	for ( analyzer_map_by_port::const_iterator i = analyzers_by_port_udp.begin(); i != analyzers_by_port_udp.end(); i++ )
+	for ( size_t port = 0; port < analyzers_by_port_udp.size(); ++port )
 		{
+		tag_set* l = analyzers_by_port_udp[port];
+
+		if ( ! l )
+			continue;
+
 		std::string s;
 
-		for ( tag_set::const_iterator j = i->second->begin(); j != i->second->end(); j++ )
+		for ( tag_set::const_iterator j = l->begin(); j != l->end(); j++ )
 			s += std::string(GetComponentName(*j)) + " ";
 
-		DBG_LOG(DBG_ANALYZER, "    %d/udp: %s", i->first, s.c_str());
+		DBG_LOG(DBG_ANALYZER, "    %zu/udp: %s", port, s.c_str());
 		}
 
 #endif
@@ -270,7 +288,7 @@ bool Manager::RegisterAnalyzerForPort(const Tag& tag, TransportProto proto, uint
 
 bool Manager::UnregisterAnalyzerForPort(const Tag& tag, TransportProto proto, uint32_t port)
 	{
-	tag_set* l = LookupPort(proto, port, true);
+	tag_set* l = LookupPort(proto, port, false);
 
 	if ( ! l )
 		return true;  // still a "successful" unregistration
@@ -341,16 +359,19 @@ Manager::tag_set* Manager::LookupPort(TransportProto proto, uint32_t port, bool
 		return nullptr;
 	}
 
-	analyzer_map_by_port::const_iterator i = m->find(port);
-
-	if ( i != m->end() )
-		return i->second;
+	if ( port >= m->size() )
+		{
+		if ( add_if_not_found )
+			reporter->InternalWarning("invalid port %" PRIu32 " in analyzer::Manager::LookupPort", port);
 
-	if ( ! add_if_not_found )
 		return nullptr;
+		}
+
+	tag_set*& l = (*m)[port];
+
+	if ( ! l && add_if_not_found )
+		l = new tag_set;
 
-	tag_set* l = new tag_set;
-	m->insert(std::make_pair(port, l));
 	return l;
 	}
 
@@ -582,13 +603,17 @@ void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp, PortVal*
 
 Manager::tag_set Manager::GetScheduled(const Connection* conn)
 	{
+	tag_set result;
+
+	// The common case, and cheaper than computing the index.
+	if ( conns.empty() )
+		return result;
+
 	ConnIndex c(conn->OrigAddr(), conn->RespAddr(),
 		    ntohs(conn->RespPort()), conn->ConnTransport());
 
 	std::pair<conns_map::iterator, conns_map::iterator> all = conns.equal_range(c);
 
-	tag_set result;
-
 	for ( conns_map::iterator i = all.first; i != all.second; i++ )
 		result.insert(i->second->analyzer);
 
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <queue>
+#include <unordered_map>
 #include <vector>
 
 #include "Analyzer.h"
@@ -346,7 +347,11 @@ public:
 private:
 
 	using tag_set = std::set<Tag>;
-	using analyzer_map_by_port = std::map<uint32_t, tag_set*>;
+
+	// Indexed directly by port number; entries for ports without any
+	// analyzers are null.
+	using analyzer_map_by_port = std::vector<tag_set*>;
+	static constexpr size_t NUM_PORTS = 65536;
 
 	tag_set* LookupPort(PortVal* val, bool add_if_not_found);
 	tag_set* LookupPort(TransportProto proto, uint32_t port, bool add_if_not_found);
@@ -374,7 +379,11 @@ private:
 			     uint16_t _resp_p, uint16_t _proto);
 		ConnIndex();
 
-		bool operator<(const ConnIndex& other) const;
+		bool operator==(const ConnIndex& other) const;
+
+		struct Hasher {
+			size_t operator()(const ConnIndex& c) const;
+		};
 	};
 
 	// Information associated with a scheduled connection.
@@ -390,7 +399,8 @@ private:
 		};
 	};
 
-	using conns_map = std::multimap<ConnIndex, ScheduledAnalyzer*>;
+	using conns_map = std::unordered_multimap<ConnIndex, ScheduledAnalyzer*,
+	                                          ConnIndex::Hasher>;
 	using conns_queue = std::priority_queue<ScheduledAnalyzer*,
 	                                        std::vector<ScheduledAnalyzer*>,
 	                                        ScheduledAnalyzer::Comparator>;
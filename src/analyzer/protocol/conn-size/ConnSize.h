@@ -5,10 +5,12 @@
 
 #include "analyzer/Analyzer.h"
 #include "NetVar.h"
+#include "ObjectPool.h"
 
 namespace zeek::analyzer::conn_size {
 
-class ConnSize_Analyzer : public analyzer::Analyzer {
+class ConnSize_Analyzer : public analyzer::Analyzer,
+                          public zeek::detail::PoolAllocated<ConnSize_Analyzer> {
 public:
 	explicit ConnSize_Analyzer(Connection* c);
 	~ConnSize_Analyzer() override;
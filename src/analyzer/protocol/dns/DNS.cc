@@ -223,8 +223,8 @@ bool DNS_Interpreter::ParseAnswer(detail::DNS_MsgInfo* msg,
                                   const u_char*& data, int& len,
                                   const u_char* msg_start)
 	{
-	u_char name[513];
-	int name_len = sizeof(name) - 1;
+	u_char* name = msg->query_name_buf;
+	int name_len = sizeof(msg->query_name_buf) - 1;
 
 	u_char* name_end = ExtractName(data, len, name, name_len, msg_start);
 
@@ -240,7 +240,8 @@ bool DNS_Interpreter::ParseAnswer(detail::DNS_MsgInfo* msg,
 	// Note that the exact meaning of some of these fields will be
 	// re-interpreted by other, more adventurous RR types.
 
-	msg->query_name = make_intrusive<StringVal>(new String(name, name_end - name, true));
+	msg->query_name_len = name_end - name;
+	msg->query_name = nullptr;
 	msg->atype = detail::RR_Type(ExtractShort(data, len));
 	msg->aclass = ExtractShort(data, len);
 	msg->ttl = ExtractLong(data, len);
@@ -778,11 +779,12 @@ bool DNS_Interpreter::ParseRR_EDNS(detail::DNS_MsgInfo* msg,
 					break;
 					}
 
-				analyzer->EnqueueConnEvent(dns_EDNS_ecs,
-					analyzer->ConnVal(),
-					msg->BuildHdrVal(),
-					msg->BuildEDNS_ECS_Val(&opt)
-				);
+				if ( dns_EDNS_ecs )
+					analyzer->EnqueueConnEvent(dns_EDNS_ecs,
+						analyzer->ConnVal(),
+						msg->BuildHdrVal(),
+						msg->BuildEDNS_ECS_Val(&opt)
+					);
 				break;
 				} // END EDNS ECS
 
@@ -810,11 +812,12 @@ bool DNS_Interpreter::ParseRR_EDNS(detail::DNS_MsgInfo* msg,
 						analyzer->Weird("EDNS_TCP_Keepalive_In_UDP");
 						}
 
-					analyzer->EnqueueConnEvent(dns_EDNS_tcp_keepalive,
-						analyzer->ConnVal(),
-						msg->BuildHdrVal(),
-						msg->BuildEDNS_TCP_KA_Val(&edns_tcp_keepalive)
-					);
+					if ( dns_EDNS_tcp_keepalive )
+						analyzer->EnqueueConnEvent(dns_EDNS_tcp_keepalive,
+							analyzer->ConnVal(),
+							msg->BuildHdrVal(),
+							msg->BuildEDNS_TCP_KA_Val(&edns_tcp_keepalive)
+						);
 
 					}
 				else
@@ -840,6 +843,12 @@ bool DNS_Interpreter::ParseRR_EDNS(detail::DNS_MsgInfo* msg,
 					break;
 					}
 
+				if ( ! dns_EDNS_cookie )
+					{
+					data += option_len;
+					break;
+					}
+
 				int client_cookie_len = 8;
 				int server_cookie_len = option_len - client_cookie_len;
 
@@ -895,6 +904,15 @@ String* DNS_Interpreter::ExtractStream(const u_char*& data, int& len, int l)
 	return rval;
 	}
 
+void DNS_Interpreter::SkipStream(const u_char*& data, int& len, int l)
+	{
+	l = max(l, 0);
+	int dlen = min(len, l);
+
+	data += dlen;
+	len -= dlen;
+	}
+
 bool DNS_Interpreter::ParseRR_TSIG(detail::DNS_MsgInfo* msg,
                                    const u_char*& data, int& len, int rdlength,
                                    const u_char* msg_start)
@@ -944,12 +962,9 @@ bool DNS_Interpreter::ParseRR_RRSIG(detail::DNS_MsgInfo* msg,
                                     const u_char*& data, int& len, int rdlength,
                                     const u_char* msg_start)
 	{
-	if ( ! dns_RRSIG || msg->skip_event )
-		{
-		data += rdlength;
-		len -= rdlength;
-		return true;
-		}
+	// The RDATA is validated even if the event isn't raised, so that
+	// weirds don't depend on which events a script handles.
+	bool raise_event = dns_RRSIG && ! msg->skip_event;
 
 	if ( len < 18 )
 		return false;
@@ -976,7 +991,12 @@ bool DNS_Interpreter::ParseRR_RRSIG(detail::DNS_MsgInfo* msg,
 
 	int sig_len = rdlength - ((data - data_start) + 18);
 	detail::DNSSEC_Algo dsa = detail::DNSSEC_Algo(algo);
-	String* sign = ExtractStream(data, len, sig_len);
+	String* sign = nullptr;
+
+	if ( raise_event )
+		sign = ExtractStream(data, len, sig_len);
+	else
+		SkipStream(data, len, sig_len);
 
 	switch ( dsa ) {
 		case detail::RSA_MD5:
@@ -1018,7 +1038,7 @@ bool DNS_Interpreter::ParseRR_RRSIG(detail::DNS_MsgInfo* msg,
 			break;
 	}
 
-	if ( dns_RRSIG )
+	if ( raise_event )
 		{
 		detail::RRSIG_DATA rrsig;
 		rrsig.type_covered = type_covered;
@@ -1046,12 +1066,7 @@ bool DNS_Interpreter::ParseRR_DNSKEY(detail::DNS_MsgInfo* msg,
                                      const u_char*& data, int& len, int rdlength,
                                      const u_char* msg_start)
 	{
-	if ( ! dns_DNSKEY || msg->skip_event )
-		{
-		data += rdlength;
-		len -= rdlength;
-		return true;
-		}
+	bool raise_event = dns_DNSKEY && ! msg->skip_event;
 
 	if ( len < 4 )
 		return false;
@@ -1063,7 +1078,12 @@ bool DNS_Interpreter::ParseRR_DNSKEY(detail::DNS_MsgInfo* msg,
 	unsigned int dalgorithm = proto_algo & 0xff;
 	detail::DNSSEC_Algo dsa = detail::DNSSEC_Algo(dalgorithm);
 	//Evaluating the size of remaining bytes for Public Key
-	String* key = ExtractStream(data, len, rdlength - 4);
+	String* key = nullptr;
+
+	if ( raise_event )
+		key = ExtractStream(data, len, rdlength - 4);
+	else
+		SkipStream(data, len, rdlength - 4);
 
 	// flags bit  7: zone key
 	// flags bit  8: revoked
@@ -1118,7 +1138,7 @@ bool DNS_Interpreter::ParseRR_DNSKEY(detail::DNS_MsgInfo* msg,
 			break;
 	}
 
-	if ( dns_DNSKEY )
+	if ( raise_event )
 		{
 		detail::DNSKEY_DATA dnskey;
 		dnskey.dflags = dflags;
@@ -1141,12 +1161,7 @@ bool DNS_Interpreter::ParseRR_NSEC(detail::DNS_MsgInfo* msg,
                                    const u_char*& data, int& len, int rdlength,
                                    const u_char* msg_start)
 	{
-	if ( ! dns_NSEC || msg->skip_event )
-		{
-		data += rdlength;
-		len -= rdlength;
-		return true;
-		}
+	bool raise_event = dns_NSEC && ! msg->skip_event;
 
 	const u_char* data_start = data;
 	u_char name[513];
@@ -1158,7 +1173,10 @@ bool DNS_Interpreter::ParseRR_NSEC(detail::DNS_MsgInfo* msg,
 
 	int typebitmaps_len = rdlength - (data - data_start);
 
-	auto char_strings = make_intrusive<VectorVal>(id::string_vec);
+	VectorValPtr char_strings;
+
+	if ( raise_event )
+		char_strings = make_intrusive<VectorVal>(id::string_vec);
 
 	while ( typebitmaps_len > 0 && len > 0 )
 		{
@@ -1172,12 +1190,18 @@ bool DNS_Interpreter::ParseRR_NSEC(detail::DNS_MsgInfo* msg,
 			break;
 			}
 
-		String* bitmap = ExtractStream(data, len, bmlen);
-		char_strings->Assign(char_strings->Size(), make_intrusive<StringVal>(bitmap));
+		if ( char_strings )
+			{
+			String* bitmap = ExtractStream(data, len, bmlen);
+			char_strings->Assign(char_strings->Size(), make_intrusive<StringVal>(bitmap));
+			}
+		else
+			SkipStream(data, len, bmlen);
+
 		typebitmaps_len = typebitmaps_len - (2 + bmlen);
 		}
 
-	if ( dns_NSEC )
+	if ( raise_event )
 		analyzer->EnqueueConnEvent(dns_NSEC,
 			analyzer->ConnVal(),
 			msg->BuildHdrVal(),
@@ -1193,12 +1217,7 @@ bool DNS_Interpreter::ParseRR_NSEC3(detail::DNS_MsgInfo* msg,
                                     const u_char*& data, int& len, int rdlength,
                                     const u_char* msg_start)
 	{
-	if ( ! dns_NSEC3 || msg->skip_event )
-		{
-		data += rdlength;
-		len -= rdlength;
-		return true;
-		}
+	bool raise_event = dns_NSEC3 && ! msg->skip_event;
 
 	if ( len < 6 )
 		return false;
@@ -1218,7 +1237,12 @@ bool DNS_Interpreter::ParseRR_NSEC3(detail::DNS_MsgInfo* msg,
 		--len;
 		}
 
-	auto salt_val = ExtractStream(data, len, static_cast<int>(salt_len));
+	String* salt_val = nullptr;
+
+	if ( raise_event )
+		salt_val = ExtractStream(data, len, static_cast<int>(salt_len));
+	else
+		SkipStream(data, len, static_cast<int>(salt_len));
 
 	uint8_t hash_len = 0;
 
@@ -1229,11 +1253,19 @@ bool DNS_Interpreter::ParseRR_NSEC3(detail::DNS_MsgInfo* msg,
 		--len;
 		}
 
-	auto hash_val = ExtractStream(data, len, static_cast<int>(hash_len));
+	String* hash_val = nullptr;
+
+	if ( raise_event )
+		hash_val = ExtractStream(data, len, static_cast<int>(hash_len));
+	else
+		SkipStream(data, len, static_cast<int>(hash_len));
 
 	int typebitmaps_len = rdlength - (data - data_start);
 
-	auto char_strings = make_intrusive<VectorVal>(id::string_vec);
+	VectorValPtr char_strings;
+
+	if ( raise_event )
+		char_strings = make_intrusive<VectorVal>(id::string_vec);
 
 	while ( typebitmaps_len > 0 && len > 0 )
 		{
@@ -1247,12 +1279,18 @@ bool DNS_Interpreter::ParseRR_NSEC3(detail::DNS_MsgInfo* msg,
 			break;
 			}
 
-		String* bitmap = ExtractStream(data, len, bmlen);
-		char_strings->Assign(char_strings->Size(), make_intrusive<StringVal>(bitmap));
+		if ( char_strings )
+			{
+			String* bitmap = ExtractStream(data, len, bmlen);
+			char_strings->Assign(char_strings->Size(), make_intrusive<StringVal>(bitmap));
+			}
+		else
+			SkipStream(data, len, bmlen);
+
 		typebitmaps_len = typebitmaps_len - (2 + bmlen);
 		}
 
-	if ( dns_NSEC3 )
+	if ( raise_event )
 		{
 		detail::NSEC3_DATA nsec3;
 		nsec3.nsec_flags = nsec_flags;
@@ -1279,12 +1317,7 @@ bool DNS_Interpreter::ParseRR_DS(detail::DNS_MsgInfo* msg,
                                  const u_char*& data, int& len, int rdlength,
                                  const u_char* msg_start)
 	{
-	if ( ! dns_DS || msg->skip_event )
-		{
-		data += rdlength;
-		len -= rdlength;
-		return true;
-		}
+	bool raise_event = dns_DS && ! msg->skip_event;
 
 	if ( len < 4 )
 		return false;
@@ -1295,7 +1328,12 @@ bool DNS_Interpreter::ParseRR_DS(detail::DNS_MsgInfo* msg,
 	unsigned int ds_algo = (ds_algo_dtype >> 8) & 0xff;
 	unsigned int ds_dtype = ds_algo_dtype & 0xff;
 	detail::DNSSEC_Digest ds_digest_type = detail::DNSSEC_Digest(ds_dtype);
-	String* ds_digest = ExtractStream(data, len, rdlength - 4);
+	String* ds_digest = nullptr;
+
+	if ( raise_event )
+		ds_digest = ExtractStream(data, len, rdlength - 4);
+	else
+		SkipStream(data, len, rdlength - 4);
 
 	switch ( ds_digest_type ) {
 		case detail::SHA1:
@@ -1314,7 +1352,7 @@ bool DNS_Interpreter::ParseRR_DS(detail::DNS_MsgInfo* msg,
 			break;
 	}
 
-	if ( dns_DS )
+	if ( raise_event )
 		{
 		detail::DS_DATA ds;
 		ds.key_tag = ds_key_tag;
@@ -1409,12 +1447,15 @@ bool DNS_Interpreter::ParseRR_HINFO(detail::DNS_MsgInfo* msg,
 	return true;
 	}
 
-static StringValPtr
+// Extracts one character-string and, if char_strings is given, appends
+// it to that vector.  Returns false once the RDATA is exhausted or malformed.
+static bool
 extract_char_string(analyzer::Analyzer* analyzer,
-                    const u_char*& data, int& len, int& rdlen)
+                    const u_char*& data, int& len, int& rdlen,
+                    VectorVal* char_strings)
 	{
 	if ( rdlen <= 0 )
-		return nullptr;
+		return false;
 
 	uint8_t str_size = data[0];
 
@@ -1425,36 +1466,35 @@ extract_char_string(analyzer::Analyzer* analyzer,
 	if ( str_size > rdlen )
 		{
 		analyzer->Weird("DNS_TXT_char_str_past_rdlen");
-		return nullptr;
+		return false;
 		}
 
-	auto rval = make_intrusive<StringVal>(str_size, reinterpret_cast<const char*>(data));
+	if ( char_strings )
+		char_strings->Assign(char_strings->Size(),
+			make_intrusive<StringVal>(str_size, reinterpret_cast<const char*>(data)));
 
 	rdlen -= str_size;
 	len -= str_size;
 	data += str_size;
 
-	return rval;
+	return true;
 	}
 
 bool DNS_Interpreter::ParseRR_TXT(detail::DNS_MsgInfo* msg,
                                   const u_char*& data, int& len, int rdlength,
                                   const u_char* msg_start)
 	{
-	if ( ! dns_TXT_reply || msg->skip_event )
-		{
-		data += rdlength;
-		len -= rdlength;
-		return true;
-		}
+	bool raise_event = dns_TXT_reply && ! msg->skip_event;
 
-	auto char_strings = make_intrusive<VectorVal>(id::string_vec);
-	StringValPtr char_string;
+	VectorValPtr char_strings;
 
-	while ( (char_string = extract_char_string(analyzer, data, len, rdlength)) )
-		char_strings->Assign(char_strings->Size(), std::move(char_string));
+	if ( raise_event )
+		char_strings = make_intrusive<VectorVal>(id::string_vec);
 
-	if ( dns_TXT_reply )
+	while ( extract_char_string(analyzer, data, len, rdlength, char_strings.get()) )
+		;
+
+	if ( raise_event )
 		analyzer->EnqueueConnEvent(dns_TXT_reply,
 			analyzer->ConnVal(),
 			msg->BuildHdrVal(),
@@ -1469,20 +1509,17 @@ bool DNS_Interpreter::ParseRR_SPF(detail::DNS_MsgInfo* msg,
                                   const u_char*& data, int& len, int rdlength,
                                   const u_char* msg_start)
 	{
-	if ( ! dns_SPF_reply || msg->skip_event )
-		{
-		data += rdlength;
-		len -= rdlength;
-		return true;
-		}
+	bool raise_event = dns_SPF_reply && ! msg->skip_event;
+
+	VectorValPtr char_strings;
 
-	auto char_strings = make_intrusive<VectorVal>(id::string_vec);
-	StringValPtr char_string;
+	if ( raise_event )
+		char_strings = make_intrusive<VectorVal>(id::string_vec);
 
-	while ( (char_string = extract_char_string(analyzer, data, len, rdlength)) )
-		char_strings->Assign(char_strings->Size(), std::move(char_string));
+	while ( extract_char_string(analyzer, data, len, rdlength, char_strings.get()) )
+		;
 
-	if ( dns_SPF_reply )
+	if ( raise_event )
 		analyzer->EnqueueConnEvent(dns_SPF_reply,
 			analyzer->ConnVal(),
 			msg->BuildHdrVal(),
@@ -1497,12 +1534,7 @@ bool DNS_Interpreter::ParseRR_CAA(detail::DNS_MsgInfo* msg,
                                   const u_char*& data, int& len, int rdlength,
                                   const u_char* msg_start)
 	{
-	if ( ! dns_CAA_reply || msg->skip_event )
-		{
-		data += rdlength;
-		len -= rdlength;
-		return true;
-		}
+	bool raise_event = dns_CAA_reply && ! msg->skip_event;
 
 	unsigned int flags = ExtractShort(data, len);
 	unsigned int tagLen = flags & 0xff;
@@ -1513,30 +1545,26 @@ bool DNS_Interpreter::ParseRR_CAA(detail::DNS_MsgInfo* msg,
 		analyzer->Weird("DNS_CAA_char_str_past_rdlen");
 		return false;
 		}
-	String* tag = new String(data, tagLen, true);
+	const u_char* tag = data;
 	len -= tagLen;
 	data += tagLen;
 	rdlength -= tagLen;
-	String* value = new String(data, rdlength, false);
 
-	len -= value->Len();
-	data += value->Len();
-	rdlength -= value->Len();
+	const u_char* value = data;
+	int value_len = rdlength;
+	len -= value_len;
+	data += value_len;
+	rdlength -= value_len;
 
-	if ( dns_CAA_reply )
+	if ( raise_event )
 		analyzer->EnqueueConnEvent(dns_CAA_reply,
 			analyzer->ConnVal(),
 			msg->BuildHdrVal(),
 			msg->BuildAnswerVal(),
 			val_mgr->Count(flags),
-			make_intrusive<StringVal>(tag),
-			make_intrusive<StringVal>(value)
+			make_intrusive<StringVal>(new String(tag, tagLen, true)),
+			make_intrusive<StringVal>(new String(value, value_len, false))
 		);
-	else
-		{
-		delete tag;
-		delete value;
-		}
 
 	return rdlength == 0;
 	}
@@ -1590,10 +1618,21 @@ DNS_MsgInfo::DNS_MsgInfo(DNS_RawMsgHdr* hdr, int arg_is_query)
 	aclass = 0;
 	ttl = 0;
 
+	query_name_len = 0;
+
 	answer_type = DNS_QUESTION;
 	skip_event = 0;
 	}
 
+const StringValPtr& DNS_MsgInfo::QueryName()
+	{
+	if ( ! query_name )
+		query_name = make_intrusive<StringVal>(
+			new String(query_name_buf, query_name_len, true));
+
+	return query_name;
+	}
+
 RecordValPtr DNS_MsgInfo::BuildHdrVal()
 	{
 	static auto dns_msg = id::find_type<RecordType>("dns_msg");
@@ -1622,7 +1661,7 @@ RecordValPtr DNS_MsgInfo::BuildAnswerVal()
 	auto r = make_intrusive<RecordVal>(dns_answer);
 
 	r->Assign(0, val_mgr->Count(int(answer_type)));
-	r->Assign(1, query_name);
+	r->Assign(1, QueryName());
 	r->Assign(2, val_mgr->Count(atype));
 	r->Assign(3, val_mgr->Count(aclass));
 	r->Assign(4, make_intrusive<IntervalVal>(double(ttl), Seconds));
@@ -1638,7 +1677,7 @@ RecordValPtr DNS_MsgInfo::BuildEDNS_Val()
 	auto r = make_intrusive<RecordVal>(dns_edns_additional);
 
 	r->Assign(0, val_mgr->Count(int(answer_type)));
-	r->Assign(1, query_name);
+	r->Assign(1, QueryName());
 
 	// type = 0x29 or 41 = EDNS
 	r->Assign(2, val_mgr->Count(atype));
@@ -1710,7 +1749,7 @@ RecordValPtr DNS_MsgInfo::BuildTSIG_Val(struct TSIG_DATA* tsig)
 	double rtime = tsig->time_s + tsig->time_ms / 1000.0;
 
 	// r->Assign(0, val_mgr->Count(int(answer_type)));
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, make_intrusive<StringVal>(tsig->alg_name));
 	r->Assign(3, make_intrusive<StringVal>(tsig->sig));
@@ -1728,7 +1767,7 @@ RecordValPtr DNS_MsgInfo::BuildRRSIG_Val(RRSIG_DATA* rrsig)
 	static auto dns_rrsig_rr = id::find_type<RecordType>("dns_rrsig_rr");
 	auto r = make_intrusive<RecordVal>(dns_rrsig_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(rrsig->type_covered));
 	r->Assign(3, val_mgr->Count(rrsig->algorithm));
@@ -1749,7 +1788,7 @@ RecordValPtr DNS_MsgInfo::BuildDNSKEY_Val(DNSKEY_DATA* dnskey)
 	static auto dns_dnskey_rr = id::find_type<RecordType>("dns_dnskey_rr");
 	auto r = make_intrusive<RecordVal>(dns_dnskey_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(dnskey->dflags));
 	r->Assign(3, val_mgr->Count(dnskey->dprotocol));
@@ -1765,7 +1804,7 @@ RecordValPtr DNS_MsgInfo::BuildNSEC3_Val(NSEC3_DATA* nsec3)
 	static auto dns_nsec3_rr = id::find_type<RecordType>("dns_nsec3_rr");
 	auto r = make_intrusive<RecordVal>(dns_nsec3_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(nsec3->nsec_flags));
 	r->Assign(3, val_mgr->Count(nsec3->nsec_hash_algo));
@@ -1785,7 +1824,7 @@ RecordValPtr DNS_MsgInfo::BuildDS_Val(DS_DATA* ds)
 	static auto dns_ds_rr = id::find_type<RecordType>("dns_ds_rr");
 	auto r = make_intrusive<RecordVal>(dns_ds_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(ds->key_tag));
 	r->Assign(3, val_mgr->Count(ds->algorithm));
@@ -4,6 +4,7 @@
 
 #include "analyzer/protocol/tcp/TCP.h"
 #include "binpac_zeek.h"
+#include "ObjectPool.h"
 
 namespace zeek::analyzer::dns {
 namespace detail {
@@ -246,7 +247,14 @@ public:
 	int arcount;	///< number of additional RRs
 	int is_query;	///< whether it came from the session initiator
 
-	StringValPtr query_name;
+	// Returns the owner name of the current RR.  The name is decoded
+	// into query_name_buf and only turned into a StringVal once an
+	// event actually needs it.
+	const StringValPtr& QueryName();
+
+	u_char query_name_buf[513];	///< scratch buffer for the RR owner name
+	int query_name_len;
+	StringValPtr query_name;	///< built lazily from query_name_buf
 	RR_Type atype;
 	int aclass;	///< normally = 1, inet
 	uint32_t ttl;
@@ -295,6 +303,7 @@ protected:
 	void ExtractOctets(const u_char*& data, int& len, String** p);
 
 	String* ExtractStream(const u_char*& data, int& len, int sig_len);
+	void SkipStream(const u_char*& data, int& len, int sig_len);
 
 	bool ParseRR_Name(detail::DNS_MsgInfo* msg,
 	                  const u_char*& data, int& len, int rdlength,
@@ -394,7 +403,8 @@ protected:
 };
 
 // Works for both TCP and UDP.
-class DNS_Analyzer final : public analyzer::tcp::TCP_ApplicationAnalyzer {
+class DNS_Analyzer final : public analyzer::tcp::TCP_ApplicationAnalyzer,
+                           public zeek::detail::PoolAllocated<DNS_Analyzer> {
 public:
 	explicit DNS_Analyzer(Connection* conn);
 	~DNS_Analyzer() override;
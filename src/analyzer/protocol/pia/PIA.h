@@ -5,6 +5,7 @@
 #include "analyzer/Analyzer.h"
 #include "analyzer/protocol/tcp/TCP.h"
 #include "RuleMatcher.h"
+#include "ObjectPool.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(RuleEndpointState, zeek::detail);
 
@@ -88,7 +89,8 @@ private:
 };
 
 // PIA for UDP.
-class PIA_UDP : public PIA, public analyzer::Analyzer {
+class PIA_UDP : public PIA, public analyzer::Analyzer,
+                public zeek::detail::PoolAllocated<PIA_UDP> {
 public:
 	explicit PIA_UDP(Connection* conn)
 	: PIA(this), Analyzer("PIA_UDP", conn)
@@ -118,7 +120,8 @@ protected:
 
 // PIA for TCP.  Accepts both packet and stream input (and reassembles
 // packets before passing payload on to children).
-class PIA_TCP : public PIA, public analyzer::tcp::TCP_ApplicationAnalyzer {
+class PIA_TCP : public PIA, public analyzer::tcp::TCP_ApplicationAnalyzer,
+                public zeek::detail::PoolAllocated<PIA_TCP> {
 public:
 	explicit PIA_TCP(Connection* conn)
 		: PIA(this), analyzer::tcp::TCP_ApplicationAnalyzer("PIA_TCP", conn)
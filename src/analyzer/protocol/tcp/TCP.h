@@ -7,6 +7,7 @@
 #include "TCP_Endpoint.h"
 #include "TCP_Flags.h"
 #include "Conn.h"
+#include "ObjectPool.h"
 
 // We define two classes here:
 // - TCP_Analyzer is the analyzer for the TCP protocol itself.
@@ -21,7 +22,8 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(TCP_ApplicationAnalyzer, zeek, analyzer::tcp);
 
 namespace zeek::analyzer::tcp {
 
-class TCP_Analyzer final : public analyzer::TransportLayerAnalyzer {
+class TCP_Analyzer final : public analyzer::TransportLayerAnalyzer,
+                           public zeek::detail::PoolAllocated<TCP_Analyzer> {
 public:
 	explicit TCP_Analyzer(Connection* conn);
 	~TCP_Analyzer() override;
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "analyzer/Analyzer.h"
+#include "ObjectPool.h"
 #include <netinet/udp.h>
 
 namespace zeek::analyzer::udp {
@@ -12,7 +13,8 @@ enum UDP_EndpointState {
 	UDP_ACTIVE,	// packets seen
 };
 
-class UDP_Analyzer final : public analyzer::TransportLayerAnalyzer {
+class UDP_Analyzer final : public analyzer::TransportLayerAnalyzer,
+                           public zeek::detail::PoolAllocated<UDP_Analyzer> {
 public:
 	explicit UDP_Analyzer(Connection* conn);
 	~UDP_Analyzer() override;
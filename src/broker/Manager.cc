@@ -2,6 +2,7 @@
 
 #include <broker/broker.hh>
 #include <broker/zeek.hh>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <unistd.h>
@@ -132,6 +133,8 @@ Manager::Manager(bool arg_use_real_time)
 	after_zeek_init = false;
 	peer_count = 0;
 	log_batch_size = 0;
+	log_batch_max_bytes = 0;
+	log_batch_max_latency = 0;
 	log_topic_func = nullptr;
 	log_id_type = nullptr;
 	writer_id_type = nullptr;
@@ -146,6 +149,8 @@ void Manager::InitPostScript()
 	DBG_LOG(DBG_BROKER, "Initializing");
 
 	log_batch_size = get_option("Broker::log_batch_size")->AsCount();
+	log_batch_max_bytes = get_option("Broker::log_batch_max_bytes")->AsCount();
+	log_batch_max_latency = get_option("Broker::log_batch_max_latency")->AsInterval();
 	default_log_topic_prefix =
 	    get_option("Broker::default_log_topic_prefix")->AsString()->CheckString();
 	log_topic_func = get_option("Broker::log_topic")->AsFunc();
@@ -577,10 +582,7 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
 		return false;
 		}
 
-	zeek::detail::BinarySerializationFormat fmt;
-	char* data;
-	int len;
-
+	auto& fmt = log_write_fmt;
 	fmt.StartWrite();
 
 	bool success = fmt.Write(num_fields, "num_fields");
@@ -600,9 +602,9 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
 			}
 		}
 
-	len = fmt.EndWrite(&data);
-	std::string serial_data(data, len);
-	free(data);
+	std::string serial_data;
+	fmt.EndWrite(&serial_data);
+	auto serial_data_len = serial_data.size();
 
 	auto v = log_topic_func->Invoke(IntrusivePtr{NewRef{}, stream},
 	                                make_intrusive<StringVal>(path));
@@ -628,17 +630,35 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
 		log_buffers.resize(stream_id_num + 1);
 
 	auto& lb = log_buffers[stream_id_num];
+
+	if ( ! lb.message_count )
+		lb.first_write = util::current_time();
+
 	++lb.message_count;
+	lb.byte_count += serial_data_len;
 	auto& pending_batch = lb.msgs[topic];
 	pending_batch.emplace_back(msg.move_data());
 
+	// Send the batch once it reaches any of its bounds. The latency bound
+	// is only checked here; streams that see no further writes are
+	// flushed by the periodic Broker::log_flush event.
 	if ( lb.message_count >= log_batch_size )
-		statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size);
+		++log_batch_statistics.num_flushes_size;
+	else if ( log_batch_max_bytes && lb.byte_count >= log_batch_max_bytes )
+		++log_batch_statistics.num_flushes_bytes;
+	else if ( log_batch_max_latency > 0 &&
+	          util::current_time() - lb.first_write >= log_batch_max_latency )
+		++log_batch_statistics.num_flushes_latency;
+	else
+		return true;
 
+	statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size,
+	                                         &log_batch_statistics);
 	return true;
 	}
 
-size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_size)
+size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_size,
+                                 LogBatchStats* stats)
 	{
 	if ( endpoint.is_shutdown() )
 		return 0;
@@ -651,15 +671,31 @@ size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_si
 		{
 		auto& topic = kv.first;
 		auto& pending_batch = kv.second;
+
+		if ( pending_batch.empty() )
+			continue;
+
 		broker::vector batch;
 		batch.reserve(log_batch_size + 1);
 		pending_batch.swap(batch);
 		broker::zeek::Batch msg(std::move(batch));
 		endpoint.publish(topic, msg.move_data());
+		++stats->num_batches;
 		}
 
+	stats->num_records += message_count;
+	stats->num_bytes += byte_count;
+	stats->max_batch_records = std::max(stats->max_batch_records, message_count);
+	stats->max_batch_bytes = std::max(stats->max_batch_bytes, byte_count);
+
+	double delay = util::current_time() - first_write;
+	stats->total_delay += delay;
+	stats->max_delay = std::max(stats->max_delay, delay);
+
 	auto rval = message_count;
 	message_count = 0;
+	byte_count = 0;
+	first_write = 0;
 	return rval;
 	}
 
@@ -669,7 +705,12 @@ size_t Manager::FlushLogBuffers()
 	auto rval = 0u;
 
 	for ( auto& lb : log_buffers )
-		rval += lb.Flush(bstate->endpoint, log_batch_size);
+		{
+		if ( lb.message_count )
+			++log_batch_statistics.num_flushes_timer;
+
+		rval += lb.Flush(bstate->endpoint, log_batch_size, &log_batch_statistics);
+		}
 
 	statistics.num_logs_outgoing += rval;
 	return rval;
@@ -754,6 +795,45 @@ RecordVal* Manager::MakeEvent(ValPList* args, zeek::detail::Frame* frame)
 	auto rval = new RecordVal(BifType::Record::Broker::Event);
 	auto arg_vec = make_intrusive<VectorVal>(vector_of_data_type);
 	rval->Assign(1, arg_vec);
+
+	std::string name;
+	broker::vector xs;
+
+	if ( ! MakeEventArgs(args, frame, &name, &xs) )
+		return rval;
+
+	rval->Assign(0, make_intrusive<StringVal>(name));
+
+	for ( auto i = 0u; i < xs.size(); ++i )
+		arg_vec->Assign(i, detail::make_data_val(std::move(xs[i])));
+
+	return rval;
+	}
+
+bool Manager::PublishEvent(string topic, ValPList* args,
+                           zeek::detail::Frame* frame)
+	{
+	// Convert before checking for peers, so that bad arguments are
+	// reported the same way as through MakeEvent().
+	std::string name;
+	broker::vector xs;
+	bool valid = MakeEventArgs(args, frame, &name, &xs);
+
+	if ( bstate->endpoint.is_shutdown() )
+		return true;
+
+	if ( peer_count == 0 )
+		return true;
+
+	if ( ! valid )
+		return false;
+
+	return PublishEvent(std::move(topic), std::move(name), std::move(xs));
+	}
+
+bool Manager::MakeEventArgs(ValPList* args, zeek::detail::Frame* frame,
+                            std::string* name, broker::vector* xs)
+	{
 	Func* func = nullptr;
 	scoped_reporter_location srl{frame};
 
@@ -768,7 +848,7 @@ RecordVal* Manager::MakeEvent(ValPList* args, zeek::detail::Frame* frame)
 			if ( arg_val->GetType()->Tag() != TYPE_FUNC )
 				{
 				Error("attempt to convert non-event into an event type");
-				return rval;
+				return false;
 				}
 
 			func = arg_val->AsFunc();
@@ -776,7 +856,7 @@ RecordVal* Manager::MakeEvent(ValPList* args, zeek::detail::Frame* frame)
 			if ( func->Flavor() != FUNC_FLAVOR_EVENT )
 				{
 				Error("attempt to convert non-event into an event type");
-				return rval;
+				return false;
 				}
 
 			auto num_args = func->GetType()->Params()->NumFields();
@@ -785,10 +865,11 @@ RecordVal* Manager::MakeEvent(ValPList* args, zeek::detail::Frame* frame)
 				{
 				Error("bad # of arguments: got %d, expect %d",
 				      args->length(), num_args + 1);
-				return rval;
+				return false;
 				}
 
-			rval->Assign(0, make_intrusive<StringVal>(func->Name()));
+			*name = func->Name();
+			xs->reserve(num_args);
 			continue;
 			}
 
@@ -797,32 +878,46 @@ RecordVal* Manager::MakeEvent(ValPList* args, zeek::detail::Frame* frame)
 
 		if ( ! same_type(got_type, expected_type) )
 			{
-			rval->Assign(0, nullptr);
 			Error("event parameter #%d type mismatch, got %s, expect %s", i,
 			      type_name(got_type->Tag()),
 			      type_name(expected_type->Tag()));
-			return rval;
+			return false;
 			}
 
-		RecordValPtr data_val;
+		bool converted = false;
 
 		if ( same_type(got_type, detail::DataVal::ScriptDataType()) )
-			data_val = {NewRef{}, (*args)[i]->AsRecordVal()};
+			{
+			const auto& data_val = (*args)[i]->AsRecordVal()->GetField(0);
+
+			if ( data_val )
+				{
+				xs->emplace_back(static_cast<detail::DataVal*>(data_val.get())->data);
+				converted = true;
+				}
+			}
 		else
-			data_val = detail::make_data_val((*args)[i]);
+			{
+			auto data = detail::val_to_data((*args)[i]);
 
-		if ( ! data_val->GetField(0) )
+			if ( data )
+				{
+				xs->emplace_back(std::move(*data));
+				converted = true;
+				}
+			else
+				reporter->Warning("did not get a value from val_to_data");
+			}
+
+		if ( ! converted )
 			{
-			rval->Assign(0, nullptr);
 			Error("failed to convert param #%d of type %s to broker data",
 				  i, type_name(got_type->Tag()));
-			return rval;
+			return false;
 			}
-
-		arg_vec->Assign(i - 1, std::move(data_val));
 		}
 
-	return rval;
+	return true;
 	}
 
 bool Manager::Subscribe(const string& topic_prefix)
@@ -19,6 +19,7 @@
 #include <unordered_map>
 
 #include "IntrusivePtr.h"
+#include "SerializationFormat.h"
 #include "iosource/IOSource.h"
 #include "logging/WriterBackend.h"
 
@@ -64,6 +65,34 @@ struct Stats {
 	size_t num_ids_outgoing = 0;
 };
 
+/**
+ * Statistics about the batching of outgoing log records.
+ */
+struct LogBatchStats {
+	// Number of batches sent.
+	size_t num_batches = 0;
+	// Number of log records sent in those batches.
+	size_t num_records = 0;
+	// Number of serialized log record bytes sent in those batches.
+	size_t num_bytes = 0;
+	// Largest number of records in a single stream's flush.
+	size_t max_batch_records = 0;
+	// Largest number of bytes in a single stream's flush.
+	size_t max_batch_bytes = 0;
+	// Number of flushes triggered by Broker::log_batch_size.
+	size_t num_flushes_size = 0;
+	// Number of flushes triggered by Broker::log_batch_max_bytes.
+	size_t num_flushes_bytes = 0;
+	// Number of flushes triggered by Broker::log_batch_max_latency.
+	size_t num_flushes_latency = 0;
+	// Number of flushes triggered periodically or at shutdown.
+	size_t num_flushes_timer = 0;
+	// Sum of the time the oldest record of each flush spent buffered.
+	double total_delay = 0;
+	// Longest time the oldest record of a flush spent buffered.
+	double max_delay = 0;
+};
+
 /**
  * Manages various forms of communication between peer Bro processes
  * or other external applications via use of the Broker messaging library.
@@ -175,6 +204,21 @@ public:
 	 */
 	bool PublishEvent(std::string topic, RecordVal* ev);
 
+	/**
+	 * Send an event to any interested peers.  Unlike going through
+	 * MakeEvent(), this converts the arguments straight into the message
+	 * without wrapping each of them in a script-layer record first.
+	 * @param topic a topic string associated with the message.
+	 * Peers advertise interest by registering a subscription to some prefix
+	 * of this topic name.
+	 * @param args the event and its arguments.  The event is always the first
+	 * elements in the list.
+	 * @param frame the calling frame, used to report location info upon error
+	 * @return true if the message is sent successfully.
+	 */
+	bool PublishEvent(std::string topic, ValPList* args,
+	                  zeek::detail::Frame* frame);
+
 	/**
 	 * Send a message to create a log stream to any interested peers.
 	 * The log stream may or may not already exist on the receiving side.
@@ -349,6 +393,12 @@ public:
 	 */
 	const Stats& GetStatistics();
 
+	/**
+	 * @return statistics about the batching of outgoing log records.
+	 */
+	const LogBatchStats& GetLogBatchStatistics() const
+		{ return log_batch_statistics; }
+
 	/**
 	 * Creating an instance of this struct simply helps the manager
 	 * keep track of whether calls into its API are coming from script
@@ -382,6 +432,12 @@ private:
 	// when a master/clone is created.
 	void BrokerStoreToZeekTable(const std::string& name, const detail::StoreHandleVal* handle);
 
+	// Checks an event and its arguments, as passed to MakeEvent(), and
+	// converts the arguments to Broker data.  Reports an error and returns
+	// false if they don't match the event's signature.
+	bool MakeEventArgs(ValPList* args, zeek::detail::Frame* frame,
+	                   std::string* name, broker::vector* xs);
+
 	void Error(const char* format, ...)
 		__attribute__((format (printf, 2, 3)));
 
@@ -393,9 +449,14 @@ private:
 	struct LogBuffer {
 		// Indexed by topic string.
 		std::unordered_map<std::string, broker::vector> msgs;
-		size_t message_count;
-
-		size_t Flush(broker::endpoint& endpoint, size_t batch_size);
+		size_t message_count = 0;
+		// Serialized size of the buffered records.
+		size_t byte_count = 0;
+		// Time the oldest buffered record was added.
+		double first_write = 0;
+
+		size_t Flush(broker::endpoint& endpoint, size_t batch_size,
+		             LogBatchStats* stats);
 	};
 
 	// Data stores
@@ -421,6 +482,7 @@ private:
 	std::vector<std::string> forwarded_prefixes;
 
 	Stats statistics;
+	LogBatchStats log_batch_statistics;
 
 	uint16_t bound_port;
 	bool use_real_time;
@@ -428,6 +490,10 @@ private:
 	int peer_count;
 
 	size_t log_batch_size;
+	size_t log_batch_max_bytes;
+	double log_batch_max_latency;
+	// Reused across log writes to avoid reallocating its buffer per row.
+	zeek::detail::BinarySerializationFormat log_write_fmt;
 	Func* log_topic_func;
 	VectorTypePtr vector_of_data_type;
 	EnumType* log_id_type;
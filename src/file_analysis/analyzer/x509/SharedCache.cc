@@ -0,0 +1,404 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "SharedCache.h"
+
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <time.h>
+
+#include "Val.h"
+#include "Reporter.h"
+
+#include "types.bif.h"
+
+namespace zeek::file_analysis::detail {
+
+// Bump the version whenever the layout of the file or of the encoded
+// records changes; processes refuse to share a file with another version.
+static constexpr uint32_t CACHE_MAGIC = 0x5a583531; // "ZX51"
+static constexpr uint32_t CACHE_VERSION = 2;
+static constexpr size_t SLOT_SIZE = 2048;
+
+// A write copies a couple of KB. A writer still holding a slot after this
+// many seconds is taken to have died even if its pid is in use, which may
+// be by an unrelated process or, with PID namespaces, not visible to us.
+static constexpr uint32_t STALE_WRITER_SECONDS = 600;
+
+struct X509SharedCache::Header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t num_slots;
+	uint64_t slot_size;
+};
+
+struct X509SharedCache::Slot {
+	// Even while the slot is stable, odd while a writer updates it.
+	// Zero means the slot was never written.
+	std::atomic<uint64_t> seq;
+	// The writer currently owning the slot, as its pid in the upper and
+	// the time it took the slot over in the lower 32 bits, or zero.
+	std::atomic<uint64_t> writer;
+	u_char key[KEY_LENGTH];
+	uint32_t len;
+	char data[SLOT_SIZE - 2 * sizeof(std::atomic<uint64_t>) - KEY_LENGTH - sizeof(uint32_t)];
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "shared cache requires lock-free 64-bit atomics");
+
+static uint64_t MakeWriter(uint32_t now)
+	{
+	return (uint64_t(getpid()) << 32) | now;
+	}
+
+// Returns true if the writer owning a slot died before releasing it.
+static bool IsStaleWriter(uint64_t writer, uint32_t now)
+	{
+	pid_t pid = pid_t(writer >> 32);
+	uint32_t since = uint32_t(writer);
+
+	if ( now >= since && now - since >= STALE_WRITER_SECONDS )
+		return true;
+
+	return pid != getpid() && kill(pid, 0) < 0 && errno == ESRCH;
+	}
+
+X509SharedCache::~X509SharedCache()
+	{
+	if ( mapping )
+		munmap(mapping, mapping_size);
+
+	if ( fd >= 0 )
+		close(fd);
+	}
+
+bool X509SharedCache::Open(const std::string& path, size_t arg_slots)
+	{
+	if ( arg_slots == 0 )
+		{
+		reporter->Error("X509 shared certificate cache needs at least one slot");
+		return false;
+		}
+
+	fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+
+	if ( fd < 0 )
+		{
+		reporter->Error("cannot open X509 shared certificate cache %s: %s",
+		                path.c_str(), strerror(errno));
+		return false;
+		}
+
+	size_t size = sizeof(Header) + arg_slots * sizeof(Slot);
+
+	// Serialize initialization between processes starting up at the
+	// same time; whoever gets here first sizes and formats the file.
+	if ( flock(fd, LOCK_EX) < 0 )
+		{
+		reporter->Error("cannot lock X509 shared certificate cache %s: %s",
+		                path.c_str(), strerror(errno));
+		return false;
+		}
+
+	struct stat st;
+	bool ok = fstat(fd, &st) == 0;
+	bool fresh = ok && st.st_size == 0;
+
+	if ( fresh )
+		ok = ftruncate(fd, size) == 0;
+
+	else if ( ok && size_t(st.st_size) != size )
+		{
+		flock(fd, LOCK_UN);
+		reporter->Error("X509 shared certificate cache %s has unexpected size, "
+		                "was it created with a different number of slots?",
+		                path.c_str());
+		return false;
+		}
+
+	if ( ok )
+		{
+		mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+		if ( mapping == MAP_FAILED )
+			{
+			mapping = nullptr;
+			ok = false;
+			}
+		}
+
+	if ( ! ok )
+		{
+		flock(fd, LOCK_UN);
+		reporter->Error("cannot map X509 shared certificate cache %s: %s",
+		                path.c_str(), strerror(errno));
+		return false;
+		}
+
+	mapping_size = size;
+
+	auto hdr = static_cast<Header*>(mapping);
+
+	if ( fresh )
+		{
+		// The file is zero-filled, which leaves all slots empty.
+		hdr->magic = CACHE_MAGIC;
+		hdr->version = CACHE_VERSION;
+		hdr->num_slots = arg_slots;
+		hdr->slot_size = sizeof(Slot);
+		}
+
+	flock(fd, LOCK_UN);
+
+	if ( hdr->magic != CACHE_MAGIC || hdr->version != CACHE_VERSION ||
+	     hdr->num_slots != arg_slots || hdr->slot_size != sizeof(Slot) )
+		{
+		reporter->Error("X509 shared certificate cache %s has an incompatible format",
+		                path.c_str());
+		return false;
+		}
+
+	num_slots = arg_slots;
+	slots = reinterpret_cast<Slot*>(static_cast<char*>(mapping) + sizeof(Header));
+	return true;
+	}
+
+X509SharedCache::Slot* X509SharedCache::SlotFor(const u_char* sha256) const
+	{
+	// The key is a cryptographic hash already, any part of it
+	// makes for a good index.
+	uint64_t h;
+	memcpy(&h, sha256, sizeof(h));
+	return &slots[h % num_slots];
+	}
+
+RecordValPtr X509SharedCache::Lookup(const u_char* sha256)
+	{
+	if ( ! slots )
+		return nullptr;
+
+	Slot* slot = SlotFor(sha256);
+	uint64_t seq = slot->seq.load(std::memory_order_acquire);
+
+	if ( seq == 0 || (seq & 1) || memcmp(slot->key, sha256, KEY_LENGTH) != 0 )
+		{
+		++stats.misses;
+		return nullptr;
+		}
+
+	uint32_t len = slot->len;
+
+	if ( len > sizeof(slot->data) )
+		{
+		++stats.misses;
+		return nullptr;
+		}
+
+	char buf[sizeof(slot->data)];
+	memcpy(buf, slot->data, len);
+
+	// Make sure no writer touched the slot while we copied it.
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	if ( slot->seq.load(std::memory_order_relaxed) != seq ||
+	     memcmp(slot->key, sha256, KEY_LENGTH) != 0 )
+		{
+		++stats.misses;
+		return nullptr;
+		}
+
+	auto rval = Decode(buf, len);
+
+	if ( rval )
+		++stats.hits;
+	else
+		++stats.misses;
+
+	return rval;
+	}
+
+void X509SharedCache::Insert(const u_char* sha256, const RecordVal* cert)
+	{
+	if ( ! slots )
+		return;
+
+	std::string encoded;
+	Slot* slot = SlotFor(sha256);
+
+	if ( ! Encode(cert, &encoded) || encoded.size() > sizeof(slot->data) )
+		{
+		++stats.store_failures;
+		return;
+		}
+
+	// Take over the slot. If another process is busy with it, leave it
+	// alone, unless that process died in the middle of its write; then
+	// the slot would otherwise stay unusable for good.
+	uint32_t now = uint32_t(time(nullptr));
+	uint64_t me = MakeWriter(now);
+	uint64_t writer = 0;
+
+	if ( ! slot->writer.compare_exchange_strong(writer, me, std::memory_order_acquire) &&
+	     ! (IsStaleWriter(writer, now) &&
+	        slot->writer.compare_exchange_strong(writer, me, std::memory_order_acquire)) )
+		{
+		++stats.store_failures;
+		return;
+		}
+
+	// A writer that died leaves the counter odd, which it stays until
+	// we're done.
+	uint64_t seq = slot->seq.load(std::memory_order_relaxed) | 1;
+	slot->seq.store(seq, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	memcpy(slot->key, sha256, KEY_LENGTH);
+	slot->len = encoded.size();
+	memcpy(slot->data, encoded.data(), encoded.size());
+
+	slot->seq.store(seq + 1, std::memory_order_release);
+	slot->writer.store(0, std::memory_order_release);
+	++stats.stores;
+	}
+
+// Records are encoded field by field as a one-byte type tag followed by
+// the value. Only the types ParseCertificate() produces are supported.
+enum EncodedTag : uint8_t {
+	ENC_UNSET = 0,
+	ENC_COUNT = 1,
+	ENC_STRING = 2,
+	ENC_TIME = 3,
+};
+
+bool X509SharedCache::Encode(const RecordVal* cert, std::string* out)
+	{
+	const auto& rt = cert->GetType<RecordType>();
+	int n = rt->NumFields();
+
+	for ( int i = 0; i < n; ++i )
+		{
+		const auto& v = cert->GetField(i);
+
+		if ( ! v )
+			{
+			out->push_back(ENC_UNSET);
+			continue;
+			}
+
+		switch ( v->GetType()->Tag() ) {
+		case TYPE_COUNT:
+			{
+			uint64_t c = v->AsCount();
+			out->push_back(ENC_COUNT);
+			out->append(reinterpret_cast<const char*>(&c), sizeof(c));
+			break;
+			}
+
+		case TYPE_STRING:
+			{
+			auto s = v->AsString();
+			uint32_t l = s->Len();
+			out->push_back(ENC_STRING);
+			out->append(reinterpret_cast<const char*>(&l), sizeof(l));
+			out->append(reinterpret_cast<const char*>(s->Bytes()), l);
+			break;
+			}
+
+		case TYPE_TIME:
+			{
+			double t = v->AsTime();
+			out->push_back(ENC_TIME);
+			out->append(reinterpret_cast<const char*>(&t), sizeof(t));
+			break;
+			}
+
+		default:
+			return false;
+		}
+		}
+
+	return true;
+	}
+
+RecordValPtr X509SharedCache::Decode(const char* data, size_t len)
+	{
+	const auto& rt = BifType::Record::X509::Certificate;
+	auto rval = make_intrusive<RecordVal>(rt);
+	int n = rt->NumFields();
+	const char* end = data + len;
+
+	for ( int i = 0; i < n; ++i )
+		{
+		if ( data >= end )
+			return nullptr;
+
+		uint8_t tag = *data++;
+		auto expected = rt->GetFieldType(i)->Tag();
+
+		if ( (tag == ENC_COUNT && expected != TYPE_COUNT) ||
+		     (tag == ENC_STRING && expected != TYPE_STRING) ||
+		     (tag == ENC_TIME && expected != TYPE_TIME) )
+			return nullptr;
+
+		switch ( tag ) {
+		case ENC_UNSET:
+			break;
+
+		case ENC_COUNT:
+			{
+			uint64_t c;
+			if ( end - data < int(sizeof(c)) )
+				return nullptr;
+
+			memcpy(&c, data, sizeof(c));
+			data += sizeof(c);
+			rval->Assign(i, val_mgr->Count(c));
+			break;
+			}
+
+		case ENC_STRING:
+			{
+			uint32_t l;
+			if ( end - data < int(sizeof(l)) )
+				return nullptr;
+
+			memcpy(&l, data, sizeof(l));
+			data += sizeof(l);
+
+			if ( end - data < int64_t(l) )
+				return nullptr;
+
+			rval->Assign(i, make_intrusive<StringVal>(l, data));
+			data += l;
+			break;
+			}
+
+		case ENC_TIME:
+			{
+			double t;
+			if ( end - data < int(sizeof(t)) )
+				return nullptr;
+
+			memcpy(&t, data, sizeof(t));
+			data += sizeof(t);
+			rval->Assign(i, make_intrusive<TimeVal>(t));
+			break;
+			}
+
+		default:
+			return nullptr;
+		}
+		}
+
+	return rval;
+	}
+
+} // namespace zeek::file_analysis::detail
@@ -0,0 +1,96 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h>
+#include <cstdint>
+#include <string>
+
+#include "IntrusivePtr.h"
+
+namespace zeek {
+class RecordVal;
+using RecordValPtr = IntrusivePtr<RecordVal>;
+}
+
+namespace zeek::file_analysis::detail {
+
+/**
+ * A cache of parsed X509::Certificate records that lives in a memory-mapped
+ * file, so that all Zeek processes on a host that open the same file share
+ * the results of parsing a certificate. Entries are keyed by the SHA256 of
+ * the DER-encoded certificate.
+ *
+ * The file is organized as a direct-mapped table of fixed-size slots. Every
+ * slot is protected by a sequence counter: writers that find a slot busy
+ * simply skip the insertion, and readers that observe a concurrent write
+ * treat the lookup as a miss. No process ever blocks on another one. Slots
+ * record which process writes them, so that a slot left behind by a writer
+ * that died mid-write gets reclaimed by the next one.
+ */
+class X509SharedCache {
+public:
+	static constexpr size_t KEY_LENGTH = 32;
+
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t stores = 0;
+		uint64_t store_failures = 0;
+	};
+
+	X509SharedCache() = default;
+	~X509SharedCache();
+
+	X509SharedCache(const X509SharedCache&) = delete;
+	X509SharedCache& operator=(const X509SharedCache&) = delete;
+
+	/**
+	 * Maps the cache file, creating and initializing it if necessary.
+	 * Processes sharing a cache must agree on the number of slots.
+	 *
+	 * @param path  The file backing the cache.
+	 *
+	 * @param slots  The number of certificates the cache can hold.
+	 *
+	 * @return True on success. On failure an error has been reported.
+	 */
+	bool Open(const std::string& path, size_t slots);
+
+	/**
+	 * Looks up the parsed certificate for a given SHA256 digest.
+	 *
+	 * @param sha256  The raw (binary) SHA256 digest of the certificate.
+	 *
+	 * @return A new X509::Certificate record, or null if the certificate
+	 * is not cached.
+	 */
+	RecordValPtr Lookup(const u_char* sha256);
+
+	/**
+	 * Stores the parsed certificate for a given SHA256 digest, replacing
+	 * whatever occupied its slot before. Records that do not fit into a
+	 * slot are silently not cached.
+	 */
+	void Insert(const u_char* sha256, const RecordVal* cert);
+
+	const Stats& GetStats() const	{ return stats; }
+
+private:
+	struct Header;
+	struct Slot;
+
+	Slot* SlotFor(const u_char* sha256) const;
+
+	static bool Encode(const RecordVal* cert, std::string* out);
+	static RecordValPtr Decode(const char* data, size_t len);
+
+	int fd = -1;
+	void* mapping = nullptr;
+	size_t mapping_size = 0;
+	size_t num_slots = 0;
+	Slot* slots = nullptr;
+	Stats stats;
+};
+
+} // namespace zeek::file_analysis::detail
@@ -0,0 +1,185 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "VerifyCache.h"
+
+#include <math.h>
+
+#include "X509.h"
+#include "Val.h"
+#include "RunState.h"
+#include "digest.h"
+
+namespace zeek::file_analysis::detail {
+
+void X509VerifyCache::SetLimits(size_t arg_max_entries, double arg_ttl)
+	{
+	max_entries = arg_max_entries;
+	ttl = arg_ttl;
+
+	while ( entries.size() > max_entries )
+		{
+		entries.erase(lru.back().key);
+		lru.pop_back();
+		++stats.evicted;
+		}
+	}
+
+bool X509VerifyCache::TimeStableWithinHour(const ASN1_TIME* t, double verify_time)
+	{
+	time_t start = time_t(floor(verify_time / 3600.0)) * 3600;
+	time_t end = start + 3599;
+
+	int cmp_start = X509_cmp_time(t, &start);
+	int cmp_end = X509_cmp_time(t, &end);
+
+	// Zero signals an error. Otherwise, the time must lie on the same
+	// side of both ends of the hour.
+	return cmp_start != 0 && cmp_start == cmp_end;
+	}
+
+bool X509VerifyCache::ValidityStableWithinHour(::X509* cert, double verify_time)
+	{
+	return TimeStableWithinHour(X509_get_notBefore(cert), verify_time) &&
+	       TimeStableWithinHour(X509_get_notAfter(cert), verify_time);
+	}
+
+std::string X509VerifyCache::Key(const VectorVal* certs, uint64_t store_generation,
+                                 double verify_time, const String* extra) const
+	{
+	if ( max_entries == 0 || store_generation == 0 )
+		return "";
+
+	std::string key;
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int digest_len;
+
+	for ( unsigned int i = 0; i < certs->Size(); ++i )
+		{
+		const auto& v = certs->At(i);
+
+		if ( ! v )
+			return "";
+
+		::X509* cert = static_cast<X509Val*>(v.get())->GetCertificate();
+
+		if ( ! cert || ! ValidityStableWithinHour(cert, verify_time) ||
+		     ! X509_digest(cert, EVP_sha256(), digest, &digest_len) )
+			return "";
+
+		key.append(reinterpret_cast<const char*>(digest), digest_len);
+		}
+
+	if ( extra )
+		{
+		auto ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
+		zeek::detail::hash_update(ctx, extra->Bytes(), extra->Len());
+		zeek::detail::hash_final(ctx, digest);
+		key.append(reinterpret_cast<const char*>(digest), SHA256_DIGEST_LENGTH);
+		}
+
+	int64_t hour = int64_t(floor(verify_time / 3600.0));
+	key.append(reinterpret_cast<const char*>(&store_generation), sizeof(store_generation));
+	key.append(reinterpret_cast<const char*>(&hour), sizeof(hour));
+
+	return key;
+	}
+
+RecordValPtr X509VerifyCache::Lookup(const std::string& key)
+	{
+	auto it = entries.find(key);
+
+	if ( it == entries.end() )
+		{
+		++stats.misses;
+		return nullptr;
+		}
+
+	auto e = it->second;
+
+	if ( ttl > 0 && run_state::network_time - e->inserted > ttl )
+		{
+		lru.erase(e);
+		entries.erase(it);
+		++stats.expired;
+		++stats.misses;
+		return nullptr;
+		}
+
+	lru.splice(lru.begin(), lru, e);
+	++stats.hits;
+
+	// Hand out a fresh record so that scripts modifying the result
+	// don't change the cached copy. The certificates themselves are
+	// immutable and can be shared.
+	const auto& cached = e->result;
+	auto rt = cached->GetType<RecordType>();
+	auto rval = make_intrusive<RecordVal>(rt);
+
+	for ( int i = 0; i < rt->NumFields(); ++i )
+		{
+		const auto& v = cached->GetField(i);
+
+		if ( v && v->GetType()->Tag() == TYPE_VECTOR )
+			{
+			auto src = v->AsVectorVal();
+			auto vv = make_intrusive<VectorVal>(v->GetType<VectorType>());
+
+			for ( unsigned int j = 0; j < src->Size(); ++j )
+				vv->Assign(j, src->At(j));
+
+			rval->Assign(i, std::move(vv));
+			}
+		else
+			rval->Assign(i, v);
+		}
+
+	return rval;
+	}
+
+void X509VerifyCache::Insert(const std::string& key, double verify_time,
+                             const RecordValPtr& result)
+	{
+	if ( max_entries == 0 || key.empty() )
+		return;
+
+	// The chain OpenSSL built may include certificates from the root
+	// store that weren't part of the key.
+	static int chain_idx = result->GetType<RecordType>()->FieldOffset("chain_certs");
+	const auto& chain = result->GetField(chain_idx);
+
+	if ( chain )
+		{
+		auto cv = chain->AsVectorVal();
+
+		for ( unsigned int i = 0; i < cv->Size(); ++i )
+			{
+			const auto& v = cv->At(i);
+			::X509* cert = v ? static_cast<X509Val*>(v.get())->GetCertificate() : nullptr;
+
+			if ( ! cert || ! ValidityStableWithinHour(cert, verify_time) )
+				return;
+			}
+		}
+
+	auto it = entries.find(key);
+
+	if ( it != entries.end() )
+		{
+		it->second->result = result;
+		it->second->inserted = run_state::network_time;
+		lru.splice(lru.begin(), lru, it->second);
+		return;
+		}
+
+	lru.push_front({key, result, run_state::network_time});
+	entries.emplace(key, lru.begin());
+
+	while ( entries.size() > max_entries )
+		{
+		entries.erase(lru.back().key);
+		lru.pop_back();
+		++stats.evicted;
+		}
+	}
+
+} // namespace zeek::file_analysis::detail
@@ -0,0 +1,118 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <openssl/x509.h>
+
+#include "IntrusivePtr.h"
+
+namespace zeek {
+class RecordVal;
+class VectorVal;
+class String;
+using RecordValPtr = IntrusivePtr<RecordVal>;
+}
+
+namespace zeek::file_analysis::detail {
+
+/**
+ * A bounded LRU cache of certificate chain verification results, as
+ * returned by x509_verify() and x509_ocsp_verify().
+ *
+ * Entries are keyed by the SHA256 digests of all certificates in the
+ * chain, the generation of the root store, any additional input (like the
+ * OCSP reply) and the hour the verification time falls into. Only
+ * verifications whose certificates are valid, or invalid, for that whole
+ * hour are cached, so that the hour granularity never changes a result.
+ * For OCSP replies, this extends to their update times and to the chain
+ * of their signer.
+ */
+class X509VerifyCache {
+public:
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t expired = 0;
+		uint64_t evicted = 0;
+	};
+
+	/**
+	 * Sets the limits of the cache. A maximum of zero entries disables
+	 * it and flushes all existing entries.
+	 *
+	 * @param max_entries  The number of results to keep at most.
+	 *
+	 * @param ttl  The time after which an entry is discarded, measured
+	 * in network time. Zero keeps entries until they are evicted.
+	 */
+	void SetLimits(size_t max_entries, double ttl);
+
+	/**
+	 * Computes the cache key for a verification.
+	 *
+	 * @param certs  The certificate chain to verify, host certificate first.
+	 *
+	 * @param store_generation  The generation of the root store used for
+	 * verification, see X509::GetRootStoreGeneration().
+	 *
+	 * @param verify_time  The time the verification is done for.
+	 *
+	 * @param extra  Any additional input influencing the result, or null.
+	 *
+	 * @return The key, or an empty string if the verification must not
+	 * be cached.
+	 */
+	std::string Key(const VectorVal* certs, uint64_t store_generation,
+	                double verify_time, const String* extra = nullptr) const;
+
+	/**
+	 * Returns a copy of the cached X509::Result for a key, or null.
+	 */
+	RecordValPtr Lookup(const std::string& key);
+
+	/**
+	 * Caches an X509::Result, unless its chain contains certificates
+	 * whose validity begins or ends within the hour of the key.
+	 */
+	void Insert(const std::string& key, double verify_time,
+	            const RecordValPtr& result);
+
+	size_t Size() const	{ return entries.size(); }
+	const Stats& GetStats() const	{ return stats; }
+
+	/**
+	 * @return True if a time lies on the same side of the whole hour
+	 * that the verification time falls into.
+	 */
+	static bool TimeStableWithinHour(const ASN1_TIME* t, double verify_time);
+
+	/**
+	 * @return True if a certificate is either valid, or not valid, for
+	 * the whole hour that the verification time falls into.
+	 */
+	static bool ValidityStableWithinHour(::X509* cert, double verify_time);
+
+private:
+	struct Entry {
+		std::string key;
+		RecordValPtr result;
+		double inserted;
+	};
+
+	using EntryList = std::list<Entry>;
+
+	size_t max_entries = 0;
+	double ttl = 0;
+
+	// Most recently used entries are at the front.
+	EntryList lru;
+	std::unordered_map<std::string, EntryList::iterator> entries;
+	Stats stats;
+};
+
+} // namespace zeek::file_analysis::detail
@@ -45,15 +45,20 @@ bool X509::Undelivered(uint64_t offset, uint64_t len)
 bool X509::EndOfFile()
 	{
 	const unsigned char* cert_char = reinterpret_cast<const unsigned char*>(cert_data.data());
-	if ( certificate_cache )
+	unsigned char cert_sha256[SHA256_DIGEST_LENGTH];
+
+	if ( certificate_cache || shared_cache )
 		{
-		// first step - let's see if the certificate has been cached.
-		unsigned char buf[SHA256_DIGEST_LENGTH];
 		auto ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
 		zeek::detail::hash_update(ctx, cert_char, cert_data.size());
-		zeek::detail::hash_final(ctx, buf);
-		std::string cert_sha256 = zeek::detail::sha256_digest_print(buf);
-		auto index = make_intrusive<StringVal>(cert_sha256);
+		zeek::detail::hash_final(ctx, cert_sha256);
+		}
+
+	if ( certificate_cache )
+		{
+		// first step - let's see if the certificate has been cached.
+		std::string cert_sha256_str = zeek::detail::sha256_digest_print(cert_sha256);
+		auto index = make_intrusive<StringVal>(cert_sha256_str);
 		const auto& entry = certificate_cache->Find(index);
 
 		if ( entry )
@@ -65,7 +70,7 @@ bool X509::EndOfFile()
 			// yup, let's call the callback.
 
 			cache_hit_callback->Invoke(GetFile()->ToVal(), entry,
-			                           make_intrusive<StringVal>(cert_sha256));
+			                           make_intrusive<StringVal>(cert_sha256_str));
 			return false;
 			}
 		}
@@ -81,8 +86,23 @@ bool X509::EndOfFile()
 
 	X509Val* cert_val = new X509Val(ssl_cert); // cert_val takes ownership of ssl_cert
 
-	// parse basic information into record.
-	auto cert_record = ParseCertificate(cert_val, GetFile());
+	// parse basic information into record, unless another process on
+	// this host did so already.
+	RecordValPtr cert_record;
+
+	if ( shared_cache && CanUseSharedCache(ssl_cert) )
+		cert_record = shared_cache->Lookup(cert_sha256);
+
+	if ( ! cert_record )
+		{
+		uint64_t weirds = reporter->GetWeirdCount();
+		cert_record = ParseCertificate(cert_val, GetFile());
+
+		// Hits skip ParseCertificate(), so a certificate that raised
+		// weirds stays out of the cache to have every process report them.
+		if ( shared_cache && reporter->GetWeirdCount() == weirds )
+			shared_cache->Insert(cert_sha256, cert_record.get());
+		}
 
 	// and send the record on to scriptland
 	if ( x509_certificate )
@@ -271,14 +291,43 @@ X509_STORE* X509::GetRootStore(TableVal* root_certs)
 
 	// Save the newly constructed certificate store into the cacheing map.
 	x509_stores[root_certs] = ctx;
+	x509_store_generations[ctx] = next_store_generation++;
 
 	return ctx;
 	}
 
+uint64_t X509::GetRootStoreGeneration(const X509_STORE* store)
+	{
+	auto it = x509_store_generations.find(store);
+	return it != x509_store_generations.end() ? it->second : 0;
+	}
+
+bool X509::SetSharedCertificateCache(const std::string& path, size_t slots)
+	{
+	auto cache = std::make_unique<X509SharedCache>();
+
+	if ( ! cache->Open(path, slots) )
+		return false;
+
+	shared_cache = std::move(cache);
+	return true;
+	}
+
+bool X509::CanUseSharedCache(::X509* ssl_cert)
+	{
+	// ParseCertificate() fixes up the key algorithm of some RDP
+	// certificates in place, so those always need to go through it.
+	ASN1_OBJECT* algorithm;
+	X509_PUBKEY_get0_param(&algorithm, NULL, NULL, NULL, X509_get_X509_PUBKEY(ssl_cert));
+	return OBJ_obj2nid(algorithm) != NID_md5WithRSAEncryption;
+	}
+
 void X509::FreeRootStore()
 	{
 	for ( const auto& e : x509_stores )
 		X509_STORE_free(e.second);
+
+	x509_store_generations.clear();
 	}
 
 void X509::ParseBasicConstraints(X509_EXTENSION* ex)
@@ -4,9 +4,12 @@
 
 #include <string>
 #include <map>
+#include <memory>
 
 #include "OpaqueVal.h"
 #include "X509Common.h"
+#include "SharedCache.h"
+#include "VerifyCache.h"
 #include "Func.h"
 
 #if ( OPENSSL_VERSION_NUMBER < 0x10002000L ) || defined(LIBRESSL_VERSION_NUMBER)
@@ -104,6 +107,17 @@ public:
 	 */
 	static X509_STORE* GetRootStore(TableVal* root_certs);
 
+	/**
+	 * Returns a number that identifies a store returned by GetRootStore()
+	 * for the lifetime of the process. Unlike the store's address, it is
+	 * never reused for a different store.
+	 *
+	 * @param store  A store returned by GetRootStore().
+	 *
+	 * @return The store's generation, or 0 for unknown stores.
+	 */
+	static uint64_t GetRootStoreGeneration(const X509_STORE* store);
+
 	/**
 	 * Frees memory obtained from OpenSSL that is associated with the global
 	 * X509 certificate store used by the Zeek scripting-layer.  This primarily
@@ -126,6 +140,32 @@ public:
 	static void SetCertificateCacheHitCallback(FuncPtr func)
 		{ cache_hit_callback = std::move(func); }
 
+	/**
+	 * Enables the native certificate cache shared by all processes on a
+	 * host that use the same backing file. Parsed certificates found in
+	 * this cache skip ParseCertificate().
+	 *
+	 * @param path  The file backing the cache.
+	 *
+	 * @param slots  The number of certificates the cache can hold.
+	 *
+	 * @return True if the cache could be set up.
+	 */
+	static bool SetSharedCertificateCache(const std::string& path, size_t slots);
+
+	/**
+	 * Returns the shared certificate cache, or null if it isn't enabled.
+	 */
+	static const X509SharedCache* GetSharedCertificateCache()
+		{ return shared_cache.get(); }
+
+	/**
+	 * Returns the cache of chain verification results used by the
+	 * x509_verify() and x509_ocsp_verify() BIFs.
+	 */
+	static X509VerifyCache& GetVerifyCache()
+		{ return verify_cache; }
+
 protected:
 	X509(RecordValPtr args, file_analysis::File* file);
 
@@ -136,13 +176,20 @@ private:
 
 	std::string cert_data;
 
+	// Returns false for certificates that ParseCertificate() modifies.
+	static bool CanUseSharedCache(::X509* ssl_cert);
+
 	// Helpers for ParseCertificate.
 	static StringValPtr KeyCurve(EVP_PKEY* key);
 	static unsigned int KeyLength(EVP_PKEY *key);
 	/** X509 stores associated with global script-layer values */
 	inline static std::map<Val*, X509_STORE*> x509_stores = std::map<Val*, X509_STORE*>();
+	inline static std::map<const X509_STORE*, uint64_t> x509_store_generations;
+	inline static uint64_t next_store_generation = 1;
 	inline static TableValPtr certificate_cache = nullptr;
 	inline static FuncPtr cache_hit_callback = nullptr;
+	inline static std::unique_ptr<X509SharedCache> shared_cache = nullptr;
+	inline static X509VerifyCache verify_cache;
 };
 
 /**
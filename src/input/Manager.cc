@@ -34,10 +34,15 @@ namespace zeek::input {
  * HashKey*, because it is thrown into other Bro functions that need the
  * complex structure of it. For everything we do (with values), we just take
  * the hash_t value and compare it directly with "=="
+ *
+ * The generation records the last pass over the input that contained the
+ * line, so that a single dictionary suffices to tell which lines of the
+ * previous pass have disappeared.
  */
 struct InputHash {
 	zeek::detail::hash_t valhash;
 	zeek::detail::HashKey* idxkey;
+	uint32_t generation;
 	~InputHash();
 };
 
@@ -100,8 +105,9 @@ public:
 	RecordType* rtype;
 	RecordType* itype;
 
-	PDict<InputHash>* currDict;
-	PDict<InputHash>* lastDict;
+	PDict<InputHash>* entries;
+	// Incremented at the end of each pass over the input.
+	uint32_t generation;
 
 	Func* pred;
 
@@ -134,7 +140,7 @@ public:
 Manager::TableStream::TableStream()
 	: Manager::Stream::Stream(TABLE_STREAM),
 	  num_idx_fields(), num_val_fields(), want_record(), tab(), rtype(),
-	  itype(), currDict(), lastDict(), pred(), event()
+	  itype(), entries(), generation(1), pred(), event()
 	{
 	}
 
@@ -161,16 +167,10 @@ Manager::TableStream::~TableStream()
 	if ( rtype ) // can be 0 for sets
 		Unref(rtype);
 
-	if ( currDict )
+	if ( entries )
 		{
-		currDict->Clear();
-		delete currDict;
-		}
-
-	if ( lastDict )
-		{
-		lastDict->Clear();;
-		delete lastDict;
+		entries->Clear();
+		delete entries;
 		}
 	}
 
@@ -697,10 +697,8 @@ bool Manager::CreateTableStream(RecordVal* fval)
 	stream->itype = idx->Ref()->AsRecordType();
 	stream->event = event ? event_registry->Lookup(event->Name()) : nullptr;
 	stream->error_event = error_event ? event_registry->Lookup(error_event->Name()) : nullptr;
-	stream->currDict = new PDict<InputHash>;
-	stream->currDict->SetDeleteFunc(input_hash_delete_func);
-	stream->lastDict = new PDict<InputHash>;
-	stream->lastDict->SetDeleteFunc(input_hash_delete_func);
+	stream->entries = new PDict<InputHash>;
+	stream->entries->SetDeleteFunc(input_hash_delete_func);
 	stream->want_record = ( want_record->InternalInt() == 1 );
 
 	assert(stream->reader);
@@ -1142,15 +1140,19 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 			}
 		}
 
-	InputHash *h = stream->lastDict->Lookup(idxhash);
+	InputHash *h = stream->entries->Lookup(idxhash);
+
+	if ( h && h->generation == stream->generation )
+		// Already sent during this pass, handle it like a new line.
+		h = nullptr;
+
 	if ( h )
 		{
 		// seen before
 		if ( stream->num_val_fields == 0 || h->valhash == valhash )
 			{
-			// ok, exact duplicate, move entry to new dicrionary and do nothing else.
-			stream->lastDict->Remove(idxhash);
-			stream->currDict->Insert(idxhash, h);
+			// ok, exact duplicate, mark as seen and do nothing else.
+			h->generation = stream->generation;
 			delete idxhash;
 			return stream->num_val_fields + stream->num_idx_fields;
 			}
@@ -1158,9 +1160,7 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 		else
 			{
 			assert( stream->num_val_fields > 0 );
-			// entry was updated in some way
-			stream->lastDict->Remove(idxhash);
-			// keep h for predicates
+			// entry was updated in some way, keep h for predicates
 			updated = true;
 			}
 
@@ -1221,7 +1221,7 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 				else
 					{
 					// keep old one
-					stream->currDict->Insert(idxhash, h);
+					h->generation = stream->generation;
 					delete idxhash;
 					return stream->num_val_fields + stream->num_idx_fields;
 					}
@@ -1231,8 +1231,12 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 		}
 
 	// now we don't need h anymore - if we are here, the entry is updated and a new h is created.
-	delete h;
-	h = nullptr;
+	if ( h )
+		{
+		stream->entries->Remove(idxhash);
+		delete h;
+		h = nullptr;
+		}
 
 	Val* idxval;
 	if ( predidx != nullptr )
@@ -1272,13 +1276,14 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 	InputHash* ih = new InputHash();
 	ih->idxkey = new zeek::detail::HashKey(k->Key(), k->Size(), k->Hash());
 	ih->valhash = valhash;
+	ih->generation = stream->generation;
 
 	stream->tab->Assign({AdoptRef{}, idxval}, std::move(k), {AdoptRef{}, valval});
 
 	if ( predidx != nullptr )
 		Unref(predidx);
 
-	auto prev = stream->currDict->Insert(idxhash, ih);
+	auto prev = stream->entries->Insert(idxhash, ih);
 	delete prev;
 	delete idxhash;
 
@@ -1341,14 +1346,20 @@ void Manager::EndCurrentSend(ReaderFrontend* reader)
 	assert(i->stream_type == TABLE_STREAM);
 	TableStream* stream = (TableStream*) i;
 
-	// lastdict contains all deleted entries and should be empty apart from that
-	IterCookie *c = stream->lastDict->InitForIteration();
-	stream->lastDict->MakeRobustCookie(c);
+	// Entries not seen during this pass have been deleted.
+	IterCookie *c = stream->entries->InitForIteration();
+	stream->entries->MakeRobustCookie(c);
 	InputHash* ih;
-	zeek::detail::HashKey *lastDictIdxKey;
+	zeek::detail::HashKey *entryIdxKey;
 
-	while ( ( ih = stream->lastDict->NextEntry(lastDictIdxKey, c) ) )
+	while ( ( ih = stream->entries->NextEntry(entryIdxKey, c) ) )
 		{
+		if ( ih->generation == stream->generation )
+			{
+			delete entryIdxKey;
+			continue;
+			}
+
 		ValPtr val;
 		ValPtr predidx;
 		EnumValPtr ev;
@@ -1373,10 +1384,9 @@ void Manager::EndCurrentSend(ReaderFrontend* reader)
 
 			if ( result == false )
 				{
-				// Keep it. Hence - we quit and simply go to the next entry of lastDict
-				// ah well - and we have to add the entry to currDict...
-				stream->currDict->Insert(lastDictIdxKey, stream->lastDict->RemoveEntry(lastDictIdxKey));
-				delete lastDictIdxKey;
+				// Keep it. Hence - we mark it as seen and simply go to the next entry.
+				ih->generation = stream->generation;
+				delete entryIdxKey;
 				continue;
 				}
 			}
@@ -1392,17 +1402,12 @@ void Manager::EndCurrentSend(ReaderFrontend* reader)
 			}
 
 		stream->tab->Remove(*ih->idxkey);
-		stream->lastDict->Remove(lastDictIdxKey); // delete in next line
-		delete lastDictIdxKey;
+		stream->entries->Remove(entryIdxKey); // delete in next line
+		delete entryIdxKey;
 		delete(ih);
 		}
 
-	stream->lastDict->Clear(); // should be empt. buti- well... who knows...
-	delete(stream->lastDict);
-
-	stream->lastDict = stream->currDict;
-	stream->currDict = new PDict<InputHash>;
-	stream->currDict->SetDeleteFunc(input_hash_delete_func);
+	++stream->generation;
 
 #ifdef DEBUG
 	DBG_LOG(DBG_INPUT, "EndCurrentSend complete for stream %s",
@@ -3,6 +3,7 @@
 #include "ReaderBackend.h"
 #include "ReaderFrontend.h"
 #include "Manager.h"
+#include "Snapshot.h"
 
 using zeek::threading::Value;
 using zeek::threading::Field;
@@ -207,6 +208,19 @@ void ReaderBackend::Clear()
 
 void ReaderBackend::EndCurrentSend()
 	{
+	if ( ! snapshot_path.empty() )
+		{
+		if ( ! snapshot_failed && ! snapshot )
+			// Nothing was sent during this pass.
+			WriteSnapshot(nullptr);
+
+		if ( snapshot && ! snapshot->Finish() )
+			Warning(Fmt("Failed to write snapshot: %s", snapshot->Error().c_str()));
+
+		snapshot.reset();
+		snapshot_failed = false;
+		}
+
 	SendOut(new EndCurrentSendMessage(frontend));
 	}
 
@@ -217,9 +231,38 @@ void ReaderBackend::EndOfData()
 
 void ReaderBackend::SendEntry(Value* *vals)
 	{
+	if ( ! snapshot_path.empty() )
+		WriteSnapshot(vals);
+
 	SendOut(new SendEntryMessage(frontend, vals));
 	}
 
+void ReaderBackend::WriteSnapshot(const Value* const* vals)
+	{
+	if ( snapshot_failed )
+		return;
+
+	if ( ! snapshot )
+		{
+		snapshot = std::make_unique<detail::SnapshotWriter>(snapshot_path, num_fields, fields);
+
+		if ( ! snapshot->Open() )
+			{
+			Warning(Fmt("Failed to write snapshot: %s", snapshot->Error().c_str()));
+			snapshot.reset();
+			snapshot_failed = true;
+			return;
+			}
+		}
+
+	if ( vals && ! snapshot->Write(vals) )
+		{
+		Warning(Fmt("Failed to write snapshot: %s", snapshot->Error().c_str()));
+		snapshot.reset();
+		snapshot_failed = true;
+		}
+	}
+
 bool ReaderBackend::Init(const int arg_num_fields,
 		         const threading::Field* const* arg_fields)
 	{
@@ -233,6 +276,16 @@ bool ReaderBackend::Init(const int arg_num_fields,
 	num_fields = arg_num_fields;
 	fields = arg_fields;
 
+	auto it = info->config.find("write_snapshot");
+
+	if ( it != info->config.end() )
+		{
+		if ( info->mode == MODE_STREAM )
+			Warning("Snapshots are not supported in STREAM mode");
+		else
+			snapshot_path = it->second;
+		}
+
 	// disable if DoInit returns error.
 	int success = DoInit(*info, arg_num_fields, arg_fields);
 
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include "ZeekString.h"
 
 #include "threading/SerialTypes.h"
@@ -10,6 +12,7 @@
 #include "Component.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(ReaderFrontend, zeek::input);
+ZEEK_FORWARD_DECLARE_NAMESPACED(SnapshotWriter, zeek::input::detail);
 
 namespace zeek::input {
 
@@ -350,6 +353,10 @@ protected:
 	void EndCurrentSend();
 
 private:
+	// Records an entry in the snapshot of the current pass, if the
+	// stream's "write_snapshot" config option requested one.
+	void WriteSnapshot(const threading::Value* const* vals);
+
 	// Frontend that instantiated us. This object must not be accessed
 	// from this class, it's running in a different thread!
 	ReaderFrontend* frontend;
@@ -362,6 +369,10 @@ private:
 	// this is an internal indicator in case the read is currently in a failed state
 	// it's used to suppress duplicate error messages.
 	bool suppress_warnings = false;
+
+	std::string snapshot_path;
+	std::unique_ptr<detail::SnapshotWriter> snapshot;
+	bool snapshot_failed = false;
 };
 
 } // namespace zeek::input
@@ -0,0 +1,130 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "input/Snapshot.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "threading/SerialTypes.h"
+
+namespace zeek::input::detail {
+
+// Size at which the writer starts a new block of rows.
+static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
+SnapshotWriter::SnapshotWriter(std::string arg_path, int arg_num_fields,
+                               const threading::Field* const* arg_fields)
+	: path(std::move(arg_path)), num_fields(arg_num_fields), fields(arg_fields)
+	{
+	tmp_path = path + ".tmp";
+	}
+
+SnapshotWriter::~SnapshotWriter()
+	{
+	if ( file )
+		{
+		fclose(file);
+		unlink(tmp_path.c_str());
+		}
+	}
+
+bool SnapshotWriter::Fail(const char* what)
+	{
+	error = std::string(what) + " " + tmp_path + ": " + strerror(errno);
+	return false;
+	}
+
+bool SnapshotWriter::Open()
+	{
+	file = fopen(tmp_path.c_str(), "w");
+
+	if ( ! file )
+		return Fail("cannot create snapshot");
+
+	fmt.StartWrite();
+	fmt.Write(SNAPSHOT_MAGIC, "magic");
+	fmt.Write(SNAPSHOT_VERSION, "version");
+	fmt.Write(num_fields, "num_fields");
+
+	for ( int i = 0; i < num_fields; i++ )
+		fields[i]->Write(&fmt);
+
+	fmt.EndWrite(&block);
+	return FlushBlock();
+	}
+
+bool SnapshotWriter::Write(const threading::Value* const* vals)
+	{
+	if ( ! block_started )
+		{
+		fmt.StartWrite();
+		block_started = true;
+		}
+
+	for ( int i = 0; i < num_fields; i++ )
+		{
+		if ( ! vals[i]->Write(&fmt) )
+			{
+			error = std::string("cannot serialize field ") + fields[i]->name +
+			        " into snapshot " + path;
+			return false;
+			}
+		}
+
+	if ( size_t(fmt.BytesWritten()) < BLOCK_SIZE )
+		return true;
+
+	fmt.EndWrite(&block);
+	block_started = false;
+	return FlushBlock();
+	}
+
+bool SnapshotWriter::FlushBlock()
+	{
+	uint32_t len = block.size();
+	uint32_t nlen = htonl(len);
+
+	if ( fwrite(&nlen, sizeof(nlen), 1, file) != 1 ||
+	     (len && fwrite(block.data(), len, 1, file) != 1) )
+		return Fail("cannot write snapshot");
+
+	block.clear();
+	return true;
+	}
+
+bool SnapshotWriter::Finish()
+	{
+	if ( block_started )
+		{
+		fmt.EndWrite(&block);
+		block_started = false;
+
+		if ( ! FlushBlock() )
+			return false;
+		}
+
+	// The terminating empty block.
+	if ( ! FlushBlock() )
+		return false;
+
+	int rc = fclose(file);
+	file = nullptr;
+
+	if ( rc != 0 )
+		{
+		unlink(tmp_path.c_str());
+		return Fail("cannot write snapshot");
+		}
+
+	if ( rename(tmp_path.c_str(), path.c_str()) < 0 )
+		{
+		unlink(tmp_path.c_str());
+		return Fail("cannot rename snapshot");
+		}
+
+	return true;
+	}
+
+} // namespace zeek::input::detail
@@ -0,0 +1,86 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "SerializationFormat.h"
+
+ZEEK_FORWARD_DECLARE_NAMESPACED(Field, zeek, threading);
+ZEEK_FORWARD_DECLARE_NAMESPACED(Value, zeek, threading);
+
+namespace zeek::input::detail {
+
+/**
+ * Snapshots hold the entries an input reader sent during one pass over
+ * its source in binary form, so that the Snapshot reader can load them
+ * again without any parsing.
+ *
+ * A snapshot is a sequence of blocks, each a 32-bit length in network byte
+ * order followed by that many bytes in BinarySerializationFormat, which
+ * is in network byte order as well. The first block is the header with
+ * magic, version and the fields. All further blocks contain rows of values
+ * for these fields. A block of length zero terminates the snapshot.
+ */
+constexpr uint64_t SNAPSHOT_MAGIC = 0x5a45454b534e4150; // "ZEEKSNAP"
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+/**
+ * Writes a snapshot into a temporary file next to its destination, which
+ * is only renamed into place once the snapshot is complete.
+ */
+class SnapshotWriter {
+public:
+	SnapshotWriter(std::string path, int num_fields,
+	               const threading::Field* const* fields);
+
+	/**
+	 * Removes the temporary file if the snapshot wasn't finished.
+	 */
+	~SnapshotWriter();
+
+	SnapshotWriter(const SnapshotWriter&) = delete;
+	SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+	/**
+	 * Creates the temporary file and writes the header.
+	 *
+	 * @return False on error, with a message available via Error().
+	 */
+	bool Open();
+
+	/**
+	 * Appends a row of values.
+	 *
+	 * @return False on error, with a message available via Error().
+	 */
+	bool Write(const threading::Value* const* vals);
+
+	/**
+	 * Terminates the snapshot and moves it to its destination.
+	 *
+	 * @return False on error, with a message available via Error().
+	 */
+	bool Finish();
+
+	const std::string& Error() const	{ return error; }
+
+private:
+	bool FlushBlock();
+	bool Fail(const char* what);
+
+	std::string path;
+	std::string tmp_path;
+	int num_fields;
+	const threading::Field* const* fields;
+
+	FILE* file = nullptr;
+	zeek::detail::BinarySerializationFormat fmt;
+	bool block_started = false;
+	std::string block;
+	std::string error;
+};
+
+} // namespace zeek::input::detail
@@ -1,16 +1,22 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <algorithm>
 #include <sstream>
+#include <thread>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 #include "Ascii.h"
 #include "ascii.bif.h"
 
 #include "threading/SerialTypes.h"
+#include "Hash.h"
 
 using namespace std;
 using zeek::threading::Value;
@@ -18,6 +24,48 @@ using zeek::threading::Field;
 
 namespace zeek::input::reader::detail {
 
+// Upper bound for the InputAscii::parse_threads option.
+static constexpr size_t MAX_PARSE_THREADS = 64;
+
+// Size of the blocks hashed to detect rewrites without changes.
+static constexpr size_t DIGEST_BLOCK_SIZE = 1024 * 1024;
+
+void ContentDigester::Add(const char* data, size_t len)
+	{
+	while ( len > 0 )
+		{
+		if ( block.empty() && len >= DIGEST_BLOCK_SIZE )
+			{
+			digests.push_back(zeek::detail::KeyedHash::Hash64(data, DIGEST_BLOCK_SIZE));
+			data += DIGEST_BLOCK_SIZE;
+			len -= DIGEST_BLOCK_SIZE;
+			continue;
+			}
+
+		size_t n = std::min(len, DIGEST_BLOCK_SIZE - block.size());
+		block.append(data, n);
+		data += n;
+		len -= n;
+
+		if ( block.size() == DIGEST_BLOCK_SIZE )
+			{
+			digests.push_back(zeek::detail::KeyedHash::Hash64(block.data(), block.size()));
+			block.clear();
+			}
+		}
+	}
+
+vector<uint64_t> ContentDigester::Finish()
+	{
+	if ( ! block.empty() )
+		{
+		digests.push_back(zeek::detail::KeyedHash::Hash64(block.data(), block.size()));
+		block.clear();
+		}
+
+	return std::move(digests);
+	}
+
 FieldMapping::FieldMapping(const string& arg_name, const TypeTag& arg_type, int arg_position)
 	: name(arg_name), type(arg_type), subtype(TYPE_ERROR)
 	{
@@ -49,14 +97,22 @@ FieldMapping FieldMapping::subType()
 
 Ascii::Ascii(ReaderFrontend *frontend) : ReaderBackend(frontend)
 	{
+	file = nullptr;
+	line_buf = nullptr;
+	line_buf_size = 0;
 	mtime = 0;
 	ino = 0;
 	fail_on_file_problem = false;
 	fail_on_invalid_lines = false;
+	parse_threads = 0;
+	parse_chunk_size = 0;
+	reread_skip_unchanged = false;
 	}
 
 Ascii::~Ascii()
 	{
+	CloseFile();
+	free(line_buf);
 	}
 
 void Ascii::DoClose()
@@ -85,6 +141,10 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
 	path_prefix.assign((const char*) BifConst::InputAscii::path_prefix->Bytes(),
 	                   BifConst::InputAscii::path_prefix->Len());
 
+	parse_threads = BifConst::InputAscii::parse_threads;
+	parse_chunk_size = BifConst::InputAscii::parse_chunk_size;
+	reread_skip_unchanged = BifConst::InputAscii::reread_skip_unchanged;
+
 	// Set per-filter configuration options.
 	for ( ReaderInfo::config_map::const_iterator i = info.config.begin(); i != info.config.end(); i++ )
 		{
@@ -105,6 +165,15 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
 
 		else if ( strcmp(i->first, "fail_on_file_problem") == 0 )
 			fail_on_file_problem = (strncmp(i->second, "T", 1) == 0);
+
+		else if ( strcmp(i->first, "parse_threads") == 0 )
+			parse_threads = strtoull(i->second, nullptr, 10);
+
+		else if ( strcmp(i->first, "parse_chunk_size") == 0 )
+			parse_chunk_size = strtoull(i->second, nullptr, 10);
+
+		else if ( strcmp(i->first, "reread_skip_unchanged") == 0 )
+			reread_skip_unchanged = (strncmp(i->second, "T", 1) == 0);
 		}
 
 	if ( separator.size() != 1 )
@@ -116,13 +185,24 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
 	threading::formatter::Ascii::SeparatorInfo sep_info(separator, set_separator, unset_field, empty_field);
 	formatter = unique_ptr<threading::Formatter>(new threading::formatter::Ascii(this, sep_info));
 
+	// Streams keep reading from where they left off, which the
+	// parallel mode doesn't support.
+	if ( Info().mode == MODE_STREAM )
+		parse_threads = 0;
+
+	parse_threads = std::min(parse_threads, MAX_PARSE_THREADS);
+	parse_chunk_size = std::max(parse_chunk_size, size_t(1));
+
+	for ( size_t i = 0; i < parse_threads; i++ )
+		parse_formatters.emplace_back(new threading::formatter::Ascii(this, sep_info));
+
 	return DoUpdate();
 	}
 
 
 bool Ascii::OpenFile()
 	{
-	if ( file.is_open() )
+	if ( file )
 		return true;
 
 	// Handle path-prefixing. See similar logic in Binary::DoInit().
@@ -141,9 +221,9 @@ bool Ascii::OpenFile()
 		fname = path + "/" + fname;
 		}
 
-	file.open(fname);
+	file = fopen(fname.c_str(), "r");
 
-	if ( ! file.is_open() )
+	if ( ! file )
 		{
 		FailWarn(fail_on_file_problem, Fmt("Init: cannot open %s", fname.c_str()), true);
 
@@ -154,7 +234,7 @@ bool Ascii::OpenFile()
 		{
 		FailWarn(fail_on_file_problem, Fmt("Init: cannot open %s; problem reading file header", fname.c_str()), true);
 
-		file.close();
+		CloseFile();
 		return ! fail_on_file_problem;
 		}
 
@@ -162,6 +242,15 @@ bool Ascii::OpenFile()
 	return true;
 	}
 
+void Ascii::CloseFile()
+	{
+	if ( file )
+		{
+		fclose(file);
+		file = nullptr;
+		}
+	}
+
 bool Ascii::ReadHeader(bool useCached)
 	{
 	// try to read the header line...
@@ -246,13 +335,23 @@ bool Ascii::ReadHeader(bool useCached)
 
 bool Ascii::GetLine(string& str)
 	{
-	while ( getline(file, str) )
+	ssize_t n;
+
+	while ( (n = getline(&line_buf, &line_buf_size, file)) >= 0 )
 		{
-		if ( ! str.size() )
+		if ( digester )
+			digester->Add(line_buf, n);
+
+		if ( n > 0 && line_buf[n - 1] == '\n' )
+			--n;
+
+		if ( n == 0 )
 			continue;
 
-		if ( str.back() == '\r' ) // deal with \r\n by removing \r
-			str.pop_back();
+		if ( line_buf[n - 1] == '\r' ) // deal with \r\n by removing \r
+			--n;
+
+		str.assign(line_buf, n);
 
 		if ( str[0] != '#' )
 			return true;
@@ -282,7 +381,7 @@ bool Ascii::DoUpdate()
 				{
 				FailWarn(fail_on_file_problem, Fmt("Could not get stat for %s", fname.c_str()), true);
 
-				file.close();
+				CloseFile();
 				return ! fail_on_file_problem;
 				}
 
@@ -298,6 +397,33 @@ bool Ascii::DoUpdate()
 
 			mtime = sb.st_mtime;
 			ino = sb.st_ino;
+
+			if ( reread_skip_unchanged )
+				{
+				// Reopen the file and hash everything read from it
+				// from here on, so that the digests kept for the next
+				// check are those of the bytes actually parsed.
+				CloseFile();
+				digester = make_unique<ContentDigester>();
+
+				if ( ! OpenFile() || ! file )
+					{
+					digester.reset();
+					content_digests.clear();
+					return ! fail_on_file_problem;
+					}
+
+				if ( ContentUnchanged(fileno(file)) )
+					{
+					// Rewritten, but with the same content.
+					digester.reset();
+					return true;
+					}
+
+				// Parse the file we just opened.
+				break;
+				}
+
 			// File changed. Fall through to re-read.
 			}
 
@@ -306,11 +432,11 @@ bool Ascii::DoUpdate()
 			{
 			// dirty, fix me. (well, apparently after trying seeking, etc
 			// - this is not that bad)
-			if ( file.is_open() )
+			if ( file )
 				{
 				if ( Info().mode == MODE_STREAM )
 					{
-					file.clear(); // remove end of file evil bits
+					clearerr(file); // remove end of file evil bits
 					if ( ! ReadHeader(true) )
 						{
 						return ! fail_on_file_problem; // header reading failed
@@ -319,7 +445,7 @@ bool Ascii::DoUpdate()
 					break;
 					}
 
-				file.close();
+				CloseFile();
 				}
 
 			OpenFile();
@@ -332,120 +458,372 @@ bool Ascii::DoUpdate()
 
 		}
 
-	string line;
+	if ( parse_threads > 0 && file )
+		{
+		bool fatal = false;
 
-	file.sync();
+		if ( ReadParallel(fileno(file), ftello(file), &fatal) )
+			{
+			FinishDigests(true);
+			EndCurrentSend();
+			return true;
+			}
+
+		if ( fatal )
+			{
+			FinishDigests(false);
+			return false;
+			}
+
+		// Couldn't map the file, fall back to reading it line by line.
+		}
+
+	string line;
+	vector<string> split_buf;
 
 	while ( GetLine(line) )
 		{
-		// split on tabs
-		bool error = false;
-		istringstream splitstream(line);
+		ParsedLine pl;
+		ParseLine(line.data(), line.size(), formatter.get(), &split_buf, &pl);
 
-		map<int, string> stringfields;
-		int pos = 0;
-		while ( splitstream )
+		if ( ! SendLine(&pl) )
 			{
-			string s;
-			if ( ! getline(splitstream, s, separator[0]) )
-				break;
-
-			stringfields[pos] = s;
-			pos++;
+			FinishDigests(false);
+			return false;
 			}
+		}
 
-		pos--; // for easy comparisons of max element.
+	FinishDigests(! ferror(file));
 
-		Value** fields = new Value*[NumFields()];
+	if ( Info().mode != MODE_STREAM )
+		EndCurrentSend();
 
-		int fpos = 0;
-		for ( vector<FieldMapping>::iterator fit = columnMap.begin();
-			fit != columnMap.end();
-			fit++ )
-			{
+	return true;
+	}
 
-			if ( ! fit->present )
-				{
-				// add non-present field
-				fields[fpos] = new Value((*fit).type, false);
-				fpos++;
-				continue;
-				}
+void Ascii::FinishDigests(bool complete)
+	{
+	if ( ! digester )
+		return;
 
-			assert(fit->position >= 0 );
+	if ( complete )
+		content_digests = digester->Finish();
+	else
+		content_digests.clear();
 
-			if ( (*fit).position > pos || (*fit).secondary_position > pos )
-				{
-				FailWarn(fail_on_invalid_lines, Fmt("Not enough fields in line '%s' of %s. Found %d fields, want positions %d and %d",
-				                                    line.c_str(), fname.c_str(), pos, (*fit).position, (*fit).secondary_position));
+	digester.reset();
+	}
 
-				if ( fail_on_invalid_lines )
-					{
-					for ( int i = 0; i < fpos; i++ )
-						delete fields[i];
+// Splits a line into its fields the same way getline() on an istringstream
+// would, i.e., a trailing separator does not start another field. Fields are
+// assigned into the existing strings of the buffer to reuse their storage.
+// Returns the number of fields.
+static size_t split_fields(const char* line, size_t len, char sep, vector<string>* buf)
+	{
+	if ( len == 0 )
+		return 0;
 
-					delete [] fields;
+	const char* end = line + len;
+	size_t n = 0;
 
-					return false;
-					}
-				else
-					{
-					error = true;
-					break;
-					}
-				}
+	while ( true )
+		{
+		auto s = static_cast<const char*>(memchr(line, sep, end - line));
+		auto e = s ? s : end;
 
-			Value* val = formatter->ParseValue(stringfields[(*fit).position], (*fit).name, (*fit).type, (*fit).subtype);
+		if ( n == buf->size() )
+			buf->emplace_back();
 
-			if ( ! val )
-				{
-				Warning(Fmt("Could not convert line '%s' of %s to Val. Ignoring line.", line.c_str(), fname.c_str()));
-				error = true;
-				break;
-				}
+		(*buf)[n++].assign(line, e - line);
 
-			if ( (*fit).secondary_position != -1 )
-				{
-				// we have a port definition :)
-				assert(val->type == TYPE_PORT );
-				//	Error(Fmt("Got type %d != PORT with secondary position!", val->type));
+		if ( ! s )
+			break;
 
-				val->val.port_val.proto = formatter->ParseProto(stringfields[(*fit).secondary_position]);
-				}
+		line = s + 1;
+		}
 
-			fields[fpos] = val;
+	if ( (*buf)[n - 1].empty() )
+		--n;
 
-			fpos++;
+	return n;
+	}
+
+void Ascii::ParseLine(const char* line, size_t len, threading::Formatter* fmt,
+                      vector<string>* split_buf, ParsedLine* out) const
+	{
+	out->line = line;
+	out->len = len;
+
+	auto& stringfields = *split_buf;
+	int pos = int(split_fields(line, len, separator[0], split_buf)) - 1;
+
+	Value** fields = new Value*[NumFields()];
+	int fpos = 0;
+
+	for ( const auto& fm : columnMap )
+		{
+		if ( ! fm.present )
+			{
+			// add non-present field
+			fields[fpos++] = new Value(fm.type, false);
+			continue;
 			}
 
-		if ( error )
+		assert(fm.position >= 0);
+
+		if ( fm.position > pos || fm.secondary_position > pos )
 			{
-			// Encountered non-fatal error, ignoring line. But
-			// first, delete all successfully read fields and the
-			// array structure.
+			out->too_short = true;
+			out->num_fields = pos;
+			out->position = fm.position;
+			out->secondary_position = fm.secondary_position;
+			break;
+			}
 
-			for ( int i = 0; i < fpos; i++ )
-				delete fields[i];
+		Value* val = fmt->ParseValue(stringfields[fm.position], fm.name, fm.type, fm.subtype);
 
-			delete [] fields;
-			continue;
+		if ( ! val )
+			break;
+
+		if ( fm.secondary_position != -1 )
+			{
+			// we have a port definition :)
+			assert(val->type == TYPE_PORT);
+			val->val.port_val.proto = fmt->ParseProto(stringfields[fm.secondary_position]);
 			}
 
-		//printf("fpos: %d, second.num_fields: %d\n", fpos, (*it).second.num_fields);
-		assert ( fpos == NumFields() );
+		fields[fpos++] = val;
+		}
 
+	if ( fpos != NumFields() )
+		{
+		// Delete all successfully read fields and the array structure.
+		for ( int i = 0; i < fpos; i++ )
+			delete fields[i];
+
+		delete [] fields;
+		return;
+		}
+
+	out->fields = fields;
+	}
+
+bool Ascii::SendLine(ParsedLine* pl)
+	{
+	for ( const auto& w : pl->warnings )
+		Warning(w.c_str());
+
+	if ( pl->fields )
+		{
 		if ( Info().mode == MODE_STREAM )
-			Put(fields);
+			Put(pl->fields);
 		else
-			SendEntry(fields);
+			SendEntry(pl->fields);
+
+		pl->fields = nullptr;
+		return true;
 		}
 
-	if ( Info().mode != MODE_STREAM )
-		EndCurrentSend();
+	string line(pl->line, pl->len);
+
+	if ( pl->too_short )
+		{
+		FailWarn(fail_on_invalid_lines, Fmt("Not enough fields in line '%s' of %s. Found %d fields, want positions %d and %d",
+		                                    line.c_str(), fname.c_str(), pl->num_fields, pl->position, pl->secondary_position));
+
+		return ! fail_on_invalid_lines;
+		}
+
+	Warning(Fmt("Could not convert line '%s' of %s to Val. Ignoring line.", line.c_str(), fname.c_str()));
+	return true;
+	}
+
+// Returns the next data line between p and end, applying the same rules as
+// GetLine(), and advances p past it.
+static bool next_line(const char*& p, const char* end, char sep,
+                      const char** line, size_t* len)
+	{
+	while ( p < end )
+		{
+		auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* s = p;
+		const char* e = nl ? nl : end;
+		p = nl ? nl + 1 : end;
+
+		if ( s == e )
+			continue;
+
+		if ( e[-1] == '\r' ) // deal with \r\n by removing \r
+			--e;
+
+		size_t l = e - s;
+
+		if ( l == 0 || s[0] != '#' )
+			{
+			*line = s;
+			*len = l;
+			return true;
+			}
+
+		if ( l > 8 && memcmp(s, "#fields", 7) == 0 && s[7] == sep )
+			{
+			*line = s + 8;
+			*len = l - 8;
+			return true;
+			}
+		}
+
+	return false;
+	}
+
+// Parses the file behind fd from offset on. The descriptor is the one the
+// header was read from, so a file replaced in the meantime can't get mixed in.
+bool Ascii::ReadParallel(int fd, off_t offset, bool* fatal)
+	{
+	struct stat sb;
+
+	if ( fstat(fd, &sb) < 0 )
+		return false;
+
+	if ( offset < 0 || sb.st_size <= offset )
+		// Nothing but the header.
+		return true;
+
+	size_t size = sb.st_size;
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if ( mapping == MAP_FAILED )
+		return false;
+
+	madvise(mapping, size, MADV_SEQUENTIAL);
+
+	const char* p = static_cast<const char*>(mapping) + offset;
+	const char* end = static_cast<const char*>(mapping) + size;
+	char sep = separator[0];
+
+	vector<vector<ParsedLine>> results(parse_threads);
+	vector<pair<const char*, const char*>> chunks;
+
+	auto parse_chunk = [&](size_t i)
+		{
+		auto fmt = parse_formatters[i].get();
+		const char* cp = chunks[i].first;
+		const char* line;
+		size_t len;
+		vector<string> split_buf;
+
+		while ( next_line(cp, chunks[i].second, sep, &line, &len) )
+			{
+			results[i].emplace_back();
+			auto& pl = results[i].back();
+			fmt->SetWarningBuffer(&pl.warnings);
+			ParseLine(line, len, fmt, &split_buf, &pl);
+			}
+
+		fmt->SetWarningBuffer(nullptr);
+		};
+
+	bool ok = true;
+
+	while ( ok && p < end )
+		{
+		// Cut the next piece of the file into one chunk per thread,
+		// each ending at a line boundary.
+		const char* batch = p;
+		chunks.clear();
+
+		while ( p < end && chunks.size() < parse_threads )
+			{
+			const char* cend = end;
+
+			if ( size_t(end - p) > parse_chunk_size )
+				{
+				auto nl = static_cast<const char*>(memchr(p + parse_chunk_size, '\n',
+				                                          end - p - parse_chunk_size));
+				cend = nl ? nl + 1 : end;
+				}
+
+			chunks.emplace_back(p, cend);
+			p = cend;
+			}
+
+		vector<std::thread> workers;
+
+		for ( size_t i = 1; i < chunks.size(); i++ )
+			workers.emplace_back(parse_chunk, i);
+
+		parse_chunk(0);
+
+		for ( auto& t : workers )
+			t.join();
+
+		if ( digester )
+			digester->Add(batch, p - batch);
+
+		// Send the results in file order.
+		for ( size_t i = 0; i < chunks.size(); i++ )
+			{
+			for ( auto& pl : results[i] )
+				{
+				if ( ok && ! SendLine(&pl) )
+					ok = false;
+
+				if ( pl.fields )
+					{
+					for ( int j = 0; j < NumFields(); j++ )
+						delete pl.fields[j];
+
+					delete [] pl.fields;
+					}
+				}
+
+			results[i].clear();
+			}
+		}
+
+	munmap(mapping, size);
+
+	if ( ! ok )
+		{
+		*fatal = true;
+		return false;
+		}
 
 	return true;
 	}
 
+// Hashes the file behind fd block by block and compares the digests to the
+// ones of the bytes parsed last time. Returns false if anything differs or
+// the file cannot be read.
+bool Ascii::ContentUnchanged(int fd) const
+	{
+	if ( content_digests.empty() )
+		return false;
+
+	ContentDigester d;
+	unique_ptr<char[]> buf(new char[DIGEST_BLOCK_SIZE]);
+	off_t offset = 0;
+
+	while ( true )
+		{
+		ssize_t n = pread(fd, buf.get(), DIGEST_BLOCK_SIZE, offset);
+
+		if ( n < 0 && errno == EINTR )
+			continue;
+
+		if ( n < 0 )
+			return false;
+
+		if ( n == 0 )
+			break;
+
+		d.Add(buf.get(), n);
+		offset += n;
+		}
+
+	return d.Finish() == content_digests;
+	}
+
 bool Ascii::DoHeartbeat(double network_time, double current_time)
 	{
 	if ( ! OpenFile() )
@@ -2,9 +2,8 @@
 
 #pragma once
 
-#include <iostream>
+#include <cstdio>
 #include <vector>
-#include <fstream>
 #include <memory>
 #include <sys/types.h>
 
@@ -31,6 +30,21 @@ struct FieldMapping {
 	FieldMapping subType();
 };
 
+// Hashes a file in fixed-size blocks, no matter in what pieces its
+// bytes are passed in.
+class ContentDigester {
+public:
+	void Add(const char* data, size_t len);
+
+	// Returns the digests of all blocks, including a trailing
+	// partial one.
+	std::vector<uint64_t> Finish();
+
+private:
+	std::vector<uint64_t> digests;
+	std::string block;
+};
+
 /**
  * Reader for structured ASCII files.
  */
@@ -54,11 +68,40 @@ protected:
 	bool DoHeartbeat(double network_time, double current_time) override;
 
 private:
+	// A data line converted into threading values, along with anything
+	// to report about it.
+	struct ParsedLine {
+		// The converted fields, or null if the line is to be ignored.
+		threading::Value** fields = nullptr;
+		// The raw line, for error messages.
+		const char* line = nullptr;
+		size_t len = 0;
+		// Warnings collected by the formatter of a helper thread.
+		std::vector<std::string> warnings;
+		// Set if the line has fewer fields than required.
+		bool too_short = false;
+		int num_fields = 0;
+		int position = 0;
+		int secondary_position = 0;
+	};
+
 	bool ReadHeader(bool useCached);
 	bool GetLine(std::string& str);
 	bool OpenFile();
-
-	std::ifstream file;
+	void CloseFile();
+
+	void ParseLine(const char* line, size_t len, threading::Formatter* fmt,
+	               std::vector<std::string>* split_buf, ParsedLine* out) const;
+	bool SendLine(ParsedLine* pl);
+	bool ReadParallel(int fd, off_t offset, bool* fatal);
+	bool ContentUnchanged(int fd) const;
+	void FinishDigests(bool complete);
+
+	// A stdio stream rather than an ifstream, so that the parallel mode
+	// can map the very file that the header was read from.
+	FILE* file;
+	char* line_buf;
+	size_t line_buf_size;
 	time_t mtime;
 	ino_t ino;
 
@@ -81,8 +124,18 @@ private:
 	bool fail_on_invalid_lines;
 	bool fail_on_file_problem;
 	std::string path_prefix;
+	size_t parse_threads;
+	size_t parse_chunk_size;
+	bool reread_skip_unchanged;
+
+	// Digests of the blocks of the file as last read in REREAD mode.
+	std::vector<uint64_t> content_digests;
+	// Set while a REREAD pass hashes the bytes it parses.
+	std::unique_ptr<ContentDigester> digester;
 
 	std::unique_ptr<threading::Formatter> formatter;
+	// One per helper thread when parsing in parallel.
+	std::vector<std::unique_ptr<threading::Formatter>> parse_formatters;
 };
 
 } // namespace zeek::input::reader::detail
@@ -0,0 +1,22 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "plugin/Plugin.h"
+
+#include "Snapshot.h"
+
+namespace zeek::plugin::detail::Zeek_SnapshotReader {
+
+class Plugin : public zeek::plugin::Plugin {
+public:
+	zeek::plugin::Configuration Configure() override
+		{
+		AddComponent(new zeek::input::Component("Snapshot", zeek::input::reader::detail::Snapshot::Instantiate));
+
+		zeek::plugin::Configuration config;
+		config.name = "Zeek::SnapshotReader";
+		config.description = "Binary snapshot input reader";
+		return config;
+		}
+} plugin;
+
+} // namespace zeek::plugin::detail::Zeek_SnapshotReader
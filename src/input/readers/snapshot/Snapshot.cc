@@ -0,0 +1,325 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Snapshot.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <memory>
+#include <vector>
+
+#include "input/Snapshot.h"
+#include "threading/SerialTypes.h"
+
+using namespace std;
+using zeek::threading::Value;
+using zeek::threading::Field;
+
+namespace zeek::input::reader::detail {
+
+Snapshot::Snapshot(ReaderFrontend *frontend) : ReaderBackend(frontend)
+	{
+	mtime = 0;
+	ino = 0;
+	}
+
+Snapshot::~Snapshot()
+	{
+	}
+
+void Snapshot::DoClose()
+	{
+	}
+
+bool Snapshot::DoInit(const ReaderInfo& info, int num_fields, const Field* const* fields)
+	{
+	if ( info.mode == MODE_STREAM )
+		{
+		Error("Snapshots cannot be read in STREAM mode");
+		return false;
+		}
+
+	fname = info.source;
+	return DoUpdate();
+	}
+
+bool Snapshot::DoUpdate()
+	{
+	int fd = open(fname.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		Error(Fmt("Cannot open snapshot %s: %s", fname.c_str(), strerror(errno)));
+		return false;
+		}
+
+	struct stat sb;
+
+	if ( fstat(fd, &sb) < 0 )
+		{
+		Error(Fmt("Could not get stat for %s", fname.c_str()));
+		close(fd);
+		return false;
+		}
+
+	if ( Info().mode == MODE_REREAD )
+		{
+		if ( sb.st_ino == ino && sb.st_mtime == mtime )
+			{
+			// no change
+			close(fd);
+			return true;
+			}
+
+		mtime = sb.st_mtime;
+		ino = sb.st_ino;
+		}
+
+	size_t size = sb.st_size;
+	void* data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+	close(fd);
+
+	if ( data == MAP_FAILED )
+		{
+		Error(Fmt("Cannot map snapshot %s: %s", fname.c_str(), strerror(errno)));
+		return false;
+		}
+
+	if ( data )
+		madvise(data, size, MADV_SEQUENTIAL);
+
+	bool ok = ReadSnapshot(static_cast<const char*>(data), size);
+
+	if ( data )
+		munmap(data, size);
+
+	return ok;
+	}
+
+bool Snapshot::ReadSnapshot(const char* data, size_t size)
+	{
+	const char* end = data + size;
+
+	auto next_block = [&](const char** block, uint32_t* len) -> bool
+		{
+		if ( size_t(end - data) < sizeof(*len) )
+			return false;
+
+		memcpy(len, data, sizeof(*len));
+		*len = ntohl(*len);
+		data += sizeof(*len);
+
+		if ( size_t(end - data) < *len )
+			return false;
+
+		*block = data;
+		data += *len;
+		return true;
+		};
+
+	const char* block;
+	uint32_t len;
+	zeek::detail::BinarySerializationFormat fmt;
+
+	uint64_t magic = 0;
+	uint32_t version = 0;
+	int snap_num_fields = 0;
+
+	if ( ! next_block(&block, &len) )
+		{
+		Error(Fmt("Snapshot %s is truncated", fname.c_str()));
+		return false;
+		}
+
+	fmt.StartRead(block, len);
+
+	if ( ! (fmt.Read(&magic, "magic") && fmt.Read(&version, "version") &&
+	        fmt.Read(&snap_num_fields, "num_fields")) ||
+	     magic != input::detail::SNAPSHOT_MAGIC || snap_num_fields < 0 )
+		{
+		Error(Fmt("%s is not a snapshot", fname.c_str()));
+		return false;
+		}
+
+	if ( version != input::detail::SNAPSHOT_VERSION )
+		{
+		Error(Fmt("Snapshot %s has unsupported version %u", fname.c_str(), version));
+		return false;
+		}
+
+	vector<unique_ptr<Field>> snap_fields;
+
+	for ( int i = 0; i < snap_num_fields; i++ )
+		{
+		snap_fields.emplace_back(new Field(nullptr, nullptr, TYPE_ERROR, TYPE_ERROR, false));
+
+		if ( ! snap_fields.back()->Read(&fmt) )
+			{
+			Error(Fmt("Snapshot %s has a corrupt header", fname.c_str()));
+			return false;
+			}
+		}
+
+	fmt.EndRead();
+
+	// Map our fields to the ones of the snapshot by name. If a name
+	// appears more than once, e.g. in both index and value, the
+	// occurrences are matched in order.
+	vector<int> positions;
+	vector<bool> used(snap_num_fields);
+
+	for ( int i = 0; i < NumFields(); i++ )
+		{
+		const Field* field = Fields()[i];
+		int pos = -1;
+
+		for ( int j = 0; j < snap_num_fields; j++ )
+			{
+			if ( ! used[j] && strcmp(snap_fields[j]->name, field->name) == 0 )
+				{
+				pos = j;
+				break;
+				}
+			}
+
+		if ( pos < 0 )
+			{
+			if ( ! field->optional )
+				{
+				Error(Fmt("Did not find requested field %s in snapshot %s",
+				          field->name, fname.c_str()));
+				return false;
+				}
+			}
+
+		else if ( snap_fields[pos]->type != field->type ||
+		          snap_fields[pos]->subtype != field->subtype )
+			{
+			Error(Fmt("Field %s in snapshot %s has type %s, expected %s",
+			          field->name, fname.c_str(), snap_fields[pos]->TypeName().c_str(),
+			          field->TypeName().c_str()));
+			return false;
+			}
+
+		else
+			used[pos] = true;
+
+		positions.push_back(pos);
+		}
+
+	// Decode all rows before sending any of them, so that a corrupt or
+	// truncated snapshot leaves the destination untouched.
+	vector<Value*> row(snap_num_fields);
+	vector<Value**> rows;
+	bool terminated = false;
+
+	auto delete_rows = [&]()
+		{
+		for ( auto fields : rows )
+			{
+			for ( int i = 0; i < NumFields(); i++ )
+				delete fields[i];
+
+			delete [] fields;
+			}
+		};
+
+	while ( next_block(&block, &len) )
+		{
+		if ( len == 0 )
+			{
+			terminated = true;
+			break;
+			}
+
+		fmt.StartRead(block, len);
+
+		while ( uint32_t(fmt.BytesRead()) < len )
+			{
+			bool row_ok = true;
+
+			for ( int j = 0; j < snap_num_fields; j++ )
+				{
+				row[j] = new Value();
+
+				if ( ! row[j]->Read(&fmt) )
+					{
+					for ( int k = 0; k <= j; k++ )
+						delete row[k];
+
+					row_ok = false;
+					break;
+					}
+				}
+
+			if ( ! row_ok )
+				{
+				delete_rows();
+				Error(Fmt("Snapshot %s is corrupt", fname.c_str()));
+				return false;
+				}
+
+			Value** fields = new Value*[NumFields()];
+
+			for ( int i = 0; i < NumFields(); i++ )
+				{
+				if ( positions[i] < 0 )
+					fields[i] = new Value(Fields()[i]->type, false);
+				else
+					{
+					fields[i] = row[positions[i]];
+					row[positions[i]] = nullptr;
+					}
+				}
+
+			for ( auto& v : row )
+				{
+				delete v;
+				v = nullptr;
+				}
+
+			rows.push_back(fields);
+			}
+
+		fmt.EndRead();
+		}
+
+	if ( ! terminated || data != end )
+		{
+		delete_rows();
+		Error(Fmt("Snapshot %s is %s", fname.c_str(),
+		          terminated ? "followed by trailing data" : "truncated"));
+		return false;
+		}
+
+	for ( auto fields : rows )
+		SendEntry(fields);
+
+	EndCurrentSend();
+	return true;
+	}
+
+bool Snapshot::DoHeartbeat(double network_time, double current_time)
+	{
+	switch ( Info().mode ) {
+		case MODE_MANUAL:
+			// yay, we do nothing :)
+			break;
+
+		case MODE_REREAD:
+			Update(); // Call Update, not DoUpdate, because Update
+				  // checks the "disabled" flag.
+			break;
+
+		default:
+			assert(false);
+		}
+
+	return true;
+	}
+
+} // namespace zeek::input::reader::detail
@@ -0,0 +1,44 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+
+#include "input/ReaderBackend.h"
+
+namespace zeek::input::reader::detail {
+
+/**
+ * Reader for snapshots that other readers wrote of their data, see
+ * input/Snapshot.h. The values are stored in binary form, so loading
+ * them involves no parsing.
+ */
+class Snapshot : public ReaderBackend {
+public:
+	explicit Snapshot(ReaderFrontend* frontend);
+	~Snapshot() override;
+
+	// prohibit copying and moving
+	Snapshot(const Snapshot&) = delete;
+	Snapshot(Snapshot&&) = delete;
+	Snapshot& operator=(const Snapshot&) = delete;
+	Snapshot& operator=(Snapshot&&) = delete;
+
+	static ReaderBackend* Instantiate(ReaderFrontend* frontend) { return new Snapshot(frontend); }
+
+protected:
+	bool DoInit(const ReaderInfo& info, int arg_num_fields, const threading::Field* const* fields) override;
+	void DoClose() override;
+	bool DoUpdate() override;
+	bool DoHeartbeat(double network_time, double current_time) override;
+
+private:
+	bool ReadSnapshot(const char* data, size_t size);
+
+	std::string fname;
+	time_t mtime;
+	ino_t ino;
+};
+
+} // namespace zeek::input::reader::detail
@@ -214,6 +214,12 @@ void Manager::Poll(std::vector<IOSource*>* ready, double timeout, IOSource* time
 				if ( it != fd_map.end() )
 					ready->push_back(it->second);
 				}
+			else if ( events[i].filter == EVFILT_WRITE )
+				{
+				std::map<int, IOSource*>::const_iterator it = write_fd_map.find(events[i].ident);
+				if ( it != write_fd_map.end() )
+					ready->push_back(it->second);
+				}
 			}
 		}
 	}
@@ -235,16 +241,38 @@ void Manager::ConvertTimeout(double timeout, struct timespec& spec)
 		}
 	}
 
-bool Manager::RegisterFd(int fd, IOSource* src)
+bool Manager::RegisterFd(int fd, IOSource* src, int flags)
 	{
-	struct kevent event;
-	EV_SET(&event, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
-	int ret = kevent(event_queue, &event, 1, NULL, 0, NULL);
+	std::vector<struct kevent> changes;
+
+	if ( flags & READ )
+		{
+		changes.push_back({});
+		EV_SET(&changes.back(), fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+		}
+
+	if ( flags & WRITE )
+		{
+		changes.push_back({});
+		EV_SET(&changes.back(), fd, EVFILT_WRITE, EV_ADD, 0, 0, NULL);
+		}
+
+	int ret = kevent(event_queue, changes.data(), changes.size(), NULL, 0, NULL);
 	if ( ret != -1 )
 		{
-		events.push_back({});
+		if ( flags & READ )
+			{
+			events.push_back({});
+			fd_map[fd] = src;
+			}
+
+		if ( flags & WRITE )
+			{
+			events.push_back({});
+			write_fd_map[fd] = src;
+			}
+
 		DBG_LOG(DBG_MAINLOOP, "Registered fd %d from %s", fd, src->Tag());
-		fd_map[fd] = src;
 
 		Wakeup("RegisterFd");
 		return true;
@@ -256,17 +284,33 @@ bool Manager::RegisterFd(int fd, IOSource* src)
 		}
 	}
 
-bool Manager::UnregisterFd(int fd, IOSource* src)
+bool Manager::UnregisterFd(int fd, IOSource* src, int flags)
 	{
-	if ( fd_map.find(fd) != fd_map.end() )
+	bool found = false;
+
+	if ( (flags & READ) && fd_map.find(fd) != fd_map.end() )
 		{
 		struct kevent event;
 		EV_SET(&event, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
-		int ret = kevent(event_queue, &event, 1, NULL, 0, NULL);
-		if ( ret != -1 )
-			DBG_LOG(DBG_MAINLOOP, "Unregistered fd %d from %s", fd, src->Tag());
-
+		kevent(event_queue, &event, 1, NULL, 0, NULL);
 		fd_map.erase(fd);
+		events.pop_back();
+		found = true;
+		}
+
+	if ( (flags & WRITE) && write_fd_map.find(fd) != write_fd_map.end() )
+		{
+		struct kevent event;
+		EV_SET(&event, fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+		kevent(event_queue, &event, 1, NULL, 0, NULL);
+		write_fd_map.erase(fd);
+		events.pop_back();
+		found = true;
+		}
+
+	if ( found )
+		{
+		DBG_LOG(DBG_MAINLOOP, "Unregistered fd %d from %s", fd, src->Tag());
 
 		Wakeup("UnregisterFd");
 		return true;
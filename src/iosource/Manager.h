@@ -109,6 +109,14 @@ public:
 	 */
 	void FindReadySources(std::vector<IOSource*>* ready);
 
+	/**
+	 * The kinds of readiness a file descriptor can be checked for.
+	 */
+	enum ReadyFlag {
+		READ = 0x01,
+		WRITE = 0x02
+	};
+
 	/**
 	 * Registers a file descriptor and associated IOSource with the manager
 	 * to be checked during FindReadySources.
@@ -116,13 +124,17 @@ public:
 	 * @param fd A file descriptor pointing at some resource that should be
 	 * checked for readiness.
 	 * @param src The IOSource that owns the file descriptor.
+	 * @param flags A combination of ReadyFlag values selecting whether
+	 * the source becomes ready when \a fd is readable, writable, or both.
 	 */
-	bool RegisterFd(int fd, IOSource* src);
+	bool RegisterFd(int fd, IOSource* src, int flags = READ);
 
 	/**
 	 * Unregisters a file descriptor from the FindReadySources checks.
+	 *
+	 * @param flags The ReadyFlag values to stop checking for.
 	 */
-	bool UnregisterFd(int fd, IOSource* src);
+	bool UnregisterFd(int fd, IOSource* src, int flags = READ);
 
 	/**
 	 * Forces the poll in FindReadySources to wake up immediately. This method
@@ -204,6 +216,7 @@ private:
 
 	int event_queue = -1;
 	std::map<int, IOSource*> fd_map;
+	std::map<int, IOSource*> write_fd_map;
 
 	// This is only used for the output of the call to kqueue in FindReadySources().
 	// The actual events are stored as part of the queue.
@@ -4,6 +4,11 @@
 #include "IP.h"
 #include "iosource/Manager.h"
 #include "Var.h"
+#include "telemetry/Latency.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
 extern "C" {
 #include <pcap.h>
@@ -65,7 +70,10 @@ void Packet::Init(int arg_link_type, pkt_timeval *arg_ts, uint32_t arg_caplen,
 		}
 
 	if ( data )
+		{
+		telemetry::LatencyTimer latency(telemetry::StageLatency(telemetry::Stage::LinkLayer));
 		ProcessLayer2();
+		}
 	}
 
 const IP_Hdr Packet::IP() const
@@ -73,6 +81,93 @@ const IP_Hdr Packet::IP() const
 	return IP_Hdr((struct ip *) (data + hdr_size), false);
 	}
 
+// The finalizer of MurmurHash3, mixing all input bits into all output bits.
+static inline uint32_t fmix32(uint32_t h)
+	{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+	}
+
+static inline uint32_t load32(const u_char* p)
+	{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+	}
+
+uint32_t Packet::FlowHash(bool with_ports) const
+	{
+	if ( hdr_size > cap_len )
+		return 0;
+
+	const u_char* l3 = data + hdr_size;
+	uint32_t l3_len = cap_len - hdr_size;
+
+	// The addresses, with IPv6 ones folded into 32 bits.
+	uint32_t src, dst;
+
+	// The transport header if this is an unfragmented TCP or UDP packet.
+	const u_char* l4 = nullptr;
+	uint8_t proto = 0;
+
+	if ( l3_proto == L3_IPV4 )
+		{
+		if ( l3_len < sizeof(struct ip) )
+			return 0;
+
+		const struct ip* ip = (const struct ip*) l3;
+		uint32_t ip_hdr_len = ip->ip_hl * 4;
+
+		src = load32(l3 + offsetof(struct ip, ip_src));
+		dst = load32(l3 + offsetof(struct ip, ip_dst));
+		proto = ip->ip_p;
+
+		if ( (ntohs(ip->ip_off) & (IP_MF | IP_OFFMASK)) == 0 &&
+		     ip_hdr_len >= sizeof(struct ip) && l3_len >= ip_hdr_len + 4 )
+			l4 = l3 + ip_hdr_len;
+		}
+
+	else if ( l3_proto == L3_IPV6 )
+		{
+		if ( l3_len < sizeof(struct ip6_hdr) )
+			return 0;
+
+		const u_char* s = l3 + offsetof(struct ip6_hdr, ip6_src);
+		const u_char* d = l3 + offsetof(struct ip6_hdr, ip6_dst);
+		src = load32(s) ^ load32(s + 4) ^ load32(s + 8) ^ load32(s + 12);
+		dst = load32(d) ^ load32(d + 4) ^ load32(d + 8) ^ load32(d + 12);
+
+		// Packets with extension headers hash without ports, which
+		// keeps this cheap and covers fragments.
+		proto = ((const struct ip6_hdr*) l3)->ip6_nxt;
+
+		if ( l3_len >= sizeof(struct ip6_hdr) + 4 )
+			l4 = l3 + sizeof(struct ip6_hdr);
+		}
+
+	else
+		return 0;
+
+	// Ordering the endpoints makes the hash symmetric.
+	uint32_t h = fmix32(std::max(src, dst));
+	h = fmix32(h ^ std::min(src, dst));
+
+	if ( with_ports && l4 && (proto == IPPROTO_TCP || proto == IPPROTO_UDP) )
+		{
+		// TCP and UDP headers both start with the ports.
+		uint16_t sport = (l4[0] << 8) | l4[1];
+		uint16_t dport = (l4[2] << 8) | l4[3];
+		uint32_t ports = (uint32_t(std::max(sport, dport)) << 16) | std::min(sport, dport);
+		h = fmix32(h ^ ports ^ (uint32_t(proto) << 24));
+		}
+
+	return h;
+	}
+
 void Packet::Weird(const char* name)
 	{
 	sessions->Weird(name, this);
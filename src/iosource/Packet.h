@@ -131,6 +131,23 @@ public:
 	 */
 	const IP_Hdr IP() const;
 
+	/**
+	 * Returns a hash of the packet's flow that's the same for both of its
+	 * directions, and across Zeek processes. It covers the IP addresses
+	 * and, if *with_ports* is true, the protocol and ports of TCP and UDP
+	 * packets. Tunneled packets hash by their outermost IP header.
+	 *
+	 * IP fragments never include ports, so with ports, they may hash
+	 * differently from the unfragmented packets of their connection.
+	 *
+	 * @param with_ports Whether to include the transport protocol and
+	 * ports.
+	 *
+	 * @return The hash, or 0 if the packet isn't IP or is truncated.
+	 * Only valid if Layer2Valid() returns true.
+	 */
+	uint32_t FlowHash(bool with_ports = true) const;
+
 	/**
 	 * Returns a \c raw_pkt_hdr RecordVal, which includes layer 2 and
 	 * also everything in IP_Hdr (i.e., IP4/6 + TCP/UDP/ICMP).
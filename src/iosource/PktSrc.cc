@@ -12,6 +12,7 @@
 #include "broker/Manager.h"
 #include "iosource/Manager.h"
 #include "BPF_Program.h"
+#include "telemetry/Latency.h"
 
 #include "pcap/pcap.bif.h"
 
@@ -196,8 +197,13 @@ void PktSrc::Process()
 	if ( ! IsOpen() )
 		return;
 
+	telemetry::LatencyTimer latency(telemetry::StageLatency(telemetry::Stage::PacketSource));
+
 	if ( ! ExtractNextPacketInternal() )
+		{
+		latency.Cancel();
 		return;
+		}
 
 	if ( current_packet.Layer2Valid() )
 		{
@@ -0,0 +1,570 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "MappedTrace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include "util.h"
+
+namespace zeek::iosource::pcap::detail {
+
+static constexpr uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+static constexpr uint32_t PCAP_MAGIC_NSEC = 0xa1b23c4d;
+
+static constexpr uint32_t PCAPNG_SECTION_HEADER = 0x0a0d0d0a;
+static constexpr uint32_t PCAPNG_INTERFACE = 0x00000001;
+static constexpr uint32_t PCAPNG_PACKET = 0x00000002;	// obsolete
+static constexpr uint32_t PCAPNG_SIMPLE_PACKET = 0x00000003;
+static constexpr uint32_t PCAPNG_ENHANCED_PACKET = 0x00000006;
+static constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+
+static constexpr uint16_t PCAPNG_OPT_END = 0;
+static constexpr uint16_t PCAPNG_OPT_IF_TSRESOL = 9;
+static constexpr uint16_t PCAPNG_OPT_IF_TSOFFSET = 14;
+
+static constexpr uint32_t LINKTYPE_RAW = 101;
+
+// How far ahead of the current position the kernel gets asked to read.
+static constexpr size_t read_ahead = 16 * 1024 * 1024;
+
+// Trace files use LINKTYPE_* values, which differ from the platform's
+// DLT_* ones for raw IP.
+static int link_type_to_dlt(uint32_t link_type)
+	{
+	return link_type == LINKTYPE_RAW ? DLT_RAW : static_cast<int>(link_type);
+	}
+
+static uint32_t bswap32(uint32_t v)
+	{
+	return ((v & 0xff) << 24) | ((v & 0xff00) << 8) |
+	       ((v >> 8) & 0xff00) | ((v >> 24) & 0xff);
+	}
+
+static uint64_t pow10(unsigned int exponent)
+	{
+	uint64_t v = 1;
+
+	while ( exponent-- )
+		v *= 10;
+
+	return v;
+	}
+
+// Returns the compression format of a file starting with the given bytes,
+// or null if it doesn't look compressed.
+static const char* compression_format(const u_char* data, size_t len)
+	{
+	static const struct {
+		const char* name;
+		const char* magic;
+		size_t len;
+	} formats[] = {
+		{"gzip", "\x1f\x8b", 2},
+		{"bzip2", "BZh", 3},
+		{"xz", "\xfd" "7zXZ", 5},
+		{"zstd", "\x28\xb5\x2f\xfd", 4},
+		{"lz4", "\x04\x22\x4d\x18", 4},
+	};
+
+	for ( const auto& f : formats )
+		{
+		if ( len >= f.len && memcmp(data, f.magic, f.len) == 0 )
+			return f.name;
+		}
+
+	return nullptr;
+	}
+
+MappedTrace::~MappedTrace()
+	{
+	if ( mapping )
+		munmap(const_cast<u_char*>(mapping), size);
+
+	if ( fd >= 0 )
+		close(fd);
+	}
+
+std::unique_ptr<MappedTrace> MappedTrace::Open(const std::string& path, std::string* error)
+	{
+	error->clear();
+
+	int fd = open(path.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		return nullptr;
+
+	std::unique_ptr<MappedTrace> t(new MappedTrace());
+	t->fd = fd;
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || ! S_ISREG(st.st_mode) || st.st_size < 4 ||
+	     static_cast<uint64_t>(st.st_size) > SIZE_MAX )
+		return nullptr;
+
+	void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if ( m == MAP_FAILED )
+		return nullptr;
+
+	t->mapping = static_cast<const u_char*>(m);
+	t->size = st.st_size;
+
+	madvise(m, t->size, MADV_SEQUENTIAL);
+
+	uint32_t magic;
+	memcpy(&magic, t->mapping, sizeof(magic));
+
+	bool ok;
+
+	if ( magic == PCAPNG_SECTION_HEADER )
+		ok = t->ParsePcapngHeader();
+
+	else if ( magic == PCAP_MAGIC || magic == PCAP_MAGIC_NSEC ||
+	          magic == bswap32(PCAP_MAGIC) || magic == bswap32(PCAP_MAGIC_NSEC) )
+		ok = t->ParsePcapHeader();
+
+	else
+		{
+		if ( auto format = compression_format(t->mapping, t->size) )
+			*error = util::fmt("the file is compressed with %s; decompress it, "
+			                   "or pipe it into 'zeek -r -'", format);
+
+		return nullptr;
+		}
+
+	if ( ! ok )
+		{
+		*error = t->error;
+		return nullptr;
+		}
+
+	return t;
+	}
+
+int MappedTrace::Next(Record* r)
+	{
+	if ( pos + read_ahead / 2 >= advised_until )
+		Advise();
+
+	return pcapng ? NextPcapng(r) : NextPcap(r);
+	}
+
+bool MappedTrace::ParsePcapHeader()
+	{
+	if ( size < 24 )
+		return Fail(util::fmt("truncated dump file; tried to read 24 file header bytes, only got %zu", size));
+
+	uint32_t magic;
+	memcpy(&magic, mapping, sizeof(magic));
+
+	swapped = magic == bswap32(PCAP_MAGIC) || magic == bswap32(PCAP_MAGIC_NSEC);
+	nanoseconds = magic == PCAP_MAGIC_NSEC || magic == bswap32(PCAP_MAGIC_NSEC);
+
+	// The upper bits of the link type may describe the FCS.
+	link_type = link_type_to_dlt(Get32(mapping + 20) & 0x03ffffff);
+	pos = 24;
+
+	return true;
+	}
+
+int MappedTrace::NextPcap(Record* r)
+	{
+	if ( pos == size )
+		return 0;
+
+	size_t left = size - pos;
+
+	if ( left < 16 )
+		{
+		Fail(util::fmt("truncated dump file; tried to read 16 header bytes, only got %zu", left));
+		return -1;
+		}
+
+	const u_char* hdr = mapping + pos;
+	uint32_t caplen = Get32(hdr + 8);
+
+	if ( caplen > left - 16 )
+		{
+		Fail(util::fmt("truncated dump file; tried to read %u captured bytes, only got %zu",
+		               caplen, left - 16));
+		return -1;
+		}
+
+	uint32_t frac = Get32(hdr + 4);
+
+	r->link_type = link_type;
+	r->ts.tv_sec = Get32(hdr);
+	r->ts.tv_usec = nanoseconds ? frac / 1000 : frac;
+	r->caplen = caplen;
+	r->len = Get32(hdr + 12);
+	r->data = hdr + 16;
+
+	pos += 16 + caplen;
+
+	return 1;
+	}
+
+bool MappedTrace::ParsePcapngHeader()
+	{
+	pcapng = true;
+
+	// Find the link type of the first interface, so that it can serve
+	// as the one of the trace. The blocks get processed for real as
+	// the packets get read.
+	size_t p = 0;
+	bool in_first_section = true;
+
+	while ( p + 12 <= size )
+		{
+		const u_char* b = mapping + p;
+		uint32_t type;
+		memcpy(&type, b, sizeof(type));
+
+		if ( type == PCAPNG_SECTION_HEADER )
+			{
+			if ( p > 0 )
+				in_first_section = false;
+
+			uint32_t bom;
+			memcpy(&bom, b + 8, sizeof(bom));
+
+			if ( bom == PCAPNG_BYTE_ORDER_MAGIC )
+				swapped = false;
+			else if ( bom == bswap32(PCAPNG_BYTE_ORDER_MAGIC) )
+				swapped = true;
+			else
+				return Fail("pcapng section header has an unknown byte-order magic");
+			}
+
+		else
+			type = Get32(b);
+
+		uint32_t block_len = Get32(b + 4);
+
+		if ( block_len < 12 || block_len % 4 != 0 || block_len > size - p )
+			break;
+
+		if ( type == PCAPNG_INTERFACE && block_len >= 20 )
+			{
+			link_type = link_type_to_dlt(Get16(b + 8));
+			return true;
+			}
+
+		if ( type == PCAPNG_PACKET || type == PCAPNG_SIMPLE_PACKET ||
+		     type == PCAPNG_ENHANCED_PACKET || ! in_first_section )
+			break;
+
+		p += block_len;
+		}
+
+	return Fail("the capture file has no Interface Description Blocks");
+	}
+
+int MappedTrace::NextPcapng(Record* r)
+	{
+	while ( pos < size )
+		{
+		size_t left = size - pos;
+
+		if ( left < 12 )
+			{
+			Fail(util::fmt("truncated pcapng dump file; tried to read 12 bytes, only got %zu", left));
+			return -1;
+			}
+
+		const u_char* b = mapping + pos;
+		uint32_t type;
+		memcpy(&type, b, sizeof(type));
+
+		if ( type == PCAPNG_SECTION_HEADER )
+			{
+			// The section's byte order applies to its header's
+			// length already.
+			uint32_t bom;
+			memcpy(&bom, b + 8, sizeof(bom));
+
+			if ( bom == PCAPNG_BYTE_ORDER_MAGIC )
+				swapped = false;
+			else if ( bom == bswap32(PCAPNG_BYTE_ORDER_MAGIC) )
+				swapped = true;
+			else
+				{
+				Fail("pcapng section header has an unknown byte-order magic");
+				return -1;
+				}
+			}
+
+		else
+			type = Get32(b);
+
+		uint32_t block_len = Get32(b + 4);
+
+		if ( block_len < 12 || block_len % 4 != 0 )
+			{
+			Fail(util::fmt("block in pcapng dump file has a length of %u, which is invalid", block_len));
+			return -1;
+			}
+
+		if ( block_len > left )
+			{
+			Fail(util::fmt("truncated pcapng dump file; tried to read %u bytes, only got %zu",
+			               block_len, left));
+			return -1;
+			}
+
+		if ( Get32(b + block_len - 4) != block_len )
+			{
+			Fail("block in pcapng dump file has mismatched lengths");
+			return -1;
+			}
+
+		const u_char* body = b + 8;
+		size_t body_len = block_len - 12;
+
+		pos += block_len;
+
+		switch ( type ) {
+		case PCAPNG_SECTION_HEADER:
+			if ( ! ParseSectionHeader(body, body_len) )
+				return -1;
+
+			break;
+
+		case PCAPNG_INTERFACE:
+			if ( ! ParseInterface(body, body_len) )
+				return -1;
+
+			break;
+
+		case PCAPNG_ENHANCED_PACKET:
+		case PCAPNG_PACKET:
+			{
+			if ( body_len < 20 )
+				{
+				Fail("pcapng packet block is too short");
+				return -1;
+				}
+
+			uint32_t interface = type == PCAPNG_PACKET ? Get16(body) : Get32(body);
+			uint64_t ts = (uint64_t(Get32(body + 4)) << 32) | Get32(body + 8);
+			uint32_t caplen = Get32(body + 12);
+
+			if ( caplen > body_len - 20 )
+				{
+				Fail(util::fmt("pcapng packet block has a captured length of %u, "
+				               "larger than the block", caplen));
+				return -1;
+				}
+
+			if ( ! PcapngTimestamp(interface, ts, r) )
+				return -1;
+
+			r->caplen = caplen;
+			r->len = Get32(body + 16);
+			r->data = body + 20;
+			return 1;
+			}
+
+		case PCAPNG_SIMPLE_PACKET:
+			{
+			if ( body_len < 4 || interfaces.empty() )
+				{
+				Fail("pcapng simple packet block is too short or has no interface");
+				return -1;
+				}
+
+			// Simple packets don't have a captured length, nor a
+			// timestamp.
+			uint32_t len = Get32(body);
+			uint32_t caplen = std::min(len, static_cast<uint32_t>(body_len - 4));
+
+			if ( interfaces[0].snaplen )
+				caplen = std::min(caplen, interfaces[0].snaplen);
+
+			r->link_type = interfaces[0].link_type;
+			r->ts.tv_sec = 0;
+			r->ts.tv_usec = 0;
+			r->caplen = caplen;
+			r->len = len;
+			r->data = body + 4;
+			return 1;
+			}
+
+		default:
+			// Name resolution, statistics, and other blocks that
+			// don't matter here.
+			break;
+		}
+		}
+
+	return 0;
+	}
+
+bool MappedTrace::ParseSectionHeader(const u_char* body, size_t body_len)
+	{
+	if ( body_len < 16 )
+		return Fail("pcapng section header block is too short");
+
+	uint16_t major = Get16(body + 4);
+	uint16_t minor = Get16(body + 6);
+
+	if ( major != 1 )
+		return Fail(util::fmt("unsupported pcapng savefile version %u.%u", major, minor));
+
+	// Interfaces are numbered per section.
+	interfaces.clear();
+
+	return true;
+	}
+
+bool MappedTrace::ParseInterface(const u_char* body, size_t body_len)
+	{
+	if ( body_len < 8 )
+		return Fail("pcapng interface description block is too short");
+
+	Interface i;
+	i.link_type = link_type_to_dlt(Get16(body));
+	i.snaplen = Get32(body + 4);
+	i.ts_decimal = true;
+	i.ts_exponent = 6;
+	i.ts_offset = 0;
+
+	size_t p = 8;
+
+	while ( p + 4 <= body_len )
+		{
+		uint16_t code = Get16(body + p);
+		uint16_t len = Get16(body + p + 2);
+		p += 4;
+
+		if ( code == PCAPNG_OPT_END )
+			break;
+
+		if ( len > body_len - p )
+			return Fail("pcapng interface description block has malformed options");
+
+		const u_char* value = body + p;
+
+		if ( code == PCAPNG_OPT_IF_TSRESOL && len == 1 )
+			{
+			i.ts_decimal = ! (*value & 0x80);
+			i.ts_exponent = *value & 0x7f;
+
+			if ( i.ts_exponent > (i.ts_decimal ? 19 : 63) )
+				return Fail(util::fmt("pcapng interface has an unsupported timestamp "
+				                      "resolution of 0x%02x", *value));
+			}
+
+		else if ( code == PCAPNG_OPT_IF_TSOFFSET && len == 8 )
+			i.ts_offset = static_cast<int64_t>(Get64(value));
+
+		// Options are padded to 32 bits.
+		p += (len + 3) & ~3u;
+		}
+
+	interfaces.push_back(i);
+
+	return true;
+	}
+
+bool MappedTrace::PcapngTimestamp(uint32_t interface, uint64_t units, Record* r)
+	{
+	if ( interface >= interfaces.size() )
+		return Fail(util::fmt("a packet arrived on interface %u, but there's no "
+		                      "Interface Description Block for that interface", interface));
+
+	const auto& i = interfaces[interface];
+	uint64_t sec;
+	uint64_t usec;
+
+	if ( i.ts_decimal )
+		{
+		uint64_t per_sec = pow10(i.ts_exponent);
+		uint64_t frac = units % per_sec;
+
+		sec = units / per_sec;
+		usec = i.ts_exponent >= 6 ? frac / pow10(i.ts_exponent - 6) :
+		                            frac * pow10(6 - i.ts_exponent);
+		}
+	else
+		{
+		uint64_t frac = units & ((uint64_t(1) << i.ts_exponent) - 1);
+
+		sec = units >> i.ts_exponent;
+		usec = static_cast<uint64_t>(std::ldexp(static_cast<double>(frac), -i.ts_exponent) * 1e6);
+		}
+
+	r->link_type = i.link_type;
+	r->ts.tv_sec = sec + i.ts_offset;
+	r->ts.tv_usec = usec;
+
+	return true;
+	}
+
+void MappedTrace::Advise()
+	{
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	size_t start = pos & ~(page_size - 1);
+	size_t end = std::min(size, start + read_ahead);
+
+	if ( end > start )
+		madvise(const_cast<u_char*>(mapping + start), end - start, MADV_WILLNEED);
+
+	advised_until = end;
+
+	// Packets we're done with don't need to stay in memory.
+	if ( start > released_until + read_ahead )
+		{
+		madvise(const_cast<u_char*>(mapping + released_until),
+		        start - released_until, MADV_DONTNEED);
+		released_until = start;
+		}
+	}
+
+bool MappedTrace::Fail(std::string msg)
+	{
+	error = std::move(msg);
+	return false;
+	}
+
+uint16_t MappedTrace::Get16(const u_char* p) const
+	{
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? static_cast<uint16_t>((v << 8) | (v >> 8)) : v;
+	}
+
+uint32_t MappedTrace::Get32(const u_char* p) const
+	{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? bswap32(v) : v;
+	}
+
+uint64_t MappedTrace::Get64(const u_char* p) const
+	{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+
+	if ( swapped )
+		v = (uint64_t(bswap32(v & 0xffffffff)) << 32) | bswap32(v >> 32);
+
+	return v;
+	}
+
+} // namespace zeek::iosource::pcap::detail
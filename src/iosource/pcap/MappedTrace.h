@@ -0,0 +1,127 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h> // for u_char
+
+#include "iosource/Packet.h"
+
+namespace zeek::iosource::pcap::detail {
+
+/**
+ * A trace file in classic pcap or pcapng format, read through a memory
+ * mapping. Packets point right into the mapping instead of getting copied
+ * into a buffer first, and the kernel reads ahead of the current position
+ * as advised. Besides the formats libpcap reads, this covers pcapng files
+ * whose interfaces differ in link type.
+ */
+class MappedTrace {
+public:
+	/**
+	 * A packet in the trace.
+	 */
+	struct Record {
+		int link_type;	// as a DLT_* value
+		pkt_timeval ts;
+		uint32_t caplen;
+		uint32_t len;
+		const u_char* data;	// valid until the trace is closed
+	};
+
+	~MappedTrace();
+
+	/**
+	 * Opens and maps a trace file.
+	 *
+	 * @param path  The path of the file.
+	 *
+	 * @param error  Set to a description of the problem if the file looks
+	 * like a trace but can't be read. Left empty for files that aren't
+	 * regular files in one of the formats handled here, or that can't be
+	 * mapped, which libpcap may still be able to read.
+	 *
+	 * @return The trace, or null if it couldn't be opened.
+	 */
+	static std::unique_ptr<MappedTrace> Open(const std::string& path, std::string* error);
+
+	/**
+	 * Moves on to the next packet.
+	 *
+	 * @param r  Set to the packet.
+	 *
+	 * @return 1 if there was a packet, 0 at the end of the file, and -1
+	 * if the file is corrupt, with a description of the problem in
+	 * Error().
+	 */
+	int Next(Record* r);
+
+	/**
+	 * @return The link type of the trace, or of the first interface of a
+	 * pcapng file.
+	 */
+	int LinkType() const	{ return link_type; }
+
+	/**
+	 * @return The file descriptor of the trace.
+	 */
+	int Fd() const	{ return fd; }
+
+	/**
+	 * @return A description of the last error.
+	 */
+	const std::string& Error() const	{ return error; }
+
+private:
+	// A pcapng interface.
+	struct Interface {
+		int link_type;
+		uint32_t snaplen;
+		bool ts_decimal;	// resolution is a power of 10, not of 2
+		uint8_t ts_exponent;
+		int64_t ts_offset;	// seconds to add
+	};
+
+	MappedTrace() = default;
+
+	bool ParsePcapHeader();
+	bool ParsePcapngHeader();
+
+	int NextPcap(Record* r);
+	int NextPcapng(Record* r);
+
+	bool ParseSectionHeader(const u_char* body, size_t body_len);
+	bool ParseInterface(const u_char* body, size_t body_len);
+	bool PcapngTimestamp(uint32_t interface, uint64_t units, Record* r);
+
+	void Advise();
+	bool Fail(std::string msg);
+
+	uint16_t Get16(const u_char* p) const;
+	uint32_t Get32(const u_char* p) const;
+	uint64_t Get64(const u_char* p) const;
+
+	int fd = -1;
+	const u_char* mapping = nullptr;
+	size_t size = 0;
+	size_t pos = 0;	// offset of the next record or block
+	bool swapped = false;	// file's byte order differs from ours
+
+	bool pcapng = false;
+	bool nanoseconds = false;	// classic pcap timestamp resolution
+	int link_type = -1;
+	std::vector<Interface> interfaces;	// of the current pcapng section
+
+	// Offset up to which the kernel was asked to read ahead, and up to
+	// which it was told the pages are no longer needed.
+	size_t advised_until = 0;
+	size_t released_until = 0;
+
+	std::string error;
+};
+
+} // namespace zeek::iosource::pcap::detail
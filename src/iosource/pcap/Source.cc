@@ -38,11 +38,17 @@ void PcapSource::Open()
 
 void PcapSource::Close()
 	{
-	if ( ! pd )
+	if ( ! pd && ! trace )
 		return;
 
-	pcap_close(pd);
-	pd = nullptr;
+	if ( pd )
+		{
+		pcap_close(pd);
+		pd = nullptr;
+		}
+
+	trace.reset();
+	link_type_filters.clear();
 
 	Closed();
 
@@ -170,6 +176,30 @@ void PcapSource::OpenLive()
 
 void PcapSource::OpenOffline()
 	{
+	if ( BifConst::Pcap::mmap_traces && props.path != "-" )
+		{
+		std::string err;
+		trace = detail::MappedTrace::Open(props.path, &err);
+
+		if ( trace )
+			{
+			props.selectable_fd = trace->Fd();
+			props.link_type = trace->LinkType();
+			props.is_live = false;
+
+			Opened(props);
+			return;
+			}
+
+		if ( ! err.empty() )
+			{
+			Error(err);
+			return;
+			}
+
+		// Not something we read ourselves, leave it to libpcap.
+		}
+
 	char errbuf[PCAP_ERRBUF_SIZE];
 
 	pd = pcap_open_offline(props.path.c_str(), errbuf);
@@ -193,6 +223,9 @@ void PcapSource::OpenOffline()
 
 bool PcapSource::ExtractNextPacket(Packet* pkt)
 	{
+	if ( trace )
+		return ExtractNextTracePacket(pkt);
+
 	if ( ! pd )
 		return false;
 
@@ -241,6 +274,98 @@ bool PcapSource::ExtractNextPacket(Packet* pkt)
 	return true;
 	}
 
+bool PcapSource::ExtractNextTracePacket(Packet* pkt)
+	{
+	detail::MappedTrace::Record r;
+
+	while ( true )
+		{
+		int res = trace->Next(&r);
+
+		if ( res == 0 )
+			{
+			// Exhausted trace file, no more packets to read.
+			Close();
+			return false;
+			}
+
+		if ( res < 0 )
+			{
+			reporter->FatalError("failed to read a packet from %s: %s",
+			                     props.path.data(), trace->Error().c_str());
+			return false;
+			}
+
+		// Unlike with libpcap, there's no kernel-side filter to rely
+		// on, so filter here.
+		if ( MatchesFilter(r) )
+			break;
+
+		if ( ! trace )
+			// Filtering failed and closed the source.
+			return false;
+		}
+
+	pkt->Init(r.link_type, &r.ts, r.caplen, r.len, r.data);
+
+	if ( r.len == 0 || r.caplen == 0 )
+		{
+		Weird("empty_pcap_header", pkt);
+		return false;
+		}
+
+	++stats.received;
+	stats.bytes_received += r.len;
+
+	return true;
+	}
+
+bool PcapSource::MatchesFilter(const detail::MappedTrace::Record& r)
+	{
+	if ( current_filter < 0 || r.link_type == DLT_NFLOG )
+		return true;
+
+	pcap_pkthdr hdr;
+	hdr.ts.tv_sec = r.ts.tv_sec;
+	hdr.ts.tv_usec = r.ts.tv_usec;
+	hdr.caplen = r.caplen;
+	hdr.len = r.len;
+
+	if ( r.link_type == props.link_type )
+		return ApplyBPFFilter(current_filter, &hdr, r.data);
+
+	// A pcapng interface with a link type other than the one the
+	// filters were compiled for. Compile the filter for it, once.
+	auto& code = link_type_filters[r.link_type];
+
+	if ( ! code )
+		{
+		char errbuf[PCAP_ERRBUF_SIZE];
+		const auto& filter = filter_strings[current_filter];
+
+		code = std::make_unique<iosource::detail::BPF_Program>();
+
+		if ( ! code->Compile(BifConst::Pcap::snaplen, r.link_type, filter.c_str(),
+		                     Netmask(), errbuf, sizeof(errbuf)) )
+			{
+			std::string msg = util::fmt("cannot compile BPF filter \"%s\" for link type %d",
+			                            filter.c_str(), r.link_type);
+
+			if ( *errbuf )
+				msg += ": " + std::string(errbuf);
+
+			Error(msg);
+			Close();
+			return false;
+			}
+		}
+
+	if ( code->MatchesAnything() )
+		return true;
+
+	return pcap_offline_filter(code->GetProgram(), &hdr, r.data);
+	}
+
 void PcapSource::DoneWithPacket()
 	{
 	// Nothing to do.
@@ -248,12 +373,19 @@ void PcapSource::DoneWithPacket()
 
 bool PcapSource::PrecompileFilter(int index, const std::string& filter)
 	{
-	return PktSrc::PrecompileBPFFilter(index, filter);
+	if ( ! PktSrc::PrecompileBPFFilter(index, filter) )
+		return false;
+
+	if ( index >= static_cast<int>(filter_strings.size()) )
+		filter_strings.resize(index + 1);
+
+	filter_strings[index] = filter;
+	return true;
 	}
 
 bool PcapSource::SetFilter(int index)
 	{
-	if ( ! pd )
+	if ( ! pd && ! trace )
 		return true; // Prevent error message
 
 	char errbuf[PCAP_ERRBUF_SIZE];
@@ -269,7 +401,14 @@ bool PcapSource::SetFilter(int index)
 		return false;
 		}
 
-	if ( LinkType() == DLT_NFLOG )
+	if ( trace )
+		{
+		// Applied while reading packets.
+		current_filter = index;
+		link_type_filters.clear();
+		}
+
+	else if ( LinkType() == DLT_NFLOG )
 		{
 		// No-op, NFLOG does not support BPF filters.
 		// Raising a warning might be good, but it would also be noisy
@@ -2,7 +2,12 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+
 #include "../PktSrc.h"
+#include "../BPF_Program.h"
+#include "MappedTrace.h"
 
 extern "C" {
 #include <pcap.h>
@@ -32,12 +37,22 @@ protected:
 private:
 	void OpenLive();
 	void OpenOffline();
+	bool ExtractNextTracePacket(Packet* pkt);
+	bool MatchesFilter(const detail::MappedTrace::Record& r);
 	void PcapError(const char* where = nullptr);
 
 	Properties props;
 	Stats stats;
 
 	pcap_t *pd;
+
+	// Trace files that don't go through libpcap, along with the filter
+	// strings for compiling filters for pcapng interfaces whose link
+	// type differs from the trace's.
+	std::unique_ptr<detail::MappedTrace> trace;
+	std::vector<std::string> filter_strings;
+	int current_filter = -1;
+	std::map<int, std::unique_ptr<iosource::detail::BPF_Program>> link_type_filters;
 };
 
 } // namespace zeek::iosource::pcap
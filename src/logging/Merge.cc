@@ -0,0 +1,563 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Merge.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+
+#include "Reporter.h"
+#include "util.h"
+
+namespace zeek::logging::detail {
+
+namespace {
+
+// Entries are sorted in runs of about this many bytes, which are then
+// merged from temporary files, so that merging needs about this much
+// memory regardless of the size of the logs.
+constexpr size_t RUN_SIZE = 64 * 1024 * 1024;
+
+// The most runs merged at once. Having more takes intermediate passes.
+constexpr size_t MAX_MERGE_FILES = 128;
+
+struct Entry {
+	double ts;
+	std::string line;
+};
+
+using EntryCallback = std::function<bool (Entry&& e)>;
+
+bool starts_with(const std::string& s, const char* prefix)
+	{
+	return s.compare(0, strlen(prefix), prefix) == 0;
+	}
+
+bool ends_with(const std::string& s, const char* suffix)
+	{
+	size_t n = strlen(suffix);
+	return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+	}
+
+// Orders entries without timestamps first. Otherwise, this is strict, so
+// that entries with equal timestamps keep their order.
+bool before(double a, double b)
+	{
+	if ( std::isnan(a) )
+		return ! std::isnan(b);
+
+	return ! std::isnan(b) && a < b;
+	}
+
+// Decodes the separator from a "#separator \x09" header line.
+std::string parse_separator(const std::string& line)
+	{
+	std::string rval;
+	auto s = line.substr(strlen("#separator "));
+
+	for ( size_t i = 0; i < s.size(); ++i )
+		{
+		if ( s[i] == '\\' && i + 3 < s.size() && s[i + 1] == 'x' )
+			{
+			rval.push_back(static_cast<char>(strtol(s.substr(i + 2, 2).c_str(), nullptr, 16)));
+			i += 3;
+			}
+		else
+			rval.push_back(s[i]);
+		}
+
+	return rval;
+	}
+
+// Extracts the value of the given TSV column. An unset one yields NaN.
+bool tsv_ts(const std::string& line, const std::string& sep, int column, double* ts)
+	{
+	size_t start = 0;
+
+	for ( int i = 0; i < column; ++i )
+		{
+		start = line.find(sep, start);
+
+		if ( start == std::string::npos )
+			return false;
+
+		start += sep.size();
+		}
+
+	if ( line.compare(start, 1 + sep.size(), "-" + sep) == 0 ||
+	     line.compare(start, std::string::npos, "-") == 0 )
+		{
+		*ts = NAN;
+		return true;
+		}
+
+	char* end;
+	*ts = strtod(line.c_str() + start, &end);
+	return end != line.c_str() + start;
+	}
+
+// Extracts a JSON entry's "ts" field, in any of the formats that
+// LogAscii::json_timestamps selects. Entries without one yield NaN.
+bool json_ts(const std::string& line, double* ts)
+	{
+	auto pos = line.find("\"ts\":");
+
+	if ( pos == std::string::npos )
+		{
+		*ts = NAN;
+		return true;
+		}
+
+	const char* start = line.c_str() + pos + strlen("\"ts\":");
+
+	if ( *start == '"' )
+		{
+		// JSON::TS_ISO8601, like "2020-03-01T12:00:00.123456Z".
+		struct tm t;
+		memset(&t, 0, sizeof(t));
+		const char* rest = strptime(start + 1, "%Y-%m-%dT%H:%M:%S", &t);
+
+		if ( ! rest )
+			return false;
+
+		double frac = 0;
+
+		if ( *rest == '.' )
+			{
+			char* end;
+			frac = strtod(rest, &end);
+			rest = end;
+			}
+
+		if ( rest[0] != 'Z' || rest[1] != '"' )
+			return false;
+
+		*ts = timegm(&t) + frac;
+		return true;
+		}
+
+	// JSON::TS_EPOCH, or JSON::TS_MILLIS. These don't mix within a log,
+	// so their order is the same.
+	char* end;
+	*ts = strtod(start, &end);
+	return end != start;
+	}
+
+// Reads a log's entries and passes them to a callback one by one. Header
+// lines go to *header* if that's given, and the greatest "#close" line
+// to *close*.
+bool read_log(const std::string& path, std::vector<std::string>* header,
+              std::string* close, const EntryCallback& cb)
+	{
+	FILE* f = fopen(path.c_str(), "r");
+
+	if ( ! f )
+		{
+		reporter->Error("cannot open log %s: %s", path.c_str(), strerror(errno));
+		return false;
+		}
+
+	std::string sep = "\t";
+	int ts_column = -1;
+	char* buf = nullptr;
+	size_t buf_size = 0;
+	ssize_t n;
+	bool ok = true;
+
+	while ( ok && (n = getline(&buf, &buf_size, f)) > 0 )
+		{
+		std::string line(buf, n);
+
+		if ( line.back() == '\n' )
+			line.pop_back();
+
+		if ( line.empty() )
+			continue;
+
+		if ( line[0] == '#' )
+			{
+			if ( starts_with(line, "#separator ") )
+				sep = parse_separator(line);
+
+			else if ( starts_with(line, "#fields") )
+				{
+				std::vector<std::string> fields;
+				util::tokenize_string(line, sep, &fields);
+
+				// The first one is "#fields" itself.
+				auto it = std::find(fields.begin(), fields.end(), "ts");
+
+				if ( it != fields.end() )
+					ts_column = it - fields.begin() - 1;
+				}
+
+			if ( starts_with(line, "#close") )
+				*close = std::max(*close, line);
+
+			else if ( header )
+				header->push_back(std::move(line));
+
+			continue;
+			}
+
+		// Only the header in front of the first entry counts.
+		header = nullptr;
+
+		double ts = NAN;
+		bool have_ts = true;
+
+		if ( line[0] == '{' )
+			have_ts = json_ts(line, &ts);
+		else if ( ts_column >= 0 )
+			have_ts = tsv_ts(line, sep, ts_column, &ts);
+
+		if ( ! have_ts )
+			{
+			reporter->Error("cannot parse the timestamp of an entry in %s", path.c_str());
+			ok = false;
+			break;
+			}
+
+		ok = cb({ts, std::move(line)});
+		}
+
+	free(buf);
+	fclose(f);
+	return ok;
+	}
+
+// A file of sorted entries, each on a line prefixed with its timestamp.
+struct Run {
+	FILE* file = nullptr;
+	char* buf = nullptr;
+	size_t buf_size = 0;
+	Entry next;
+
+	~Run()
+		{
+		free(buf);
+
+		if ( file )
+			fclose(file);
+		}
+
+	// Reads the next entry, returning false at the end.
+	bool Advance()
+		{
+		ssize_t n = getline(&buf, &buf_size, file);
+
+		if ( n <= 0 )
+			return false;
+
+		char* line;
+		next.ts = strtod(buf, &line);
+		next.line.assign(line + 1, buf + n - (line + 1));
+
+		if ( ! next.line.empty() && next.line.back() == '\n' )
+			next.line.pop_back();
+
+		return true;
+		}
+	};
+
+void write_entry(FILE* f, const Entry& e, bool with_ts)
+	{
+	if ( with_ts )
+		fprintf(f, "%.17g\t%s\n", e.ts, e.line.c_str());
+	else
+		fprintf(f, "%s\n", e.line.c_str());
+	}
+
+// Merges sorted runs into *out*. Of entries with equal timestamps, the
+// ones of earlier runs come first.
+bool merge_runs(const std::vector<std::string>& paths, FILE* out, bool with_ts)
+	{
+	std::vector<std::unique_ptr<Run>> runs;
+
+	for ( const auto& path : paths )
+		{
+		auto run = std::make_unique<Run>();
+		run->file = fopen(path.c_str(), "r");
+
+		if ( ! run->file )
+			{
+			reporter->Error("cannot open %s: %s", path.c_str(), strerror(errno));
+			return false;
+			}
+
+		if ( run->Advance() )
+			runs.push_back(std::move(run));
+		}
+
+	auto cmp = [&runs](size_t a, size_t b)
+		{
+		// The priority queue puts the greatest first.
+		const auto& ea = runs[a]->next;
+		const auto& eb = runs[b]->next;
+
+		if ( before(eb.ts, ea.ts) )
+			return true;
+
+		return ! before(ea.ts, eb.ts) && a > b;
+		};
+
+	std::priority_queue<size_t, std::vector<size_t>, decltype(cmp)> queue(cmp);
+
+	for ( size_t i = 0; i < runs.size(); ++i )
+		queue.push(i);
+
+	while ( ! queue.empty() )
+		{
+		auto i = queue.top();
+		queue.pop();
+
+		write_entry(out, runs[i]->next, with_ts);
+
+		if ( runs[i]->Advance() )
+			queue.push(i);
+		}
+
+	return ! ferror(out);
+	}
+
+// Merges the logs of the same name from several directories.
+class LogMerger {
+public:
+	LogMerger(std::string arg_dest) : dest(std::move(arg_dest))	{ }
+
+	~LogMerger()
+		{
+		for ( const auto& path : temp_files )
+			unlink(path.c_str());
+		}
+
+	bool Merge(const std::vector<std::string>& paths);
+
+private:
+	bool CreateTemp(std::string* path, FILE** f);
+	bool FinishTemp(const std::string& path, FILE* f);
+	bool WriteRun();
+	bool WriteLog();
+
+	std::string dest;
+	std::vector<std::string> header;
+	std::string close_line;
+
+	std::vector<Entry> entries;
+	size_t entries_size = 0;
+
+	std::vector<std::string> runs;
+	std::vector<std::string> temp_files;
+};
+
+bool LogMerger::CreateTemp(std::string* path, FILE** f)
+	{
+	std::string tmpl = dest + ".XXXXXX";
+	int fd = mkstemp(&tmpl[0]);
+
+	if ( fd < 0 || ! (*f = fdopen(fd, "w")) )
+		{
+		reporter->Error("cannot create a temporary file for %s: %s",
+		                dest.c_str(), strerror(errno));
+
+		if ( fd >= 0 )
+			{
+			::close(fd);
+			unlink(tmpl.c_str());
+			}
+
+		return false;
+		}
+
+	temp_files.push_back(tmpl);
+	*path = std::move(tmpl);
+	return true;
+	}
+
+bool LogMerger::FinishTemp(const std::string& path, FILE* f)
+	{
+	bool ok = ! ferror(f);
+
+	if ( fclose(f) != 0 )
+		ok = false;
+
+	if ( ! ok )
+		reporter->Error("cannot write %s: %s", path.c_str(), strerror(errno));
+
+	return ok;
+	}
+
+bool LogMerger::WriteRun()
+	{
+	std::stable_sort(entries.begin(), entries.end(),
+	                 [](const Entry& a, const Entry& b) { return before(a.ts, b.ts); });
+
+	std::string path;
+	FILE* f;
+
+	if ( ! CreateTemp(&path, &f) )
+		return false;
+
+	for ( const auto& e : entries )
+		write_entry(f, e, true);
+
+	entries.clear();
+	entries_size = 0;
+	runs.push_back(path);
+	return FinishTemp(path, f);
+	}
+
+bool LogMerger::WriteLog()
+	{
+	std::string path;
+	FILE* f;
+
+	if ( ! CreateTemp(&path, &f) )
+		return false;
+
+	for ( const auto& h : header )
+		fprintf(f, "%s\n", h.c_str());
+
+	bool ok = true;
+
+	if ( runs.empty() )
+		{
+		std::stable_sort(entries.begin(), entries.end(),
+		                 [](const Entry& a, const Entry& b) { return before(a.ts, b.ts); });
+
+		for ( const auto& e : entries )
+			write_entry(f, e, false);
+		}
+	else
+		ok = merge_runs(runs, f, false);
+
+	if ( ! close_line.empty() )
+		fprintf(f, "%s\n", close_line.c_str());
+
+	if ( ! FinishTemp(path, f) || ! ok )
+		return false;
+
+	if ( rename(path.c_str(), dest.c_str()) != 0 )
+		{
+		reporter->Error("cannot write log %s: %s", dest.c_str(), strerror(errno));
+		return false;
+		}
+
+	return true;
+	}
+
+bool LogMerger::Merge(const std::vector<std::string>& paths)
+	{
+	auto add = [this](Entry&& e)
+		{
+		entries_size += e.line.size() + sizeof(e);
+		entries.push_back(std::move(e));
+		return entries_size < RUN_SIZE || WriteRun();
+		};
+
+	for ( const auto& path : paths )
+		if ( ! read_log(path, header.empty() ? &header : nullptr, &close_line, add) )
+			return false;
+
+	if ( runs.empty() )
+		return WriteLog();
+
+	if ( ! entries.empty() && ! WriteRun() )
+		return false;
+
+	// Merge runs in groups until few enough remain, keeping them in order
+	// so that entries with equal timestamps keep theirs.
+	while ( runs.size() > MAX_MERGE_FILES )
+		{
+		std::vector<std::string> merged;
+
+		for ( size_t i = 0; i < runs.size(); i += MAX_MERGE_FILES )
+			{
+			auto last = std::min(runs.size(), i + MAX_MERGE_FILES);
+			std::vector<std::string> group(runs.begin() + i, runs.begin() + last);
+			std::string path;
+			FILE* f;
+
+			if ( ! CreateTemp(&path, &f) )
+				return false;
+
+			bool ok = merge_runs(group, f, true);
+
+			if ( ! FinishTemp(path, f) || ! ok )
+				return false;
+
+			for ( const auto& g : group )
+				unlink(g.c_str());
+
+			merged.push_back(std::move(path));
+			}
+
+		runs = std::move(merged);
+		}
+
+	return WriteLog();
+	}
+
+} // namespace
+
+int merge_logs(const std::vector<std::string>& src_dirs, const std::string& dest_dir)
+	{
+	// The files of each log, ordered by name for a deterministic order
+	// of writing them.
+	std::map<std::string, std::vector<std::string>> logs;
+
+	for ( const auto& dir : src_dirs )
+		{
+		DIR* d = opendir(dir.c_str());
+
+		if ( ! d )
+			{
+			reporter->Error("cannot open log directory %s: %s", dir.c_str(), strerror(errno));
+			return -1;
+			}
+
+		std::vector<std::string> names;
+
+		while ( auto de = readdir(d) )
+			{
+			std::string name = de->d_name;
+
+			if ( ends_with(name, ".log") )
+				names.push_back(std::move(name));
+			}
+
+		closedir(d);
+
+		// readdir() has no particular order.
+		std::sort(names.begin(), names.end());
+
+		for ( auto& name : names )
+			logs[name].push_back(dir + "/" + name);
+		}
+
+	int rval = 0;
+
+	for ( const auto& [name, paths] : logs )
+		{
+		LogMerger merger(dest_dir + "/" + name);
+
+		if ( ! merger.Merge(paths) )
+			return -1;
+
+		++rval;
+		}
+
+	return rval;
+	}
+
+} // namespace zeek::logging::detail
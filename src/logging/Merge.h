@@ -0,0 +1,33 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Merging of the logs that several processes wrote for the same input.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace zeek::logging::detail {
+
+/**
+ * Merges the ``.log`` files of several directories into another one, with
+ * the entries of each sorted by their ``ts`` field. This handles the
+ * ASCII writer's TSV and JSON formats, with any LogAscii::json_timestamps
+ * setting. Entries with equal or without timestamps keep their order,
+ * with those of earlier source directories first.
+ *
+ * Large logs are sorted in runs that go to temporary files next to the
+ * destination, which are then merged, so that memory use is bounded.
+ * An entry whose timestamp can't be parsed is an error.
+ *
+ * @param src_dirs  The directories to merge.
+ *
+ * @param dest_dir  The directory to write the merged logs to. Existing
+ * logs of the same names are replaced.
+ *
+ * @return The number of logs written, or -1 if there was an error, which
+ * has been reported.
+ */
+int merge_logs(const std::vector<std::string>& src_dirs, const std::string& dest_dir);
+
+} // namespace zeek::logging::detail
@@ -2,10 +2,13 @@
 
 #include "zeek-config.h"
 
+#include <algorithm>
 #include <string>
 #include <errno.h>
+#include <ctype.h>
 #include <vector>
 
+#include "util.h"
 #include "threading/SerialTypes.h"
 
 #include "SQLite.h"
@@ -19,7 +22,8 @@ namespace zeek::logging::writer::detail {
 
 SQLite::SQLite(WriterFrontend* frontend)
 	: WriterBackend(frontend),
-	  fields(), num_fields(), db(), st()
+	  fields(), num_fields(), db(), st(), in_transaction(false),
+	  transaction_pending(0), transaction_start(0)
 	{
 	set_separator.assign(
 			(const char*) BifConst::LogSQLite::set_separator->Bytes(),
@@ -36,6 +40,19 @@ SQLite::SQLite(WriterFrontend* frontend)
 			BifConst::LogSQLite::empty_field->Len()
 			);
 
+	transaction_rows = BifConst::LogSQLite::transaction_rows;
+	transaction_interval = BifConst::LogSQLite::transaction_interval;
+
+	journal_mode.assign(
+			(const char*) BifConst::LogSQLite::journal_mode->Bytes(),
+			BifConst::LogSQLite::journal_mode->Len()
+			);
+
+	synchronous.assign(
+			(const char*) BifConst::LogSQLite::synchronous->Bytes(),
+			BifConst::LogSQLite::synchronous->Len()
+			);
+
 	threading::formatter::Ascii::SeparatorInfo sep_info(string(), set_separator, unset_field, empty_field);
 	io = new threading::formatter::Ascii(this, sep_info);
 	}
@@ -44,6 +61,9 @@ SQLite::~SQLite()
 	{
 	if ( db != 0 )
 		{
+		if ( in_transaction )
+			CommitTransaction();
+
 		sqlite3_finalize(st);
 		if ( ! sqlite3_close(db) )
 			Error("Sqlite could not close connection");
@@ -111,6 +131,56 @@ bool SQLite::checkError(int code)
 	return false;
 	}
 
+bool SQLite::Exec(const string& sql)
+	{
+	char *errorMsg = 0;
+
+	if ( sqlite3_exec(db, sql.c_str(), NULL, NULL, &errorMsg) != SQLITE_OK )
+		{
+		Error(Fmt("Error executing '%s': %s", sql.c_str(), errorMsg));
+		sqlite3_free(errorMsg);
+		return false;
+		}
+
+	return true;
+	}
+
+bool SQLite::SetPragma(const char* name, const string& value)
+	{
+	if ( value.empty() )
+		return true;
+
+	// The value ends up in the statement verbatim, so only allow the
+	// keywords and numbers these pragmas take.
+	if ( ! std::all_of(value.begin(), value.end(), [](char c) { return isalnum(c); }) )
+		{
+		Error(Fmt("invalid value for %s: %s", name, value.c_str()));
+		return false;
+		}
+
+	return Exec(Fmt("PRAGMA %s = %s;", name, value.c_str()));
+	}
+
+bool SQLite::BeginTransaction()
+	{
+	if ( ! Exec("BEGIN TRANSACTION;") )
+		return false;
+
+	in_transaction = true;
+	transaction_pending = 0;
+	transaction_start = util::current_time();
+	return true;
+	}
+
+bool SQLite::CommitTransaction()
+	{
+	if ( ! in_transaction )
+		return true;
+
+	in_transaction = false;
+	return Exec("COMMIT TRANSACTION;");
+	}
+
 bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
                     const Field* const * arg_fields)
 	{
@@ -140,6 +210,22 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 	else
 		tablename = it->second;
 
+	it = info.config.find("transaction_rows");
+	if ( it != info.config.end() )
+		transaction_rows = strtoull(it->second, nullptr, 10);
+
+	it = info.config.find("transaction_interval");
+	if ( it != info.config.end() )
+		transaction_interval = strtod(it->second, nullptr);
+
+	it = info.config.find("journal_mode");
+	if ( it != info.config.end() )
+		journal_mode = it->second;
+
+	it = info.config.find("synchronous");
+	if ( it != info.config.end() )
+		synchronous = it->second;
+
 	if ( checkError(sqlite3_open_v2(
 					fullpath.c_str(),
 					&db,
@@ -150,6 +236,10 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 					NULL)) )
 		return false;
 
+	if ( ! SetPragma("journal_mode", journal_mode) ||
+	     ! SetPragma("synchronous", synchronous) )
+		return false;
+
 	string create = "CREATE TABLE IF NOT EXISTS " + tablename + " (\n";
 		//"id SERIAL UNIQUE NOT NULL"; // SQLite has rowids, we do not need a counter here.
 
@@ -334,6 +424,9 @@ int SQLite::AddParams(Value* val, int pos)
 
 bool SQLite::DoWrite(int num_fields, const Field* const * fields, Value** vals)
 	{
+	if ( transaction_rows > 1 && ! in_transaction && ! BeginTransaction() )
+		return false;
+
 	// bind parameters
 	for ( int i = 0; i < num_fields; i++ )
 		{
@@ -352,11 +445,43 @@ bool SQLite::DoWrite(int num_fields, const Field* const * fields, Value** vals)
 	if ( checkError(sqlite3_reset(st)) )
 		return false;
 
+	if ( in_transaction )
+		{
+		++transaction_pending;
+
+		if ( transaction_pending >= transaction_rows ||
+		     (transaction_interval > 0 &&
+		      util::current_time() - transaction_start >= transaction_interval) )
+			return CommitTransaction();
+		}
+
+	return true;
+	}
+
+bool SQLite::DoFlush(double network_time)
+	{
+	return CommitTransaction();
+	}
+
+bool SQLite::DoFinish(double network_time)
+	{
+	return CommitTransaction();
+	}
+
+bool SQLite::DoHeartbeat(double network_time, double current_time)
+	{
+	if ( in_transaction && transaction_interval > 0 &&
+	     current_time - transaction_start >= transaction_interval )
+		return CommitTransaction();
+
 	return true;
 	}
 
 bool SQLite::DoRotate(const char* rotated_path, double open, double close, bool terminating)
 	{
+	if ( ! CommitTransaction() )
+		return false;
+
 	if ( ! FinishedRotation("/dev/null", Info().path, open, close, terminating))
 		{
 		Error(Fmt("error rotating %s", Info().path));
@@ -29,12 +29,16 @@ protected:
 	bool DoSetBuf(bool enabled) override { return true; }
 	bool DoRotate(const char* rotated_path, double open,
 			      double close, bool terminating) override;
-	bool DoFlush(double network_time) override { return true; }
-	bool DoFinish(double network_time) override { return true; }
-	bool DoHeartbeat(double network_time, double current_time) override { return true; }
+	bool DoFlush(double network_time) override;
+	bool DoFinish(double network_time) override;
+	bool DoHeartbeat(double network_time, double current_time) override;
 
 private:
 	bool checkError(int code);
+	bool Exec(const std::string& sql);
+	bool SetPragma(const char* name, const std::string& value);
+	bool BeginTransaction();
+	bool CommitTransaction();
 
 	int AddParams(threading::Value* val, int pos);
 	std::string GetTableType(int, int);
@@ -49,6 +53,16 @@ private:
 	std::string unset_field;
 	std::string empty_field;
 
+	// Rows per transaction; one or less disables batching.
+	uint64_t transaction_rows;
+	double transaction_interval;
+	std::string journal_mode;
+	std::string synchronous;
+
+	bool in_transaction;
+	uint64_t transaction_pending;
+	double transaction_start;
+
 	threading::formatter::Ascii* io;
 };
 
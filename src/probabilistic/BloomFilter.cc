@@ -2,7 +2,10 @@
 
 #include "BloomFilter.h"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstring>
 #include <limits>
 
 #include <broker/data.hh>
@@ -12,6 +15,9 @@
 
 #include "../util.h"
 #include "../Reporter.h"
+#include "../digest.h"
+
+#include "3rdparty/doctest.h"
 
 namespace zeek::probabilistic {
 
@@ -70,12 +76,21 @@ std::unique_ptr<BloomFilter> BloomFilter::Unserialize(const broker::data& data)
 	case Counting:
 		bf = std::unique_ptr<BloomFilter>(new CountingBloomFilter());
 		break;
+
+	case Blocked:
+		bf = std::unique_ptr<BloomFilter>(new BlockedBloomFilter());
+		break;
+
+	default:
+		return nullptr;
 	}
 
+	// Set the hasher first, filters may derive their hash functions from it.
+	bf->hasher = hasher_.release();
+
 	if ( ! bf->DoUnserialize((*v)[2]) )
 		return nullptr;
 
-	bf->hasher = hasher_.release();
 	return bf;
 	}
 
@@ -193,6 +208,218 @@ bool BasicBloomFilter::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
+// Odd multipliers that spread the lower half of the digest over the bits
+// of a word; see Putze et al., "Cache-, Hash- and Space-Efficient Bloom
+// Filters". The first eight are the ones Impala's split-block filter uses.
+static constexpr uint32_t BLOCK_SALTS[BlockedBloomFilter::MAX_K] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+	0x9e3779b1U, 0x85ebca6bU, 0xc2b2ae35U, 0x27d4eb2fU,
+	0x165667b1U, 0xd3a2646dU, 0xfd7046c5U, 0xb55a4f09U,
+};
+
+BlockedBloomFilter::BlockedBloomFilter()
+	{
+	}
+
+BlockedBloomFilter::BlockedBloomFilter(const detail::Hasher* hasher, size_t cells)
+	: BloomFilter(hasher), hash(hasher->Seed())
+	{
+	assert(hasher->K() > 0 && hasher->K() <= MAX_K);
+
+	size_t bits_per_block = BLOCK_WORDS * 64;
+	size_t n = std::max(size_t(1), (cells + bits_per_block - 1) / bits_per_block);
+	blocks.resize(n, Block{});
+	}
+
+BlockedBloomFilter::~BlockedBloomFilter()
+	{
+	}
+
+bool BlockedBloomFilter::Empty() const
+	{
+	for ( const auto& b : blocks )
+		for ( auto w : b.words )
+			if ( w )
+				return false;
+
+	return true;
+	}
+
+void BlockedBloomFilter::Clear()
+	{
+	std::fill(blocks.begin(), blocks.end(), Block{});
+	}
+
+bool BlockedBloomFilter::Merge(const BloomFilter* other)
+	{
+	if ( typeid(*this) != typeid(*other) )
+		return false;
+
+	const BlockedBloomFilter* o = static_cast<const BlockedBloomFilter*>(other);
+
+	if ( ! hasher->Equals(o->hasher) )
+		{
+		reporter->Error("incompatible hashers in BlockedBloomFilter merge");
+		return false;
+		}
+
+	else if ( blocks.size() != o->blocks.size() )
+		{
+		reporter->Error("different number of blocks in BlockedBloomFilter merge");
+		return false;
+		}
+
+	for ( size_t i = 0; i < blocks.size(); ++i )
+		for ( size_t j = 0; j < BLOCK_WORDS; ++j )
+			blocks[i].words[j] |= o->blocks[i].words[j];
+
+	return true;
+	}
+
+BlockedBloomFilter* BlockedBloomFilter::Clone() const
+	{
+	BlockedBloomFilter* copy = new BlockedBloomFilter();
+
+	copy->hasher = hasher->Clone();
+	copy->hash = hash;
+	copy->blocks = blocks;
+
+	return copy;
+	}
+
+std::string BlockedBloomFilter::InternalState() const
+	{
+	u_char buf[SHA256_DIGEST_LENGTH];
+	uint64_t digest;
+	EVP_MD_CTX* ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
+
+	for ( const auto& b : blocks )
+		zeek::detail::hash_update(ctx, b.words, sizeof(b.words));
+
+	zeek::detail::hash_final(ctx, buf);
+	memcpy(&digest, buf, sizeof(digest)); // Use the first bytes as digest
+	return util::fmt("%" PRIu64, digest);
+	}
+
+void BlockedBloomFilter::Add(const zeek::detail::HashKey* key)
+	{
+	uint64_t digest = hash(key->Key(), key->Size());
+	Block& b = blocks[BlockIndex(digest)];
+	uint32_t lower = static_cast<uint32_t>(digest);
+
+	for ( size_t i = 0; i < hasher->K(); ++i )
+		b.words[i % BLOCK_WORDS] |= uint64_t(1) << ((lower * BLOCK_SALTS[i]) >> 26);
+	}
+
+size_t BlockedBloomFilter::Count(const zeek::detail::HashKey* key) const
+	{
+	uint64_t digest = hash(key->Key(), key->Size());
+	const Block& b = blocks[BlockIndex(digest)];
+	uint32_t lower = static_cast<uint32_t>(digest);
+
+	// Collect missing bits instead of returning early, which lets the
+	// compiler turn the loop into a few vector instructions.
+	uint64_t missing = 0;
+
+	for ( size_t i = 0; i < hasher->K(); ++i )
+		missing |= ~b.words[i % BLOCK_WORDS] & (uint64_t(1) << ((lower * BLOCK_SALTS[i]) >> 26));
+
+	return missing ? 0 : 1;
+	}
+
+broker::expected<broker::data> BlockedBloomFilter::DoSerialize() const
+	{
+	broker::vector v;
+	v.reserve(blocks.size() * BLOCK_WORDS);
+
+	for ( const auto& b : blocks )
+		for ( auto w : b.words )
+			v.emplace_back(static_cast<uint64_t>(w));
+
+	return {std::move(v)};
+	}
+
+bool BlockedBloomFilter::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && ! v->empty() && v->size() % BLOCK_WORDS == 0) )
+		return false;
+
+	if ( hasher->K() == 0 || hasher->K() > MAX_K )
+		return false;
+
+	blocks.resize(v->size() / BLOCK_WORDS);
+
+	for ( size_t i = 0; i < v->size(); ++i )
+		{
+		auto w = caf::get_if<uint64_t>(&(*v)[i]);
+		if ( ! w )
+			return false;
+
+		blocks[i / BLOCK_WORDS].words[i % BLOCK_WORDS] = *w;
+		}
+
+	hash = detail::UHF(hasher->Seed());
+	return true;
+	}
+
+TEST_CASE("blocked bloom filter")
+	{
+	detail::Hasher::seed_t seed = {{42, 4711}};
+	size_t capacity = 10000;
+	size_t cells = BasicBloomFilter::M(0.01, capacity);
+	size_t k = BasicBloomFilter::K(cells, capacity);
+	BlockedBloomFilter blocked(new detail::DoubleHasher(k, seed), cells);
+	BloomFilter& bf = blocked;
+
+	CHECK(bf.Empty());
+
+	for ( bro_uint_t i = 0; i < capacity; ++i )
+		{
+		zeek::detail::HashKey key(i);
+		bf.Add(&key);
+		}
+
+	CHECK(! bf.Empty());
+
+	size_t found = 0;
+	size_t false_positives = 0;
+
+	for ( bro_uint_t i = 0; i < 2 * capacity; ++i )
+		{
+		zeek::detail::HashKey key(i);
+
+		if ( i < capacity )
+			found += bf.Count(&key);
+		else
+			false_positives += bf.Count(&key);
+		}
+
+	CHECK(found == capacity);
+	// A blocked filter doesn't quite achieve the 1% of a basic one.
+	CHECK(false_positives < capacity / 40);
+
+	BloomFilter* copy = bf.Clone();
+	CHECK(copy->InternalState() == bf.InternalState());
+
+	auto d = bf.Serialize();
+	REQUIRE(d);
+	auto restored = BloomFilter::Unserialize(*d);
+	REQUIRE(restored);
+	CHECK(restored->InternalState() == bf.InternalState());
+
+	zeek::detail::HashKey key(bro_uint_t(capacity - 1));
+	CHECK(restored->Count(&key) == 1);
+
+	copy->Clear();
+	CHECK(copy->Empty());
+	CHECK(copy->Merge(&bf));
+	CHECK(copy->InternalState() == bf.InternalState());
+	delete copy;
+	}
+
 CountingBloomFilter::CountingBloomFilter()
 	{
 	cells = nullptr;
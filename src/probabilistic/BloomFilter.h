@@ -20,7 +20,7 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(CounterVector, zeek, probabilistic, detail);
 namespace zeek::probabilistic {
 
 /** Types of derived BloomFilter classes. */
-enum BloomFilterType { Basic, Counting };
+enum BloomFilterType { Basic, Counting, Blocked };
 
 /**
  * The abstract base class for Bloom filters.
@@ -181,6 +181,81 @@ private:
 	detail::BitVector* bits;
 };
 
+/**
+ * A blocked Bloom filter. All *k* bits of an element live in the same
+ * 512-bit block, i.e., in a single cache line, and are derived from a
+ * single 64-bit hash: its upper half selects the block and its lower half,
+ * multiplied with a different odd constant per bit, selects one bit in
+ * each of the block's eight words in turn. Every operation thus touches
+ * one cache line and computes one hash, at the price of a slightly higher
+ * false-positive rate than a BasicBloomFilter with the same number of
+ * cells.
+ */
+class BlockedBloomFilter : public BloomFilter {
+public:
+	/**
+	 * The number of bits of the filter that one element can set.
+	 */
+	static constexpr size_t MAX_K = 16;
+
+	/**
+	 * Constructs a blocked Bloom filter.
+	 *
+	 * @param hasher The hasher to use. Only its seed and its number of hash
+	 * functions, which must not exceed *MAX_K*, are used.
+	 *
+	 * @param cells The number of cells, which is rounded up to the next
+	 * multiple of the block size. *BasicBloomFilter::M* computes a
+	 * suitable value.
+	 */
+	BlockedBloomFilter(const detail::Hasher* hasher, size_t cells);
+
+	/**
+	 * Destructor.
+	 */
+	~BlockedBloomFilter() override;
+
+	// Overridden from BloomFilter.
+	bool Empty() const override;
+	void Clear() override;
+	bool Merge(const BloomFilter* other) override;
+	BlockedBloomFilter* Clone() const override;
+	std::string InternalState() const override;
+
+protected:
+	friend class BloomFilter;
+
+	/**
+	 * Default constructor.
+	 */
+	BlockedBloomFilter();
+
+	// Overridden from BloomFilter.
+	void Add(const zeek::detail::HashKey* key) override;
+	size_t Count(const zeek::detail::HashKey* key) const override;
+	broker::expected<broker::data> DoSerialize() const override;
+	bool DoUnserialize(const broker::data& data) override;
+	BloomFilterType Type() const override
+		{ return BloomFilterType::Blocked; }
+
+private:
+	static constexpr size_t BLOCK_WORDS = 8;
+
+	struct alignas(64) Block {
+		uint64_t words[BLOCK_WORDS];
+	};
+
+	size_t BlockIndex(uint64_t digest) const
+		{
+		// Maps the upper half of the digest onto the blocks without a
+		// division (Lemire's "fastrange").
+		return ((digest >> 32) * blocks.size()) >> 32;
+		}
+
+	std::vector<Block> blocks;
+	detail::UHF hash;
+};
+
 /**
  * A counting Bloom filter.
  */
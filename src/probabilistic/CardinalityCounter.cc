@@ -4,14 +4,23 @@
 
 #include <math.h>
 #include <stdint.h>
+#include <algorithm>
 #include <utility>
 
 #include <broker/data.hh>
 
 #include "Reporter.h"
 
+#include "3rdparty/doctest.h"
+
 namespace zeek::probabilistic::detail {
 
+// Bucket values are ranks of at most 64 and fit into six bits, which
+// leaves room for indices of up to 26 bits in a sparse entry.
+static constexpr int SPARSE_RANK_BITS = 6;
+static constexpr uint32_t SPARSE_RANK_MASK = (1 << SPARSE_RANK_BITS) - 1;
+static constexpr int SPARSE_MAX_P = 32 - SPARSE_RANK_BITS;
+
 int CardinalityCounter::OptimalB(double error, double confidence) const
 	{
 	double initial_estimate = 2 * (log(1.04) - log(error)) / log(2);
@@ -58,18 +67,73 @@ void CardinalityCounter::Init(uint64_t size)
 
 	p = calc_p;
 
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
+	is_sparse = SparseLimit() > 0;
 
-	assert(buckets.size() == m);
+	if ( ! is_sparse )
+		buckets.assign(m, 0);
 
 	V = m;
 	}
 
+uint64_t CardinalityCounter::SparseLimit() const
+	{
+	if ( p > SPARSE_MAX_P )
+		return 0;
+
+	// Sparse entries take four bytes, dense buckets one. Switch while
+	// the sparse representation is still half the size of the dense one.
+	return m / 8;
+	}
+
+void CardinalityCounter::ToDense()
+	{
+	if ( ! is_sparse )
+		return;
+
+	buckets.assign(m, 0);
+
+	for ( auto e : sparse )
+		buckets[e >> SPARSE_RANK_BITS] = e & SPARSE_RANK_MASK;
+
+	sparse.clear();
+	sparse.shrink_to_fit();
+	is_sparse = false;
+	}
+
+void CardinalityCounter::ToSparse()
+	{
+	if ( is_sparse || SparseLimit() == 0 )
+		return;
+
+	uint64_t set = 0;
+
+	for ( auto b : buckets )
+		{
+		// Values that don't fit can only come from a corrupt counter.
+		if ( b > SPARSE_RANK_MASK )
+			return;
+
+		set += (b != 0);
+		}
+
+	if ( set > SparseLimit() )
+		return;
+
+	sparse.reserve(set);
+
+	for ( uint64_t i = 0; i < m; ++i )
+		if ( buckets[i] )
+			sparse.push_back((i << SPARSE_RANK_BITS) | buckets[i]);
+
+	buckets.clear();
+	buckets.shrink_to_fit();
+	is_sparse = true;
+	}
+
 CardinalityCounter::CardinalityCounter(CardinalityCounter& other)
-	: buckets(other.buckets)
+	: buckets(other.buckets), sparse(other.sparse)
 	{
+	is_sparse = other.is_sparse;
 	V = other.V;
 	alpha_m = other.alpha_m;
 	m = other.m;
@@ -85,6 +149,8 @@ CardinalityCounter::CardinalityCounter(CardinalityCounter&& o) noexcept
 
 	o.m = 0;
 	buckets = std::move(o.buckets);
+	sparse = std::move(o.sparse);
+	is_sparse = o.is_sparse;
 	}
 
 CardinalityCounter::CardinalityCounter(double error_margin, double confidence)
@@ -103,10 +169,8 @@ CardinalityCounter::CardinalityCounter(uint64_t size)
 CardinalityCounter::CardinalityCounter(uint64_t arg_size, uint64_t arg_V, double arg_alpha_m)
 	{
 	m = arg_size;
-
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
+	buckets.assign(m, 0);
+	is_sparse = false;
 
 	alpha_m = arg_alpha_m;
 	V = arg_V;
@@ -131,10 +195,32 @@ void CardinalityCounter::AddElement(uint64_t hash)
 	uint64_t index = hash % m;
 	hash = hash-index;
 
-	if( buckets[index] == 0 )
+	uint8_t temp = Rank(hash);
+
+	if ( is_sparse )
+		{
+		uint32_t entry = index << SPARSE_RANK_BITS;
+		auto it = std::lower_bound(sparse.begin(), sparse.end(), entry);
+
+		if ( it != sparse.end() && (*it >> SPARSE_RANK_BITS) == index )
+			{
+			if ( temp > (*it & SPARSE_RANK_MASK) )
+				*it = entry | temp;
+
+			return;
+			}
+
+		sparse.insert(it, entry | temp);
 		V--;
 
-	uint8_t temp = Rank(hash);
+		if ( sparse.size() > SparseLimit() )
+			ToDense();
+
+		return;
+		}
+
+	if( buckets[index] == 0 )
+		V--;
 
 	if ( temp > buckets[index] )
 		buckets[index] = temp;
@@ -152,8 +238,24 @@ void CardinalityCounter::AddElement(uint64_t hash)
 double CardinalityCounter::Size() const
 	{
 	double answer = 0;
-	for ( unsigned int i = 0; i < m; i++ )
-		answer += pow(2, -((int)buckets[i]));
+
+	if ( is_sparse )
+		{
+		// Sum up in the same order as for dense buckets, so that both
+		// give exactly the same result.
+		auto it = sparse.begin();
+
+		for ( uint64_t i = 0; i < m; i++ )
+			{
+			if ( it != sparse.end() && (*it >> SPARSE_RANK_BITS) == i )
+				answer += pow(2, -((int)(*it++ & SPARSE_RANK_MASK)));
+			else
+				answer += 1;
+			}
+		}
+	else
+		for ( unsigned int i = 0; i < m; i++ )
+			answer += pow(2, -((int)buckets[i]));
 
 	answer = 1 / answer;
 	answer = (alpha_m * m * m * answer);
@@ -173,25 +275,74 @@ bool CardinalityCounter::Merge(CardinalityCounter* c)
 	if ( m != c->GetM() )
 		return false;
 
-	const std::vector<uint8_t>& temp = c->GetBuckets();
+	if ( c->is_sparse && is_sparse )
+		{
+		std::vector<uint32_t> merged;
+		merged.reserve(sparse.size() + c->sparse.size());
 
-	V = 0;
+		auto a = sparse.begin();
+		auto b = c->sparse.begin();
 
-	for ( size_t i = 0; i < m; i++ )
+		while ( a != sparse.end() && b != c->sparse.end() )
+			{
+			uint32_t ia = *a >> SPARSE_RANK_BITS;
+			uint32_t ib = *b >> SPARSE_RANK_BITS;
+
+			if ( ia < ib )
+				merged.push_back(*a++);
+			else if ( ib < ia )
+				merged.push_back(*b++);
+			else
+				// Same index, so the larger entry has the larger value.
+				merged.push_back(std::max(*a++, *b++));
+			}
+
+		merged.insert(merged.end(), a, sparse.end());
+		merged.insert(merged.end(), b, c->sparse.end());
+
+		sparse = std::move(merged);
+		V = m - sparse.size();
+
+		if ( sparse.size() > SparseLimit() )
+			ToDense();
+
+		return true;
+		}
+
+	if ( c->is_sparse )
 		{
-		if ( temp[i] > buckets[i] )
-			buckets[i] = temp[i];
+		for ( auto e : c->sparse )
+			{
+			uint8_t& bucket = buckets[e >> SPARSE_RANK_BITS];
+			uint8_t value = e & SPARSE_RANK_MASK;
 
-		if ( buckets[i] == 0 )
-			++V;
+			if ( bucket == 0 )
+				--V;
+
+			if ( value > bucket )
+				bucket = value;
+			}
+
+		return true;
 		}
 
-	return true;
-	}
+	ToDense();
 
-const std::vector<uint8_t> &CardinalityCounter::GetBuckets() const
-	{
-	return buckets;
+	// Keep these loops free of branches and dependencies between
+	// iterations, so that the compiler vectorizes them.
+	uint8_t* dst = buckets.data();
+	const uint8_t* src = c->buckets.data();
+
+	for ( size_t i = 0; i < m; i++ )
+		dst[i] = std::max(dst[i], src[i]);
+
+	uint64_t zeros = 0;
+
+	for ( size_t i = 0; i < m; i++ )
+		zeros += (dst[i] == 0);
+
+	V = zeros;
+	return true;
 	}
 
 uint64_t CardinalityCounter::GetM() const
@@ -204,8 +355,22 @@ broker::expected<broker::data> CardinalityCounter::Serialize() const
 	broker::vector v = {m, V, alpha_m};
 	v.reserve(3 + m);
 
-	for ( size_t i = 0; i < m; ++i )
-		v.emplace_back(static_cast<uint64_t>(buckets[i]));
+	// Always send the dense form, which every version understands.
+	if ( is_sparse )
+		{
+		auto it = sparse.begin();
+
+		for ( uint64_t i = 0; i < m; ++i )
+			{
+			if ( it != sparse.end() && (*it >> SPARSE_RANK_BITS) == i )
+				v.emplace_back(static_cast<uint64_t>(*it++ & SPARSE_RANK_MASK));
+			else
+				v.emplace_back(static_cast<uint64_t>(0));
+			}
+		}
+	else
+		for ( size_t i = 0; i < m; ++i )
+			v.emplace_back(static_cast<uint64_t>(buckets[i]));
 
 	return {std::move(v)};
 	}
@@ -240,9 +405,74 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 		cc->buckets[i] = *x;
 		}
 
+	cc->ToSparse();
 	return cc;
 	}
 
+TEST_CASE("cardinality counter sparse representation")
+	{
+	// splitmix64, for reproducible hashes.
+	uint64_t state = 0;
+	auto next_hash = [&state]()
+		{
+		uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+		};
+
+	std::vector<uint64_t> hashes;
+	for ( int i = 0; i < 20000; ++i )
+		hashes.push_back(next_hash());
+
+	CardinalityCounter all(uint64_t(4096));
+	CardinalityCounter first(uint64_t(4096));
+	CardinalityCounter second(uint64_t(4096));
+	CHECK(all.IsSparse());
+
+	for ( int i = 0; i < 200; ++i )
+		{
+		all.AddElement(hashes[i]);
+		(i % 2 ? first : second).AddElement(hashes[i]);
+		}
+
+	CHECK(all.IsSparse());
+	CHECK(first.Merge(&second));
+	CHECK(first.IsSparse());
+	CHECK(first.Size() == all.Size());
+	CHECK(all.Size() > 180);
+	CHECK(all.Size() < 220);
+
+	CardinalityCounter grown(all);
+
+	for ( auto h : hashes )
+		grown.AddElement(h);
+
+	CHECK(! grown.IsSparse());
+
+	CardinalityCounter dense(uint64_t(4096));
+
+	for ( auto i = hashes.rbegin(); i != hashes.rend(); ++i )
+		dense.AddElement(*i);
+
+	CHECK(grown.Size() == dense.Size());
+
+	// Dense into sparse and sparse into dense.
+	CardinalityCounter mixed(all);
+	CHECK(mixed.Merge(&dense));
+	CHECK(mixed.Size() == dense.Size());
+	CHECK(dense.Merge(&all));
+	CHECK(mixed.Size() == dense.Size());
+
+	// Serialization always uses the dense format.
+	auto d = all.Serialize();
+	REQUIRE(d);
+	auto restored = CardinalityCounter::Unserialize(*d);
+	REQUIRE(restored);
+	CHECK(restored->IsSparse());
+	CHECK(restored->Size() == all.Size());
+	}
+
 /**
  * The following function is copied from libc/string/flsll.c from the FreeBSD source
  * tree. Original copyright message follows
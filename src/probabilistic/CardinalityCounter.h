@@ -15,6 +15,11 @@ namespace zeek::probabilistic::detail {
 
 /**
  * A probabilistic cardinality counter using the HyperLogLog algorithm.
+ *
+ * As long as few buckets are set, the counter only stores those, as in
+ * the sparse representation of HyperLogLog++, and switches to a dense
+ * array of all buckets once that becomes smaller. Both representations
+ * hold the same information; estimates don't depend on which one is used.
  */
 class CardinalityCounter {
 public:
@@ -89,6 +94,12 @@ public:
 	 */
 	bool Merge(CardinalityCounter* c);
 
+	/**
+	 * Returns true if the counter currently uses the sparse
+	 * representation.
+	 */
+	bool IsSparse() const	{ return is_sparse; }
+
 	broker::expected<broker::data> Serialize() const;
 	static std::unique_ptr<CardinalityCounter> Unserialize(const broker::data& data);
 
@@ -100,15 +111,6 @@ protected:
 	 */
 	uint64_t GetM() const;
 
-	/**
-	 * Returns the buckets array that holds all of the rough cardinality
-	 * estimates.
-	 *
-	 * Use GetM() to determine the size.
-	 *
-	 * @return Array containing cardinality estimates
-	 */
-	const std::vector<uint8_t>& GetBuckets() const;
 
 private:
 	/**
@@ -124,6 +126,23 @@ private:
 	 */
 	void Init(uint64_t arg_size);
 
+	/**
+	 * Switches to the dense representation.
+	 */
+	void ToDense();
+
+	/**
+	 * Switches to the sparse representation if that is smaller.
+	 */
+	void ToSparse();
+
+	/**
+	 * Returns the maximum number of buckets that the sparse
+	 * representation holds before it switches to the dense one, or zero
+	 * if the counter has to be dense.
+	 */
+	uint64_t SparseLimit() const;
+
 	/**
 	 * This function calculates the smallest value of b that will
 	 * satisfy these the constraints of a specified error margin and
@@ -175,6 +194,14 @@ private:
 	 */
 	std::vector<uint8_t> buckets;
 
+	/**
+	 * The buckets that are set, while the counter is sparse. Every entry
+	 * holds a bucket's index, shifted left by SPARSE_RANK_BITS, and its
+	 * value in the remaining bits. The entries are sorted by index.
+	 */
+	std::vector<uint32_t> sparse;
+	bool is_sparse;
+
 	/**
 	 * There are some state constants that need to be kept track of to
 	 * make the final estimate easier. V is the number of values in
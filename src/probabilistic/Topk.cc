@@ -2,21 +2,17 @@
 
 #include "probabilistic/Topk.h"
 
+#include <string.h>
+#include <memory>
+
 #include <broker/error.hh>
 
 #include "broker/Data.h"
 #include "CompHash.h"
 #include "Reporter.h"
-#include "Dict.h"
 
 namespace zeek::probabilistic::detail {
 
-static void topk_element_hash_delete_func(void* val)
-	{
-	Element* e = (Element*) val;
-	delete e;
-	}
-
 void TopkVal::Typify(TypePtr t)
 	{
 	assert(!hash && !type);
@@ -35,37 +31,255 @@ zeek::detail::HashKey* TopkVal::GetHash(Val* v) const
 
 TopkVal::TopkVal(uint64_t arg_size) : OpaqueVal(topk_type)
 	{
-	elementDict = new PDict<Element>;
-	elementDict->SetDeleteFunc(topk_element_hash_delete_func);
 	size = arg_size;
 	numElements = 0;
 	pruned = false;
 	hash = nullptr;
+	min_bucket = max_bucket = NIL;
 	}
 
 TopkVal::TopkVal() : OpaqueVal(topk_type)
 	{
-	elementDict = new PDict<Element>;
-	elementDict->SetDeleteFunc(topk_element_hash_delete_func);
 	size = 0;
 	numElements = 0;
+	pruned = false;
 	hash = nullptr;
+	min_bucket = max_bucket = NIL;
 	}
 
 TopkVal::~TopkVal()
 	{
-	elementDict->Clear();
-	delete elementDict;
+	delete hash;
+	}
+
+uint32_t TopkVal::Find(zeek::detail::hash_t h, const void* key, size_t len) const
+	{
+	if ( index.empty() )
+		return NIL;
+
+	size_t mask = index.size() - 1;
 
-	// now all elements are already gone - delete the buckets
-	std::list<Bucket*>::iterator bi = buckets.begin();
-	while ( bi != buckets.end() )
+	for ( size_t i = h & mask; index[i] != NIL; i = (i + 1) & mask )
 		{
-		delete *bi;
-		bi++;
+		const Element& e = elements[index[i]];
+
+		if ( e.hash == h && e.key.size() == len && memcmp(e.key.data(), key, len) == 0 )
+			return index[i];
 		}
 
-	delete hash;
+	return NIL;
+	}
+
+uint32_t TopkVal::Find(const zeek::detail::HashKey* key) const
+	{
+	return Find(key->Hash(), key->Key(), key->Size());
+	}
+
+void TopkVal::IndexResize(size_t slots)
+	{
+	std::vector<uint32_t> old(slots, NIL);
+	old.swap(index);
+	size_t mask = slots - 1;
+
+	for ( auto e : old )
+		{
+		if ( e == NIL )
+			continue;
+
+		size_t i = elements[e].hash & mask;
+
+		while ( index[i] != NIL )
+			i = (i + 1) & mask;
+
+		index[i] = e;
+		}
+	}
+
+void TopkVal::IndexInsert(uint32_t e)
+	{
+	// Keep the load factor at or below one half. The index only grows:
+	// eviction keeps the number of elements at the tracked size.
+	if ( (numElements + 1) * 2 > index.size() )
+		{
+		size_t slots = index.empty() ? 16 : index.size();
+
+		while ( (numElements + 1) * 2 > slots )
+			slots *= 2;
+
+		IndexResize(slots);
+		}
+
+	size_t mask = index.size() - 1;
+	size_t i = elements[e].hash & mask;
+
+	while ( index[i] != NIL )
+		i = (i + 1) & mask;
+
+	index[i] = e;
+	}
+
+void TopkVal::IndexRemove(uint32_t e)
+	{
+	size_t mask = index.size() - 1;
+	size_t i = elements[e].hash & mask;
+
+	while ( index[i] != e )
+		{
+		assert(index[i] != NIL);
+		i = (i + 1) & mask;
+		}
+
+	// Shift following entries of the probe sequence back into the gap,
+	// unless that would move them before their home slot.
+	size_t j = i;
+
+	for ( ;; )
+		{
+		j = (j + 1) & mask;
+
+		if ( index[j] == NIL )
+			break;
+
+		size_t home = elements[index[j]].hash & mask;
+
+		if ( (j > i && (home <= i || home > j)) ||
+		     (j < i && (home <= i && home > j)) )
+			{
+			index[i] = index[j];
+			i = j;
+			}
+		}
+
+	index[i] = NIL;
+	}
+
+uint32_t TopkVal::NewElement(ValPtr value, std::string key, zeek::detail::hash_t h,
+                             uint64_t epsilon)
+	{
+	uint32_t e;
+
+	if ( free_elements.empty() )
+		{
+		e = elements.size();
+		elements.emplace_back();
+		}
+	else
+		{
+		e = free_elements.back();
+		free_elements.pop_back();
+		}
+
+	Element& elem = elements[e];
+	elem.epsilon = epsilon;
+	elem.value = std::move(value);
+	elem.key = std::move(key);
+	elem.hash = h;
+	elem.bucket = elem.prev = elem.next = NIL;
+	return e;
+	}
+
+void TopkVal::RemoveElement(uint32_t e)
+	{
+	uint32_t b = elements[e].bucket;
+
+	IndexRemove(e);
+	UnlinkElement(e);
+
+	if ( buckets[b].size == 0 )
+		RemoveBucket(b);
+
+	elements[e].value = nullptr;
+	free_elements.push_back(e);
+	}
+
+uint32_t TopkVal::NewBucket(uint64_t count, uint32_t after)
+	{
+	uint32_t b;
+
+	if ( free_buckets.empty() )
+		{
+		b = buckets.size();
+		buckets.emplace_back();
+		}
+	else
+		{
+		b = free_buckets.back();
+		free_buckets.pop_back();
+		}
+
+	Bucket& bucket = buckets[b];
+	bucket.count = count;
+	bucket.head = bucket.tail = NIL;
+	bucket.size = 0;
+	bucket.prev = after;
+	bucket.next = after == NIL ? min_bucket : buckets[after].next;
+
+	if ( bucket.prev == NIL )
+		min_bucket = b;
+	else
+		buckets[bucket.prev].next = b;
+
+	if ( bucket.next == NIL )
+		max_bucket = b;
+	else
+		buckets[bucket.next].prev = b;
+
+	return b;
+	}
+
+void TopkVal::RemoveBucket(uint32_t b)
+	{
+	const Bucket& bucket = buckets[b];
+	assert(bucket.size == 0);
+
+	if ( bucket.prev == NIL )
+		min_bucket = bucket.next;
+	else
+		buckets[bucket.prev].next = bucket.next;
+
+	if ( bucket.next == NIL )
+		max_bucket = bucket.prev;
+	else
+		buckets[bucket.next].prev = bucket.prev;
+
+	free_buckets.push_back(b);
+	}
+
+void TopkVal::LinkElement(uint32_t e, uint32_t b)
+	{
+	Element& elem = elements[e];
+	Bucket& bucket = buckets[b];
+
+	elem.bucket = b;
+	elem.prev = bucket.tail;
+	elem.next = NIL;
+
+	if ( bucket.tail == NIL )
+		bucket.head = e;
+	else
+		elements[bucket.tail].next = e;
+
+	bucket.tail = e;
+	++bucket.size;
+	}
+
+void TopkVal::UnlinkElement(uint32_t e)
+	{
+	Element& elem = elements[e];
+	Bucket& bucket = buckets[elem.bucket];
+
+	if ( elem.prev == NIL )
+		bucket.head = elem.next;
+	else
+		elements[elem.prev].next = elem.next;
+
+	if ( elem.next == NIL )
+		bucket.tail = elem.prev;
+	else
+		elements[elem.next].prev = elem.prev;
+
+	elem.prev = elem.next = NIL;
+	--bucket.size;
 	}
 
 void TopkVal::Merge(const TopkVal* value, bool doPrune)
@@ -92,54 +306,39 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 			}
 		}
 
-	std::list<Bucket*>::const_iterator it = value->buckets.begin();
-	while ( it != value->buckets.end() )
+	for ( uint32_t b = value->min_bucket; b != NIL; b = value->buckets[b].next )
 		{
-		Bucket* b = *it;
-		uint64_t currcount = b->count;
-		std::list<Element*>::const_iterator eit = b->elements.begin();
+		uint64_t currcount = value->buckets[b].count;
 
-		while ( eit != b->elements.end() )
+		for ( uint32_t e = value->buckets[b].head; e != NIL; e = value->elements[e].next )
 			{
-			Element* e = *eit;
+			// The types are the same, so are the hash keys.
+			const Element& other = value->elements[e];
+
 			// lookup if we already know this one...
-			zeek::detail::HashKey* key = GetHash(e->value);
-			Element* olde = (Element*) elementDict->Lookup(key);
+			uint32_t olde = Find(other.hash, other.key.data(), other.key.size());
 
-			if ( olde == nullptr )
+			if ( olde == NIL )
 				{
-				olde = new Element();
-				olde->epsilon = 0;
-				olde->value = e->value;
+				olde = NewElement(other.value, other.key, other.hash, 0);
+
 				// insert at bucket position 0
-				if ( buckets.size() > 0 )
+				if ( min_bucket != NIL )
 					{
-					assert (buckets.front()-> count > 0 );
+					assert(buckets[min_bucket].count > 0);
 					}
 
-				Bucket* newbucket = new Bucket();
-				newbucket->count = 0;
-				newbucket->bucketPos = buckets.insert(buckets.begin(), newbucket);
-
-				olde->parent = newbucket;
-				newbucket->elements.insert(newbucket->elements.end(), olde);
-
-				elementDict->Insert(key, olde);
+				LinkElement(olde, NewBucket(0, NIL));
+				IndexInsert(olde);
 				numElements++;
-
 				}
 
 			// now that we are sure that the old element is present - increment epsilon
-			olde->epsilon += e->epsilon;
+			elements[olde].epsilon += other.epsilon;
 
 			// and increment position...
 			IncrementCounter(olde, currcount);
-			delete key;
-
-			eit++;
 			}
-
-		it++;
 		}
 
 	// now we have added everything. And our top-k table could be too big.
@@ -153,24 +352,8 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 	while ( numElements > size )
 		{
 		pruned = true;
-		assert(buckets.size() > 0 );
-		Bucket* b = buckets.front();
-		assert(b->elements.size() > 0);
-
-		Element* e = b->elements.front();
-		zeek::detail::HashKey* key = GetHash(e->value);
-		elementDict->RemoveEntry(key);
-		delete key;
-		delete e;
-
-		b->elements.pop_front();
-
-		if ( b->elements.size() == 0 )
-			{
-			delete b;
-			buckets.pop_front();
-			}
-
+		assert(min_bucket != NIL);
+		RemoveElement(buckets[min_bucket].head);
 		numElements--;
 		}
 	}
@@ -197,70 +380,51 @@ VectorValPtr TopkVal::GetTopK(int k) const // returns vector
 	// in any case - just to make this future-proof (and I am lazy) - this can return more than k.
 
 	int read = 0;
-	std::list<Bucket*>::const_iterator it = buckets.end();
-	it--;
-	while (read < k )
-		{
-		//printf("Bucket %llu\n", (*it)->count);
-		std::list<Element*>::iterator eit = (*it)->elements.begin();
-		while ( eit != (*it)->elements.end() )
+
+	for ( uint32_t b = max_bucket; b != NIL && read < k; b = buckets[b].prev )
+		for ( uint32_t e = buckets[b].head; e != NIL; e = elements[e].next )
 			{
-			//printf("Size: %ld\n", (*it)->elements.size());
-			t->Assign(read, (*eit)->value);
+			t->Assign(read, elements[e].value);
 			read++;
-			eit++;
 			}
 
-		if ( it == buckets.begin() )
-			break;
-
-		it--;
-		}
-
 	return t;
 	}
 
 uint64_t TopkVal::GetCount(Val* value) const
 	{
-	zeek::detail::HashKey* key = GetHash(value);
-	Element* e = (Element*) elementDict->Lookup(key);
-	delete key;
+	std::unique_ptr<zeek::detail::HashKey> key(GetHash(value));
+	uint32_t e = Find(key.get());
 
-	if ( e == nullptr )
+	if ( e == NIL )
 		{
 		reporter->Error("GetCount for element that is not in top-k");
 		return 0;
 		}
 
-	return e->parent->count;
+	return buckets[elements[e].bucket].count;
 	}
 
 uint64_t TopkVal::GetEpsilon(Val* value) const
 	{
-	zeek::detail::HashKey* key = GetHash(value);
-	Element* e = (Element*) elementDict->Lookup(key);
-	delete key;
+	std::unique_ptr<zeek::detail::HashKey> key(GetHash(value));
+	uint32_t e = Find(key.get());
 
-	if ( e == nullptr )
+	if ( e == NIL )
 		{
 		reporter->Error("GetEpsilon for element that is not in top-k");
 		return 0;
 		}
 
-	return e->epsilon;
+	return elements[e].epsilon;
 	}
 
 uint64_t TopkVal::GetSum() const
 	{
 	uint64_t sum = 0;
 
-	std::list<Bucket*>::const_iterator it = buckets.begin();
-	while ( it != buckets.end() )
-		{
-		sum += (*it)->elements.size() * (*it)->count;
-
-		it++;
-		}
+	for ( uint32_t b = min_bucket; b != NIL; b = buckets[b].next )
+		sum += buckets[b].size * buckets[b].count;
 
 	if ( pruned )
 		reporter->Warning("TopkVal::GetSum() was used on a pruned data structure. Result values do not represent total element count");
@@ -272,7 +436,7 @@ void TopkVal::Encountered(ValPtr encountered)
 	{
 	// ok, let's see if we already know this one.
 
-	if ( numElements == 0 )
+	if ( ! type )
 		Typify(encountered->GetType());
 	else
 		if ( ! same_type(type, encountered->GetType()) )
@@ -282,62 +446,55 @@ void TopkVal::Encountered(ValPtr encountered)
 			}
 
 	// Step 1 - get the hash.
-	zeek::detail::HashKey* key = GetHash(encountered);
-	Element* e = (Element*) elementDict->Lookup(key);
+	std::unique_ptr<zeek::detail::HashKey> key(GetHash(encountered));
+	uint32_t e = Find(key.get());
 
-	if ( e == nullptr )
+	if ( e == NIL )
 		{
-		e = new Element();
-		e->epsilon = 0;
-		e->value = std::move(encountered);
+		std::string key_data(static_cast<const char*>(key->Key()), key->Size());
 
 		// well, we do not know this one yet...
 		if ( numElements < size )
 			{
+			e = NewElement(std::move(encountered), std::move(key_data), key->Hash(), 0);
+
 			// brilliant. just add it at position 1
-			if ( buckets.size() == 0 || (*buckets.begin())->count > 1 )
-				{
-				Bucket* b = new Bucket();
-				b->count = 1;
-				std::list<Bucket*>::iterator pos = buckets.insert(buckets.begin(), b);
-				b->bucketPos = pos;
-				b->elements.insert(b->elements.end(), e);
-				e->parent = b;
-				}
+			if ( min_bucket == NIL || buckets[min_bucket].count > 1 )
+				LinkElement(e, NewBucket(1, NIL));
 			else
 				{
-				Bucket* b = *buckets.begin();
-				assert(b->count == 1);
-				b->elements.insert(b->elements.end(), e);
-				e->parent = b;
+				assert(buckets[min_bucket].count == 1);
+				LinkElement(e, min_bucket);
 				}
 
-			elementDict->Insert(key, e);
+			IndexInsert(e);
 			numElements++;
-			delete key;
 
 			return; // done. it is at pos 1.
 			}
 
 		else
 			{
-			// replace element with min-value
-			Bucket* b = *buckets.begin(); // bucket with smallest elements
-
-			// evict oldest element with least hits.
-			assert(b->elements.size() > 0);
-			zeek::detail::HashKey* deleteKey = GetHash((*(b->elements.begin()))->value);
-			b->elements.erase(b->elements.begin());
-			Element* deleteElement = (Element*) elementDict->RemoveEntry(deleteKey);
-			assert(deleteElement); // there has to have been a minimal element...
-			delete deleteElement;
-			delete deleteKey;
+			if ( min_bucket == NIL )
+				// Only possible when tracking zero elements.
+				return;
+
+			// replace element with min-value. Reuse the slot of the
+			// oldest element with least hits that we evict.
+			uint32_t b = min_bucket;
+			e = buckets[b].head;
+			IndexRemove(e);
+			UnlinkElement(e);
+
+			Element& elem = elements[e];
+			elem.epsilon = buckets[b].count;
+			elem.value = std::move(encountered);
+			elem.key = std::move(key_data);
+			elem.hash = key->Hash();
 
 			// and add the new one to the end
-			e->epsilon = b->count;
-			b->elements.insert(b->elements.end(), e);
-			elementDict->Insert(key, e);
-			e->parent = b;
+			LinkElement(e, b);
+			IndexInsert(e);
 
 			// fallthrough, increment operation has to run!
 			}
@@ -345,56 +502,37 @@ void TopkVal::Encountered(ValPtr encountered)
 		}
 
 	// ok, we now have an element in e
-	delete key;
 	IncrementCounter(e); // well, this certainly was anticlimatic.
 	}
 
 // increment by count
-void TopkVal::IncrementCounter(Element* e, unsigned int count)
+void TopkVal::IncrementCounter(uint32_t e, uint64_t count)
 	{
-	Bucket* currBucket = e->parent;
-	uint64_t currcount = currBucket->count;
-
-	// well, let's test if there is a bucket for currcount++
-	std::list<Bucket*>::iterator bucketIter = currBucket->bucketPos;
-
-	Bucket* nextBucket = nullptr;
-
-	bucketIter++;
+	uint32_t currBucket = elements[e].bucket;
+	uint64_t newcount = buckets[currBucket].count + count;
 
-	while ( bucketIter != buckets.end() && (*bucketIter)->count < currcount+count )
-		bucketIter++;
+	// well, let's test if there is a bucket for the new count
+	uint32_t pos = currBucket;
+	uint32_t nextBucket = buckets[currBucket].next;
 
-	if ( bucketIter != buckets.end() && (*bucketIter)->count == currcount+count )
-		nextBucket = *bucketIter;
-
-	if ( nextBucket == nullptr )
+	while ( nextBucket != NIL && buckets[nextBucket].count < newcount )
 		{
-		// the bucket for the value that we want does not exist.
-		// create it...
-
-		Bucket* b = new Bucket();
-		b->count = currcount+count;
-
-		std::list<Bucket*>::iterator nextBucketPos = buckets.insert(bucketIter, b);
-		b->bucketPos = nextBucketPos; // and give it the iterator we know now.
-
-		nextBucket = b;
+		pos = nextBucket;
+		nextBucket = buckets[nextBucket].next;
 		}
 
-	// ok, now we have the new bucket in nextBucket. Shift the element over...
-	currBucket->elements.remove(e);
-	nextBucket->elements.insert(nextBucket->elements.end(), e);
+	// the bucket for the value that we want does not exist.
+	// create it...
+	if ( nextBucket == NIL || buckets[nextBucket].count != newcount )
+		nextBucket = NewBucket(newcount, pos);
 
-	e->parent = nextBucket;
+	// ok, now we have the new bucket in nextBucket. Shift the element over...
+	UnlinkElement(e);
+	LinkElement(e, nextBucket);
 
 	// if currBucket is empty, we have to delete it now
-	if ( currBucket->elements.size() == 0 )
-		{
-		buckets.remove(currBucket);
-		delete currBucket;
-		currBucket = nullptr;
-		}
+	if ( buckets[currBucket].size == 0 )
+		RemoveBucket(currBucket);
 	}
 
 IMPLEMENT_OPAQUE_VALUE(TopkVal)
@@ -415,31 +553,22 @@ broker::expected<broker::data> TopkVal::DoSerialize() const
 		d.emplace_back(broker::none());
 
 	uint64_t i = 0;
-	std::list<Bucket*>::const_iterator it = buckets.begin();
-	while ( it != buckets.end() )
-		{
-		Bucket* b = *it;
-		uint32_t elements_count = b->elements.size();
 
-		d.emplace_back(static_cast<uint64_t>(b->elements.size()));
-		d.emplace_back(b->count);
+	for ( uint32_t b = min_bucket; b != NIL; b = buckets[b].next )
+		{
+		d.emplace_back(buckets[b].size);
+		d.emplace_back(buckets[b].count);
 
-		std::list<Element*>::const_iterator eit = b->elements.begin();
-		while ( eit != b->elements.end() )
+		for ( uint32_t e = buckets[b].head; e != NIL; e = elements[e].next )
 			{
-			Element* element = *eit;
-			d.emplace_back(element->epsilon);
-			auto v = Broker::detail::val_to_data(element->value.get());
+			d.emplace_back(elements[e].epsilon);
+			auto v = Broker::detail::val_to_data(elements[e].value.get());
 			if ( ! v )
 				return broker::ec::invalid_data;
 
 			d.emplace_back(*v);
-
-			eit++;
 			i++;
 			}
-
-		it++;
 		}
 
 	assert(i == numElements);
@@ -462,7 +591,6 @@ bool TopkVal::DoUnserialize(const broker::data& data)
 		return false;
 
 	size = *size_;
-	numElements = *numElements_;
 	pruned = *pruned_;
 
 	auto no_type = caf::get_if<broker::none>(&(*v)[3]);
@@ -476,48 +604,50 @@ bool TopkVal::DoUnserialize(const broker::data& data)
 		Typify(t);
 		}
 
-	uint64_t i = 0;
 	uint64_t idx = 4;
 
-	while ( i < numElements )
+	// numElements counts what has been linked in so far, which
+	// IndexInsert() relies on.
+	while ( numElements < *numElements_ )
 		{
+		if ( idx + 2 > v->size() )
+			return false;
+
 		auto elements_count = caf::get_if<uint64_t>(&(*v)[idx++]);
 		auto count = caf::get_if<uint64_t>(&(*v)[idx++]);
 
 		if ( ! (elements_count && count) )
 			return false;
 
-		Bucket* b = new Bucket();
-		b->count = *count;
-		b->bucketPos = buckets.insert(buckets.end(), b);
+		uint32_t b = NewBucket(*count, max_bucket);
 
 		for ( uint64_t j = 0; j < *elements_count; j++ )
 			{
+			if ( idx + 2 > v->size() )
+				return false;
+
 			auto epsilon = caf::get_if<uint64_t>(&(*v)[idx++]);
 			auto val = Broker::detail::data_to_val((*v)[idx++], type.get());
 
 			if ( ! (epsilon && val) )
 				return false;
 
-			Element* e = new Element();
-			e->epsilon = *epsilon;
-			e->value = std::move(val);
-			e->parent = b;
-
-			b->elements.insert(b->elements.end(), e);
-
-			zeek::detail::HashKey* key = GetHash(e->value);
-			assert (elementDict->Lookup(key) == nullptr);
-
-			elementDict->Insert(key, e);
-			delete key;
+			std::unique_ptr<zeek::detail::HashKey> key(GetHash(val));
+			assert(Find(key.get()) == NIL);
 
-			i++;
+			uint32_t e = NewElement(std::move(val),
+			                        std::string(static_cast<const char*>(key->Key()), key->Size()),
+			                        key->Hash(), *epsilon);
+			LinkElement(e, b);
+			IndexInsert(e);
+			numElements++;
 			}
+
+		if ( buckets[b].size == 0 )
+			RemoveBucket(b);
 		}
 
-	assert(i == numElements);
-	return true;
+	return numElements == *numElements_;
 	}
 
 } // namespace zeek::probabilistic::detail
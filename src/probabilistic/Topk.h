@@ -2,35 +2,26 @@
 
 #pragma once
 
-#include <list>
+#include <string>
+#include <vector>
+
+#include "Hash.h"
 #include "Val.h"
 #include "OpaqueVal.h"
 
 // This class implements the top-k algorithm. Or - to be more precise - an
 // interpretation of it.
+//
+// The stream summary lives in flat arrays: elements and buckets refer to
+// each other by index rather than by pointer, and an open-addressed table
+// maps the hash keys of tracked values to their elements. Slots of evicted
+// elements and emptied buckets are reused, so a structure that has filled
+// up doesn't allocate anymore for new values beyond their hash keys.
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(CompositeHash, zeek::detail);
 
 namespace zeek::probabilistic::detail {
 
-struct Element;
-
-struct Bucket {
-	uint64_t count;
-	std::list<Element*> elements;
-
-	// Iterators only get invalidated for removed elements. This one
-	// points to us - so it is invalid when we are no longer there. Cute,
-	// isn't it?
-	std::list<Bucket*>::iterator bucketPos;
-};
-
-struct Element {
-	uint64_t epsilon;
-	ValPtr value;
-	Bucket* parent;
-};
-
 class TopkVal : public OpaqueVal {
 
 public:
@@ -136,14 +127,68 @@ protected:
 	TopkVal();
 
 private:
+	static constexpr uint32_t NIL = UINT32_MAX;
+
+	struct Element {
+		uint64_t epsilon;
+		ValPtr value;
+		std::string key; // the value's composite hash key
+		zeek::detail::hash_t hash;
+		uint32_t bucket;
+		uint32_t prev; // neighbors in the bucket, in order of arrival
+		uint32_t next;
+	};
+
+	struct Bucket {
+		uint64_t count;
+		uint32_t prev; // neighbors in order of ascending count
+		uint32_t next;
+		uint32_t head; // oldest element of the bucket
+		uint32_t tail; // newest element of the bucket
+		uint64_t size;
+	};
+
 	/**
 	 * Increment the counter for a specific element
 	 *
-	 * @param e element to increment counter for
+	 * @param e index of the element to increment counter for
 	 *
 	 * @param count increment counter by this much
 	 */
-	void IncrementCounter(Element* e, unsigned int count = 1);
+	void IncrementCounter(uint32_t e, uint64_t count = 1);
+
+	/**
+	 * Returns the index of the element with a given hash key, or NIL.
+	 */
+	uint32_t Find(zeek::detail::hash_t h, const void* key, size_t len) const;
+	uint32_t Find(const zeek::detail::HashKey* key) const;
+
+	/**
+	 * Allocates an element without linking it into a bucket or the
+	 * index.
+	 */
+	uint32_t NewElement(ValPtr value, std::string key, zeek::detail::hash_t h,
+	                    uint64_t epsilon);
+
+	/**
+	 * Unlinks an element from its bucket and the index and frees its
+	 * slot. Buckets left empty are removed.
+	 */
+	void RemoveElement(uint32_t e);
+
+	/**
+	 * Allocates a bucket and links it after a given one, or at the
+	 * front if *after* is NIL.
+	 */
+	uint32_t NewBucket(uint64_t count, uint32_t after);
+	void RemoveBucket(uint32_t b);
+
+	void LinkElement(uint32_t e, uint32_t b);
+	void UnlinkElement(uint32_t e);
+
+	void IndexInsert(uint32_t e);
+	void IndexRemove(uint32_t e);
+	void IndexResize(size_t slots);
 
 	/**
 	 * get the hashkey for a specific value
@@ -165,8 +210,17 @@ private:
 
 	TypePtr type;
 	zeek::detail::CompositeHash* hash;
-	std::list<Bucket*> buckets;
-	PDict<Element>* elementDict;
+
+	std::vector<Element> elements;
+	std::vector<uint32_t> free_elements;
+	std::vector<Bucket> buckets;
+	std::vector<uint32_t> free_buckets;
+	uint32_t min_bucket; // bucket with the smallest count, or NIL
+	uint32_t max_bucket; // bucket with the largest count, or NIL
+
+	// Open-addressed index of element slots; its size is a power of two.
+	std::vector<uint32_t> index;
+
 	uint64_t size; // how many elements are we tracking?
 	uint64_t numElements; // how many elements do we have at the moment
 	bool pruned; // was this data structure pruned?
@@ -176,8 +230,6 @@ private:
 
 namespace probabilistic {
 
-using Element [[deprecated("Remove in v4.1. Use zeek::probabilistic::detail::Element.")]] = zeek::probabilistic::detail::Element;
-using Bucket [[deprecated("Remove in v4.1. Use zeek::probabilistic::detail::Bucket.")]] = zeek::probabilistic::detail::Bucket;
 using TopkVal [[deprecated("Remove in v4.1. Use zeek::probabilistic::detail::TopkVal.")]] = zeek::probabilistic::detail::TopkVal;
 
 } //namespace probabilistic
@@ -8,6 +8,7 @@
 #include <fcntl.h>
 #include <poll.h>
 
+#include <climits>
 #include <cstdio>
 #include <csignal>
 #include <cstdarg>
@@ -103,6 +104,8 @@ struct Stem {
 
 	void ReportStatus(const SupervisorNode& node) const;
 
+	void ReportExit(const SupervisorNode& node) const;
+
 	void Log(std::string_view type, const char* format, va_list args) const;
 
 	void LogDebug(const char* format, ...) const __attribute__((format(printf, 2, 3)));
@@ -604,6 +607,20 @@ size_t Supervisor::ProcessMessages()
 			if ( it != nodes.end() )
 				it->second.pid = std::stoi(msg_tokens[2]);
 			}
+		else if ( type == "exit" )
+			{
+			const auto& name = msg_tokens[1];
+			auto it = nodes.find(name);
+
+			if ( it != nodes.end() )
+				{
+				auto& node = it->second;
+				node.pid = 0;
+				node.exit_status = std::stoi(msg_tokens[2]);
+				node.signal_number = std::stoi(msg_tokens[3]);
+				node.finished = true;
+				}
+			}
 		else if ( type == "debug" )
 			{
 			// Already logged the unparsed message above.
@@ -661,7 +678,8 @@ void Stem::Reap()
 		if ( ! node.pid )
 			continue;
 
-		Wait(&node, WNOHANG);
+		if ( Wait(&node, WNOHANG) && node.finished )
+			ReportExit(node);
 		}
 	}
 
@@ -694,7 +712,7 @@ bool Stem::Wait(SupervisorNode* node, int options) const
 		DBG_STEM("node '%s' (PID %d) exited with status %d",
 		         node->Name().data(), node->pid, node->exit_status);
 
-		if ( ! node->killed )
+		if ( ! node->killed && ! node->config.pcap_file )
 			LogError("Supervised node '%s' (PID %d) exited prematurely with status %d",
 			         node->Name().data(), node->pid, node->exit_status);
 		}
@@ -712,6 +730,11 @@ bool Stem::Wait(SupervisorNode* node, int options) const
 		LogError("Stem failed to get node exit status '%s' (PID %d)",
 		         node->Name().data(), node->pid);
 
+	// Reviving a node that read a trace file would process the trace
+	// again, whether it finished or crashed.
+	if ( node->config.pcap_file && ! node->killed )
+		node->finished = true;
+
 	node->pid = 0;
 	node->stdout_pipe.Drain();
 	node->stderr_pipe.Drain();
@@ -787,6 +810,9 @@ std::optional<SupervisedNode> Stem::Revive()
 		auto& node = n.second;
 		auto time_since_spawn = now - node.spawn_time;
 
+		if ( node.finished )
+			continue;
+
 		if ( node.pid )
 			{
 			if ( time_since_spawn > revival_reset )
@@ -848,6 +874,10 @@ std::variant<bool, SupervisedNode> Stem::Spawn(SupervisorNode* node)
 		}
 
 	node->pid = node_pid;
+	node->killed = false;
+	node->finished = false;
+	node->exit_status = 0;
+	node->signal_number = 0;
 	auto prefix = util::fmt("[%s] ", node->Name().data());
 	node->stdout_pipe.pipe = std::move(fork_res.stdout_pipe);
 	node->stdout_pipe.prefix = prefix;
@@ -930,6 +960,13 @@ void Stem::ReportStatus(const SupervisorNode& node) const
 	util::safe_write(pipe->OutFD(), msg.data(), msg.size() + 1);
 	}
 
+void Stem::ReportExit(const SupervisorNode& node) const
+	{
+	std::string msg = util::fmt("exit %s %d %d", node.Name().data(),
+	                            node.exit_status, node.signal_number);
+	util::safe_write(pipe->OutFD(), msg.data(), msg.size() + 1);
+	}
+
 void Stem::Log(std::string_view type, const char* format, va_list args) const
 	{
 	auto raw_msg = util::vfmt(format, args);
@@ -1231,6 +1268,11 @@ Supervisor::NodeConfig Supervisor::NodeConfig::FromRecord(const RecordVal* node)
 	if ( iface_val )
 		rval.interface = iface_val->AsString()->CheckString();
 
+	const auto& pcap_file_val = node->GetField("pcap_file");
+
+	if ( pcap_file_val )
+		rval.pcap_file = pcap_file_val->AsString()->CheckString();
+
 	const auto& directory_val = node->GetField("directory");
 
 	if ( directory_val )
@@ -1298,6 +1340,9 @@ Supervisor::NodeConfig Supervisor::NodeConfig::FromJSON(std::string_view json)
 	if ( auto it = j.FindMember("interface"); it != j.MemberEnd() )
 		rval.interface = it->value.GetString();
 
+	if ( auto it = j.FindMember("pcap_file"); it != j.MemberEnd() )
+		rval.pcap_file = it->value.GetString();
+
 	if ( auto it = j.FindMember("directory"); it != j.MemberEnd() )
 		rval.directory = it->value.GetString();
 
@@ -1354,6 +1399,9 @@ RecordValPtr Supervisor::NodeConfig::ToRecord() const
 	if ( interface )
 		rval->Assign(rt->FieldOffset("interface"), make_intrusive<StringVal>(*interface));
 
+	if ( pcap_file )
+		rval->Assign(rt->FieldOffset("pcap_file"), make_intrusive<StringVal>(*pcap_file));
+
 	if ( directory )
 		rval->Assign(rt->FieldOffset("directory"), make_intrusive<StringVal>(*directory));
 
@@ -1409,6 +1457,10 @@ RecordValPtr SupervisorNode::ToRecord() const
 	if ( pid )
 		rval->Assign(rt->FieldOffset("pid"), val_mgr->Int(pid));
 
+	if ( finished )
+		rval->Assign(rt->FieldOffset("exit_status"),
+		             val_mgr->Int(signal_number ? 128 + signal_number : exit_status));
+
 	return rval;
 	}
 
@@ -1551,6 +1603,9 @@ void SupervisedNode::Init(Options* options) const
 	if ( config.interface )
 		options->interface = *config.interface;
 
+	if ( config.pcap_file )
+		options->pcap_file = *config.pcap_file;
+
 	for ( const auto& s : config.scripts )
 		options->scripts_to_load.emplace_back(s);
 	}
@@ -1617,9 +1672,23 @@ std::string Supervisor::Create(const Supervisor::NodeConfig& node)
 			                       node.directory->data());
 		}
 
-	auto msg = make_create_message(node);
+	auto config = node;
+
+	// The node may run in a different working directory.
+	if ( config.pcap_file && ! config.pcap_file->empty() &&
+	     (*config.pcap_file)[0] != '/' )
+		{
+		char cwd[PATH_MAX];
+
+		if ( ! getcwd(cwd, sizeof(cwd)) )
+			return util::fmt("failed to get current directory: %s", strerror(errno));
+
+		config.pcap_file = std::string(cwd) + "/" + *config.pcap_file;
+		}
+
+	auto msg = make_create_message(config);
 	util::safe_write(stem_pipe->OutFD(), msg.data(), msg.size() + 1);
-	nodes.emplace(node.name, node);
+	nodes.emplace(config.name, std::move(config));
 	return "";
 	}
 
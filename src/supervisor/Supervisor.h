@@ -170,6 +170,12 @@ public:
 		 * The interface name from which the node should read/analyze packets.
 		 */
 		std::optional<std::string> interface;
+		/**
+		 * A trace file the node should read instead of sniffing an
+		 * interface.  The node terminates once it has processed the trace
+		 * and isn't revived.
+		 */
+		std::optional<std::string> pcap_file;
 		/**
 		 * The working directory that should be used by the node.
 		 */
@@ -426,6 +432,11 @@ struct SupervisorNode {
 	 * The last signal which terminated the node.
 	 */
 	int signal_number = 0;
+	/**
+	 * Whether the node read a trace file and terminated.  Such nodes
+	 * aren't revived.
+	 */
+	bool finished = false;
 	/**
 	 * Number of process revival attempts made after the node first died
 	 * prematurely.
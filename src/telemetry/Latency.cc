@@ -0,0 +1,131 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Latency.h"
+
+#include <chrono>
+
+#include "telemetry/Manager.h"
+#include "analyzer/Analyzer.h"
+
+namespace zeek::telemetry {
+
+namespace detail {
+
+bool track_latency = false;
+double seconds_per_tick = 1e-9;
+Histogram* stage_latency[static_cast<int>(Stage::NUM_STAGES)];
+
+struct AnalyzerHistogram {
+	std::string name;
+	Histogram* histogram = nullptr;
+};
+
+// Indexed by analyzer tag, for packet and stream input respectively.
+static std::vector<AnalyzerHistogram> analyzer_latency[2];
+
+} // namespace detail
+
+static const char* stage_names[] = {
+	"packet_source",
+	"link_layer",
+	"sessions",
+	"connection",
+	"event_drain",
+};
+
+static_assert(sizeof(stage_names) / sizeof(stage_names[0]) ==
+              static_cast<size_t>(Stage::NUM_STAGES));
+
+// From 100ns, where reading the counters starts to dominate, up to
+// 100ms, where a worker would be falling behind anyway.
+static const std::vector<double> latency_bounds = {
+	1e-7, 2.5e-7, 5e-7,
+	1e-6, 2.5e-6, 5e-6,
+	1e-5, 2.5e-5, 5e-5,
+	1e-4, 2.5e-4, 5e-4,
+	1e-3, 1e-2, 1e-1,
+};
+
+// Measures the rate of the time stamp counter against the system clock.
+// That assumes a constant rate, which all x86 CPUs of the last decade
+// provide.
+static double calibrate()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+	using clock = std::chrono::steady_clock;
+
+	auto t0 = clock::now();
+	auto c0 = detail::Ticks();
+	auto t1 = t0;
+
+	while ( t1 - t0 < std::chrono::milliseconds(10) )
+		t1 = clock::now();
+
+	auto c1 = detail::Ticks();
+	std::chrono::duration<double> elapsed = t1 - t0;
+
+	if ( c1 > c0 )
+		return elapsed.count() / (c1 - c0);
+#endif
+
+	return 1e-9;
+	}
+
+Histogram* detail::AnalyzerLatency(const analyzer::Analyzer* a, bool stream)
+	{
+	auto& histograms = analyzer_latency[stream];
+	auto type = a->GetAnalyzerTag().Type();
+
+	if ( type >= histograms.size() )
+		histograms.resize(type + 1);
+
+	auto& ah = histograms[type];
+
+	if ( ! ah.histogram )
+		{
+		ah.name = a->GetAnalyzerName();
+		ah.histogram = telemetry_mgr->HistogramInstance(
+			"zeek_analyzer_latency_seconds",
+			"Time analyzers take for an input, including their children.",
+			latency_bounds,
+			{{"analyzer", ah.name}, {"input", stream ? "stream" : "packet"}});
+		}
+
+	return ah.histogram;
+	}
+
+void EnableLatencyTracking()
+	{
+	if ( detail::track_latency )
+		return;
+
+	for ( int i = 0; i < static_cast<int>(Stage::NUM_STAGES); ++i )
+		detail::stage_latency[i] = telemetry_mgr->HistogramInstance(
+			"zeek_stage_latency_seconds",
+			"Time spent in stages of packet processing, including nested ones.",
+			latency_bounds, {{"stage", stage_names[i]}});
+
+	detail::seconds_per_tick = calibrate();
+	detail::track_latency = true;
+	}
+
+std::vector<LatencyHistogram> LatencyHistograms()
+	{
+	std::vector<LatencyHistogram> rval;
+
+	if ( ! detail::track_latency )
+		return rval;
+
+	for ( int i = 0; i < static_cast<int>(Stage::NUM_STAGES); ++i )
+		rval.push_back({stage_names[i], "", detail::stage_latency[i]});
+
+	for ( int stream = 0; stream < 2; ++stream )
+		for ( const auto& ah : detail::analyzer_latency[stream] )
+			if ( ah.histogram )
+				rval.push_back({stream ? "analyzer_stream" : "analyzer_packet",
+				                ah.name, ah.histogram});
+
+	return rval;
+	}
+
+} // namespace zeek::telemetry
@@ -0,0 +1,139 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "telemetry/Metrics.h"
+
+namespace zeek::analyzer { class Analyzer; }
+
+namespace zeek::telemetry {
+
+/**
+ * The stages of packet processing whose latency is tracked. A stage's
+ * time includes that of the stages it calls into.
+ */
+enum class Stage {
+	PacketSource,	// PktSrc::Process(), dispatching a packet
+	LinkLayer,	// Packet::ProcessLayer2()
+	Sessions,	// NetSessions::NextPacket()
+	Connection,	// Connection::NextPacket()
+	EventDrain,	// EventMgr::Drain(), including script handlers
+	NUM_STAGES
+};
+
+namespace detail {
+
+extern bool track_latency;
+extern double seconds_per_tick;
+extern Histogram* stage_latency[static_cast<int>(Stage::NUM_STAGES)];
+
+/**
+ * Returns a timestamp in an unspecified unit; see seconds_per_tick. This
+ * is the time stamp counter where available, which is considerably
+ * cheaper to read than the system clock.
+ */
+inline uint64_t Ticks()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+	}
+
+Histogram* AnalyzerLatency(const analyzer::Analyzer* a, bool stream);
+
+} // namespace detail
+
+/**
+ * Returns the histogram tracking the latency of a stage, or null if
+ * latency tracking is disabled.
+ */
+inline Histogram* StageLatency(Stage s)
+	{
+	if ( ! detail::track_latency )
+		return nullptr;
+
+	return detail::stage_latency[static_cast<int>(s)];
+	}
+
+/**
+ * Returns the histogram tracking the latency of an analyzer's packet or
+ * stream input, or null if latency tracking is disabled. The time
+ * includes that of the support and child analyzers it forwards to.
+ */
+inline Histogram* AnalyzerLatency(const analyzer::Analyzer* a, bool stream)
+	{
+	if ( ! detail::track_latency )
+		return nullptr;
+
+	return detail::AnalyzerLatency(a, stream);
+	}
+
+/**
+ * Observes the time from its construction to its destruction into a
+ * histogram, if given one.
+ */
+class LatencyTimer {
+public:
+	explicit LatencyTimer(Histogram* arg_histogram)
+		: histogram(arg_histogram), start(histogram ? detail::Ticks() : 0)
+		{}
+
+	~LatencyTimer()
+		{
+		if ( ! histogram )
+			return;
+
+		// The counters of different cores may be slightly off.
+		uint64_t end = detail::Ticks();
+		histogram->Observe(end > start ? (end - start) * detail::seconds_per_tick : 0.0);
+		}
+
+	/**
+	 * Discards the measurement, for when there turned out to be nothing
+	 * to time.
+	 */
+	void Cancel()	{ histogram = nullptr; }
+
+	LatencyTimer(const LatencyTimer&) = delete;
+	LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+private:
+	Histogram* histogram;
+	uint64_t start;
+};
+
+/**
+ * A latency histogram, for get_latency_stats().
+ */
+struct LatencyHistogram {
+	std::string stage;
+	std::string analyzer;	// empty for stages other than analyzers'
+	const Histogram* histogram;
+};
+
+/**
+ * Enables latency tracking, registering the stage histograms with the
+ * telemetry manager. Called from Manager::InitPostScript() if configured.
+ */
+void EnableLatencyTracking();
+
+/**
+ * @return All latency histograms created so far, or an empty vector if
+ * latency tracking is disabled.
+ */
+std::vector<LatencyHistogram> LatencyHistograms();
+
+} // namespace zeek::telemetry
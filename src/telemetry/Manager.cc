@@ -0,0 +1,755 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Manager.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Event.h"
+#include "ID.h"
+#include "ObjectPool.h"
+#include "Reassem.h"
+#include "Reporter.h"
+#include "Sessions.h"
+#include "Timer.h"
+#include "Val.h"
+#include "util.h"
+#include "iosource/Manager.h"
+#include "iosource/PktSrc.h"
+#include "threading/Manager.h"
+#include "telemetry/Latency.h"
+
+namespace zeek::telemetry {
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Bounds on what the HTTP endpoint accepts.
+static constexpr size_t MAX_CLIENTS = 16;
+static constexpr size_t MAX_REQUEST_SIZE = 8192;
+
+// Seconds after which a client that neither completed its request nor
+// accepted any of the response gets disconnected, so that idle
+// connections can't hold on to all MAX_CLIENTS slots.
+static constexpr double CLIENT_TIMEOUT = 10.0;
+
+static const char* type_name(MetricType t)
+	{
+	switch ( t ) {
+	case MetricType::Counter: return "counter";
+	case MetricType::Gauge: return "gauge";
+	case MetricType::Histogram: return "histogram";
+	}
+
+	return "untyped";
+	}
+
+// Formats a floating point value with as few digits as needed to
+// read it back unchanged.
+static void append_double(std::string* out, double d)
+	{
+	char buf[64];
+
+	if ( std::isinf(d) )
+		{
+		out->append(d > 0 ? "+Inf" : "-Inf");
+		return;
+		}
+
+	if ( std::isnan(d) )
+		{
+		out->append("NaN");
+		return;
+		}
+
+	for ( int precision = 15; precision <= 17; ++precision )
+		{
+		snprintf(buf, sizeof(buf), "%.*g", precision, d);
+
+		if ( strtod(buf, nullptr) == d )
+			break;
+		}
+
+	out->append(buf);
+	}
+
+static void append_count(std::string* out, uint64_t c)
+	{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%" PRIu64, c);
+	out->append(buf);
+	}
+
+static void append_labels(std::string* out, const Labels& labels,
+                          const char* le = nullptr)
+	{
+	if ( labels.empty() && ! le )
+		return;
+
+	out->push_back('{');
+
+	bool first = true;
+
+	auto append_label = [&](const std::string& name, const std::string& value)
+		{
+		if ( ! first )
+			out->push_back(',');
+
+		first = false;
+		out->append(name);
+		out->append("=\"");
+
+		for ( auto c : value )
+			{
+			if ( c == '\\' || c == '"' )
+				{
+				out->push_back('\\');
+				out->push_back(c);
+				}
+			else if ( c == '\n' )
+				out->append("\\n");
+			else
+				out->push_back(c);
+			}
+
+		out->push_back('"');
+		};
+
+	for ( const auto& [name, value] : labels )
+		append_label(name, value);
+
+	if ( le )
+		append_label("le", le);
+
+	out->push_back('}');
+	}
+
+Manager::Manager() : iosource::IOSource()
+	{
+	iosource_mgr->Register(this, true);
+	}
+
+Manager::~Manager()
+	{
+	for ( const auto& c : clients )
+		close(c.first);
+
+	if ( listen_fd >= 0 )
+		close(listen_fd);
+	}
+
+void Manager::InitPostScript()
+	{
+	RegisterCoreMetrics();
+
+	if ( const auto& track_latency = id::find_val("Telemetry::track_latency");
+	     track_latency && track_latency->AsBool() )
+		EnableLatencyTracking();
+
+	const auto& port_val = id::find_val("Telemetry::metrics_port");
+	const auto& addr_val = id::find_val("Telemetry::metrics_address");
+
+	if ( ! (port_val && addr_val) )
+		return;
+
+	auto port = port_val->AsPortVal()->Port();
+
+	if ( port == 0 )
+		return;
+
+	Listen(addr_val->AsStringVal()->ToStdString(), port);
+	}
+
+Manager::Family* Manager::GetFamily(const std::string& name, const std::string& help,
+                                    MetricType type)
+	{
+	auto [it, inserted] = families.try_emplace(name);
+	auto& f = it->second;
+
+	if ( inserted )
+		{
+		f.help = help;
+		f.type = type;
+		}
+
+	else if ( f.type != type )
+		reporter->InternalError("metric %s registered with different types", name.c_str());
+
+	return &f;
+	}
+
+Counter* Manager::CounterInstance(const std::string& name, const std::string& help,
+                                  const Labels& labels)
+	{
+	std::lock_guard<std::mutex> lock(mtx);
+	auto& c = GetFamily(name, help, MetricType::Counter)->counters[labels];
+
+	if ( ! c )
+		c = std::make_unique<Counter>();
+
+	return c.get();
+	}
+
+Gauge* Manager::GaugeInstance(const std::string& name, const std::string& help,
+                              const Labels& labels)
+	{
+	std::lock_guard<std::mutex> lock(mtx);
+	auto& g = GetFamily(name, help, MetricType::Gauge)->gauges[labels];
+
+	if ( ! g )
+		g = std::make_unique<Gauge>();
+
+	return g.get();
+	}
+
+Histogram* Manager::HistogramInstance(const std::string& name, const std::string& help,
+                                      const std::vector<double>& bounds,
+                                      const Labels& labels)
+	{
+	std::lock_guard<std::mutex> lock(mtx);
+	auto f = GetFamily(name, help, MetricType::Histogram);
+
+	if ( f->histograms.empty() )
+		f->bounds = bounds;
+
+	auto& h = f->histograms[labels];
+
+	if ( ! h )
+		h = std::make_unique<Histogram>(f->bounds);
+
+	return h.get();
+	}
+
+void Manager::AddCallback(const std::string& name, const std::string& help,
+                          MetricType type, Callback cb)
+	{
+	if ( type == MetricType::Histogram )
+		reporter->InternalError("histogram metrics cannot use callbacks");
+
+	std::lock_guard<std::mutex> lock(mtx);
+	GetFamily(name, help, type)->callbacks.emplace_back(std::move(cb));
+	}
+
+std::string Manager::Collect()
+	{
+	std::lock_guard<std::mutex> lock(mtx);
+	std::string out;
+	Samples samples;
+	std::vector<uint64_t> counts;
+
+	for ( const auto& [name, f] : families )
+		{
+		out.append("# HELP ");
+		out.append(name);
+		out.push_back(' ');
+		out.append(f.help);
+		out.append("\n# TYPE ");
+		out.append(name);
+		out.push_back(' ');
+		out.append(type_name(f.type));
+		out.push_back('\n');
+
+		for ( const auto& [labels, c] : f.counters )
+			{
+			out.append(name);
+			append_labels(&out, labels);
+			out.push_back(' ');
+			append_count(&out, c->Value());
+			out.push_back('\n');
+			}
+
+		for ( const auto& [labels, g] : f.gauges )
+			{
+			out.append(name);
+			append_labels(&out, labels);
+			out.push_back(' ');
+			append_double(&out, g->Value());
+			out.push_back('\n');
+			}
+
+		for ( const auto& [labels, h] : f.histograms )
+			{
+			double sum;
+			h->Collect(&counts, &sum);
+
+			uint64_t cumulative = 0;
+
+			for ( size_t i = 0; i < counts.size(); ++i )
+				{
+				std::string le;
+
+				if ( i < h->Bounds().size() )
+					append_double(&le, h->Bounds()[i]);
+				else
+					le = "+Inf";
+
+				cumulative += counts[i];
+				out.append(name);
+				out.append("_bucket");
+				append_labels(&out, labels, le.c_str());
+				out.push_back(' ');
+				append_count(&out, cumulative);
+				out.push_back('\n');
+				}
+
+			out.append(name);
+			out.append("_sum");
+			append_labels(&out, labels);
+			out.push_back(' ');
+			append_double(&out, sum);
+			out.push_back('\n');
+
+			out.append(name);
+			out.append("_count");
+			append_labels(&out, labels);
+			out.push_back(' ');
+			append_count(&out, cumulative);
+			out.push_back('\n');
+			}
+
+		for ( const auto& cb : f.callbacks )
+			{
+			samples.clear();
+			cb(&samples);
+
+			for ( const auto& [labels, v] : samples )
+				{
+				out.append(name);
+				append_labels(&out, labels);
+				out.push_back(' ');
+				append_double(&out, v);
+				out.push_back('\n');
+				}
+			}
+		}
+
+	return out;
+	}
+
+void Manager::RegisterCoreMetrics()
+	{
+	AddCallback("zeek_packets_received_total",
+	            "Packets received by the packet source.",
+	            MetricType::Counter,
+	            [](Samples* samples)
+		{
+		if ( auto ps = iosource_mgr->GetPktSrc() )
+			{
+			iosource::PktSrc::Stats s;
+			ps->Statistics(&s);
+			samples->push_back({{}, double(s.received)});
+			}
+		});
+
+	AddCallback("zeek_packets_dropped_total",
+	            "Packets the packet source reported as dropped.",
+	            MetricType::Counter,
+	            [](Samples* samples)
+		{
+		if ( auto ps = iosource_mgr->GetPktSrc() )
+			{
+			iosource::PktSrc::Stats s;
+			ps->Statistics(&s);
+			samples->push_back({{}, double(s.dropped)});
+			}
+		});
+
+	AddCallback("zeek_connections_active",
+	            "Connections currently tracked, by transport protocol.",
+	            MetricType::Gauge,
+	            [](Samples* samples)
+		{
+		if ( ! sessions )
+			return;
+
+		SessionStats s;
+		sessions->GetStats(s);
+		samples->push_back({{{"protocol", "tcp"}}, double(s.num_TCP_conns)});
+		samples->push_back({{{"protocol", "udp"}}, double(s.num_UDP_conns)});
+		samples->push_back({{{"protocol", "icmp"}}, double(s.num_ICMP_conns)});
+		});
+
+	AddCallback("zeek_connections_total",
+	            "Connections seen, by transport protocol.",
+	            MetricType::Counter,
+	            [](Samples* samples)
+		{
+		if ( ! sessions )
+			return;
+
+		SessionStats s;
+		sessions->GetStats(s);
+		samples->push_back({{{"protocol", "tcp"}}, double(s.cumulative_TCP_conns)});
+		samples->push_back({{{"protocol", "udp"}}, double(s.cumulative_UDP_conns)});
+		samples->push_back({{{"protocol", "icmp"}}, double(s.cumulative_ICMP_conns)});
+		});
+
+	AddCallback("zeek_event_queue_length",
+	            "Events queued but not yet dispatched.",
+	            MetricType::Gauge,
+	            [](Samples* samples)
+		{
+		samples->push_back({{}, double(event_mgr.Size())});
+		});
+
+	AddCallback("zeek_events_queued_total",
+	            "Events queued for dispatch.",
+	            MetricType::Counter,
+	            [](Samples* samples)
+		{
+		samples->push_back({{}, double(event_mgr.num_events_queued)});
+		});
+
+	AddCallback("zeek_timers_pending",
+	            "Timers currently scheduled, by type.",
+	            MetricType::Gauge,
+	            [](Samples* samples)
+		{
+		auto current = zeek::detail::TimerMgr::CurrentTimers();
+
+		for ( int i = 0; i < zeek::detail::NUM_TIMER_TYPES; ++i )
+			{
+			auto name = zeek::detail::timer_type_to_string(static_cast<zeek::detail::TimerType>(i));
+			samples->push_back({{{"type", name}}, double(current[i])});
+			}
+		});
+
+	AddCallback("zeek_timers_total",
+	            "Timers scheduled.",
+	            MetricType::Counter,
+	            [](Samples* samples)
+		{
+		if ( zeek::detail::timer_mgr )
+			samples->push_back({{}, double(zeek::detail::timer_mgr->CumulativeNum())});
+		});
+
+	AddCallback("zeek_reassembly_bytes",
+	            "Memory held by reassemblers, by type.",
+	            MetricType::Gauge,
+	            [](Samples* samples)
+		{
+		static const std::pair<ReassemblerType, const char*> types[] = {
+			{REASSEM_TCP, "tcp"},
+			{REASSEM_FRAG, "frag"},
+			{REASSEM_FILE, "file"},
+			{REASSEM_UNKNOWN, "unknown"},
+		};
+
+		for ( const auto& [t, name] : types )
+			samples->push_back({{{"type", name}}, double(Reassembler::MemoryAllocation(t))});
+		});
+
+	AddCallback("zeek_object_pool_allocations_total",
+	            "Objects allocated by pooled classes, by class and by whether the memory came from the pool.",
+	            MetricType::Counter,
+	            [](Samples* samples)
+		{
+		for ( const auto* pool : zeek::detail::ObjectPool::Pools() )
+			{
+			samples->push_back({{{"class", pool->Name()}, {"source", "heap"}}, double(pool->NumAllocated())});
+			samples->push_back({{{"class", pool->Name()}, {"source", "pool"}}, double(pool->NumReused())});
+			}
+		});
+
+	AddCallback("zeek_object_pool_free",
+	            "Free objects kept by the pools, by class.",
+	            MetricType::Gauge,
+	            [](Samples* samples)
+		{
+		for ( const auto* pool : zeek::detail::ObjectPool::Pools() )
+			samples->push_back({{{"class", pool->Name()}}, double(pool->NumFree())});
+		});
+
+	AddCallback("zeek_thread_queue_length",
+	            "Messages pending between the main thread and other threads.",
+	            MetricType::Gauge,
+	            [](Samples* samples)
+		{
+		if ( ! thread_mgr )
+			return;
+
+		for ( const auto& [name, s] : thread_mgr->GetMsgThreadStats() )
+			{
+			samples->push_back({{{"thread", name}, {"direction", "in"}}, double(s.pending_in)});
+			samples->push_back({{{"thread", name}, {"direction", "out"}}, double(s.pending_out)});
+			}
+		});
+
+	AddCallback("zeek_memory_bytes",
+	            "Memory used by the process.",
+	            MetricType::Gauge,
+	            [](Samples* samples)
+		{
+		uint64_t total;
+		util::get_memory_usage(&total, nullptr);
+		samples->push_back({{}, double(total)});
+		});
+
+	AddCallback("zeek_metrics_requests_total",
+	            "Requests served by the metrics endpoint.",
+	            MetricType::Counter,
+	            [this](Samples* samples)
+		{
+		samples->push_back({{}, double(requests_served)});
+		});
+	}
+
+bool Manager::Listen(const std::string& addr, uint16_t port)
+	{
+	struct addrinfo hints;
+	struct addrinfo* res = nullptr;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICHOST | AI_PASSIVE;
+
+	auto port_str = std::to_string(port);
+	int rc = getaddrinfo(addr.empty() ? nullptr : addr.c_str(), port_str.c_str(),
+	                     &hints, &res);
+
+	if ( rc != 0 )
+		{
+		reporter->Error("invalid metrics endpoint address %s: %s",
+		                addr.c_str(), gai_strerror(rc));
+		return false;
+		}
+
+	listen_fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+
+	if ( listen_fd < 0 )
+		{
+		reporter->Error("cannot create metrics endpoint socket: %s", strerror(errno));
+		freeaddrinfo(res);
+		return false;
+		}
+
+	int on = 1;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	if ( bind(listen_fd, res->ai_addr, res->ai_addrlen) < 0 ||
+	     listen(listen_fd, MAX_CLIENTS) < 0 ||
+	     fcntl(listen_fd, F_SETFL, O_NONBLOCK) < 0 )
+		{
+		reporter->Error("cannot serve metrics on %s:%s: %s",
+		                addr.c_str(), port_str.c_str(), strerror(errno));
+		close(listen_fd);
+		listen_fd = -1;
+		freeaddrinfo(res);
+		return false;
+		}
+
+	freeaddrinfo(res);
+
+	if ( ! iosource_mgr->RegisterFd(listen_fd, this) )
+		{
+		close(listen_fd);
+		listen_fd = -1;
+		return false;
+		}
+
+	return true;
+	}
+
+double Manager::GetNextTimeout()
+	{
+	if ( clients.empty() )
+		return -1;
+
+	double oldest = clients.begin()->second.last_active;
+
+	for ( const auto& c : clients )
+		oldest = std::min(oldest, c.second.last_active);
+
+	return std::max(0.0, oldest + CLIENT_TIMEOUT - util::current_time(true));
+	}
+
+void Manager::Process()
+	{
+	// We don't learn which of our descriptors became ready, so check
+	// them all; they are non-blocking.
+	if ( listen_fd >= 0 )
+		Accept();
+
+	double now = util::current_time(true);
+
+	for ( auto it = clients.begin(); it != clients.end(); )
+		{
+		int fd = it->first;
+		auto& c = it->second;
+		++it;
+
+		bool done = c.responding ? Flush(fd, &c) : Receive(fd, &c);
+
+		if ( done || now - c.last_active > CLIENT_TIMEOUT )
+			CloseClient(fd);
+		}
+	}
+
+void Manager::Accept()
+	{
+	for ( ;; )
+		{
+		int fd = accept(listen_fd, nullptr, nullptr);
+
+		if ( fd < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			return;
+			}
+
+		if ( clients.size() >= MAX_CLIENTS ||
+		     fcntl(fd, F_SETFL, O_NONBLOCK) < 0 ||
+		     ! iosource_mgr->RegisterFd(fd, this) )
+			{
+			close(fd);
+			continue;
+			}
+
+		clients[fd].last_active = util::current_time(true);
+		}
+	}
+
+bool Manager::Receive(int fd, Client* c)
+	{
+	char buf[1024];
+
+	for ( ;; )
+		{
+		ssize_t n = read(fd, buf, sizeof(buf));
+
+		if ( n > 0 )
+			{
+			c->request.append(buf, n);
+			c->last_active = util::current_time(true);
+
+			if ( c->request.find("\r\n\r\n") != std::string::npos ||
+			     c->request.find("\n\n") != std::string::npos ||
+			     c->request.size() > MAX_REQUEST_SIZE )
+				{
+				Serve(fd, c);
+				return Flush(fd, c);
+				}
+
+			continue;
+			}
+
+		if ( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+			return false;
+
+		if ( n < 0 && errno == EINTR )
+			continue;
+
+		// Closed by the client, or an error.
+		return true;
+		}
+	}
+
+void Manager::Serve(int fd, Client* c)
+	{
+	std::string status = "200 OK";
+	std::string body;
+
+	const auto& request = c->request;
+	auto eol = request.find_first_of("\r\n");
+	auto line = request.substr(0, eol);
+
+	if ( request.size() > MAX_REQUEST_SIZE )
+		status = "431 Request Header Fields Too Large";
+
+	else if ( line.compare(0, 4, "GET ") != 0 )
+		status = "405 Method Not Allowed";
+
+	else
+		{
+		auto path = line.substr(4, line.find(' ', 4) - 4);
+
+		if ( path == "/metrics" )
+			body = Collect();
+		else
+			status = "404 Not Found";
+		}
+
+	++requests_served;
+
+	auto& response = c->response;
+	response = "HTTP/1.1 " + status + "\r\n";
+	response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+	response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+	response += "Connection: close\r\n\r\n";
+	response += body;
+
+	c->request.clear();
+	c->responding = true;
+
+	// Anything further the client sends is ignored, so stop watching
+	// for it; otherwise unread input would keep waking us up.
+	iosource_mgr->UnregisterFd(fd, this);
+	}
+
+bool Manager::Flush(int fd, Client* c)
+	{
+	while ( c->sent < c->response.size() )
+		{
+		ssize_t n = send(fd, c->response.data() + c->sent,
+		                 c->response.size() - c->sent, MSG_NOSIGNAL);
+
+		if ( n < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			if ( errno != EAGAIN && errno != EWOULDBLOCK )
+				return true;
+
+			// Come back once the client has taken some of it.
+			if ( ! c->want_write )
+				{
+				c->want_write = iosource_mgr->RegisterFd(fd, this,
+				                                         iosource::Manager::WRITE);
+
+				if ( ! c->want_write )
+					return true;
+				}
+
+			return false;
+			}
+
+		c->sent += n;
+		c->last_active = util::current_time(true);
+		}
+
+	return true;
+	}
+
+void Manager::CloseClient(int fd)
+	{
+	auto& c = clients[fd];
+	int flags = 0;
+
+	if ( ! c.responding )
+		flags |= iosource::Manager::READ;
+
+	if ( c.want_write )
+		flags |= iosource::Manager::WRITE;
+
+	if ( flags )
+		iosource_mgr->UnregisterFd(fd, this, flags);
+
+	close(fd);
+	clients.erase(fd);
+	}
+
+} // namespace zeek::telemetry
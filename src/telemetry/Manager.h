@@ -0,0 +1,159 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "iosource/IOSource.h"
+#include "telemetry/Metrics.h"
+
+namespace zeek::telemetry {
+
+/**
+ * Label names and values identifying one metric within a family.
+ */
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+enum class MetricType { Counter, Gauge, Histogram };
+
+/**
+ * A registry of metrics, and a small HTTP server exposing them in the
+ * Prometheus text format.
+ *
+ * The core updates counters, gauges and histograms directly; creating
+ * them takes a lock, updating them doesn't. Values that the core keeps
+ * anyway, like the number of pending timers, are instead read by
+ * callbacks at the time metrics are collected.
+ *
+ * The server is an IOSource in the main loop, so collecting the metrics
+ * doesn't race with the main thread, and doesn't involve any script code.
+ */
+class Manager : public iosource::IOSource {
+public:
+	/**
+	 * Label sets and values of the metrics within a family.
+	 */
+	using Samples = std::vector<std::pair<Labels, double>>;
+
+	/**
+	 * Callback filling in the current values of a family of metrics.
+	 * Runs in the main thread, and must not create metrics itself.
+	 */
+	using Callback = std::function<void(Samples*)>;
+
+	Manager();
+	~Manager() override;
+
+	/**
+	 * Registers the core metrics and starts the HTTP endpoint if
+	 * configured by the script-layer.
+	 */
+	void InitPostScript();
+
+	/**
+	 * Returns a counter, creating it on first use. The returned pointer
+	 * remains valid for the lifetime of the manager.
+	 *
+	 * @param name  The name of the metric family, which should end in
+	 * ``_total``.
+	 *
+	 * @param help  A description of the family.
+	 *
+	 * @param labels  Identifies the metric within its family.
+	 */
+	Counter* CounterInstance(const std::string& name, const std::string& help,
+	                         const Labels& labels = {});
+
+	/**
+	 * Returns a gauge, creating it on first use. See CounterInstance().
+	 */
+	Gauge* GaugeInstance(const std::string& name, const std::string& help,
+	                     const Labels& labels = {});
+
+	/**
+	 * Returns a histogram, creating it on first use. See
+	 * CounterInstance().
+	 *
+	 * @param bounds  The upper bounds of the buckets. Only used when
+	 * creating the family; all histograms in a family share its buckets.
+	 */
+	Histogram* HistogramInstance(const std::string& name, const std::string& help,
+	                             const std::vector<double>& bounds,
+	                             const Labels& labels = {});
+
+	/**
+	 * Adds a family of metrics whose values are read by a callback.
+	 */
+	void AddCallback(const std::string& name, const std::string& help,
+	                 MetricType type, Callback cb);
+
+	/**
+	 * Returns all metrics in the Prometheus text exposition format.
+	 */
+	std::string Collect();
+
+	/**
+	 * @return The number of requests the HTTP endpoint served.
+	 */
+	uint64_t RequestsServed() const	{ return requests_served; }
+
+	// IOSource interface.
+	double GetNextTimeout() override;
+	void Process() override;
+	const char* Tag() override	{ return "Telemetry::Manager"; }
+
+private:
+	struct Family {
+		std::string help;
+		MetricType type;
+		std::vector<double> bounds;
+		std::map<Labels, std::unique_ptr<Counter>> counters;
+		std::map<Labels, std::unique_ptr<Gauge>> gauges;
+		std::map<Labels, std::unique_ptr<Histogram>> histograms;
+		std::vector<Callback> callbacks;
+	};
+
+	Family* GetFamily(const std::string& name, const std::string& help,
+	                  MetricType type);
+	void RegisterCoreMetrics();
+
+	// A connection to the HTTP endpoint. Sockets stay non-blocking; a
+	// response that doesn't fit into the socket buffer is kept here and
+	// sent as the client becomes writable.
+	struct Client {
+		std::string request;
+		std::string response;
+		size_t sent = 0;
+		bool responding = false;
+		bool want_write = false;
+		double last_active = 0;
+	};
+
+	bool Listen(const std::string& addr, uint16_t port);
+	void Accept();
+	bool Receive(int fd, Client* c);
+	void Serve(int fd, Client* c);
+	bool Flush(int fd, Client* c);
+	void CloseClient(int fd);
+
+	std::mutex mtx;
+	std::map<std::string, Family> families;
+
+	int listen_fd = -1;
+	std::map<int, Client> clients;
+	uint64_t requests_served = 0;
+};
+
+} // namespace zeek::telemetry
+
+namespace zeek {
+
+extern telemetry::Manager* telemetry_mgr;
+
+} // namespace zeek
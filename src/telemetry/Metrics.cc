@@ -0,0 +1,61 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Metrics.h"
+
+#include <algorithm>
+
+namespace zeek::telemetry {
+
+uint64_t Counter::Value() const
+	{
+	uint64_t total = 0;
+
+	for ( const auto& c : cells )
+		total += c.value.load(std::memory_order_relaxed);
+
+	return total;
+	}
+
+Histogram::Histogram(std::vector<double> arg_bounds)
+	: bounds(std::move(arg_bounds))
+	{
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+	for ( auto& s : shards )
+		{
+		s.counts.reset(new std::atomic<uint64_t>[bounds.size() + 1]);
+
+		for ( size_t i = 0; i <= bounds.size(); ++i )
+			s.counts[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+void Histogram::Observe(double value)
+	{
+	// Buckets include their upper bound.
+	size_t idx = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+	Shard& s = shards[detail::ShardIndex()];
+
+	s.counts[idx].fetch_add(1, std::memory_order_relaxed);
+
+	double sum = s.sum.load(std::memory_order_relaxed);
+	while ( ! s.sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed) )
+		;
+	}
+
+void Histogram::Collect(std::vector<uint64_t>* counts, double* sum) const
+	{
+	counts->assign(bounds.size() + 1, 0);
+	*sum = 0;
+
+	for ( const auto& s : shards )
+		{
+		for ( size_t i = 0; i <= bounds.size(); ++i )
+			(*counts)[i] += s.counts[i].load(std::memory_order_relaxed);
+
+		*sum += s.sum.load(std::memory_order_relaxed);
+		}
+	}
+
+} // namespace zeek::telemetry
@@ -0,0 +1,123 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace zeek::telemetry {
+
+namespace detail {
+
+// Counters and histograms spread their updates over several cells, one
+// per thread (modulo the number of cells), so that threads updating the
+// same metric don't contend for a cache line. Reading a metric sums up
+// all cells.
+constexpr int NUM_SHARDS = 8;
+
+struct alignas(64) Cell {
+	std::atomic<uint64_t> value{0};
+};
+
+/**
+ * Returns the index of the cell the calling thread updates.
+ */
+inline int ShardIndex()
+	{
+	static std::atomic<unsigned int> next_shard{0};
+	thread_local int shard = next_shard++ % NUM_SHARDS;
+	return shard;
+	}
+
+} // namespace detail
+
+/**
+ * A monotonically increasing count. Updates are lock-free and may come
+ * from any thread.
+ */
+class Counter {
+public:
+	/**
+	 * Increments the counter.
+	 *
+	 * @param amount  The value to add.
+	 */
+	void Inc(uint64_t amount = 1)
+		{
+		cells[detail::ShardIndex()].value.fetch_add(amount, std::memory_order_relaxed);
+		}
+
+	/**
+	 * @return The current count.
+	 */
+	uint64_t Value() const;
+
+private:
+	detail::Cell cells[detail::NUM_SHARDS];
+};
+
+/**
+ * A value that can go up and down, like a queue length.
+ */
+class Gauge {
+public:
+	void Set(int64_t v)	{ value.store(v, std::memory_order_relaxed); }
+	void Inc(int64_t amount = 1)	{ value.fetch_add(amount, std::memory_order_relaxed); }
+	void Dec(int64_t amount = 1)	{ value.fetch_sub(amount, std::memory_order_relaxed); }
+
+	int64_t Value() const	{ return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> value{0};
+};
+
+/**
+ * Counts observations into buckets with fixed upper bounds, and keeps
+ * their sum. Like counters, updates are lock-free and may come from any
+ * thread.
+ */
+class Histogram {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param bounds  The inclusive upper bounds of the buckets, in
+	 * increasing order. An additional bucket catches all larger values.
+	 */
+	explicit Histogram(std::vector<double> bounds);
+
+	/**
+	 * Records an observation.
+	 */
+	void Observe(double value);
+
+	/**
+	 * @return The upper bounds of the buckets, not including the final
+	 * one for all larger values.
+	 */
+	const std::vector<double>& Bounds() const	{ return bounds; }
+
+	/**
+	 * Retrieves the current state of the histogram.
+	 *
+	 * @param counts  Receives the number of observations per bucket,
+	 * with one more entry than there are bounds. The counts are not
+	 * cumulative.
+	 *
+	 * @param sum  Receives the sum of all observations.
+	 */
+	void Collect(std::vector<uint64_t>* counts, double* sum) const;
+
+private:
+	struct alignas(64) Shard {
+		std::unique_ptr<std::atomic<uint64_t>[]> counts;
+		std::atomic<double> sum{0};
+	};
+
+	std::vector<double> bounds;
+	Shard shards[detail::NUM_SHARDS];
+};
+
+} // namespace zeek::telemetry
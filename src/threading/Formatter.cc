@@ -4,6 +4,7 @@
 #include "Formatter.h"
 
 #include <errno.h>
+#include <stdarg.h>
 
 #include "MsgThread.h"
 #include "bro_inet_ntop.h"
@@ -22,6 +23,32 @@ Formatter::~Formatter()
 	{
 	}
 
+void Formatter::Warning(const char* format, ...) const
+	{
+	// Not using the thread's Fmt() here, as its buffer must not be
+	// touched from other threads.
+	std::string msg(128, '\0');
+	va_list al;
+	va_start(al, format);
+	int n = vsnprintf(&msg[0], msg.size(), format, al);
+	va_end(al);
+
+	if ( n >= int(msg.size()) )
+		{
+		msg.resize(n + 1);
+		va_start(al, format);
+		vsnprintf(&msg[0], msg.size(), format, al);
+		va_end(al);
+		}
+
+	msg.resize(n > 0 ? n : 0);
+
+	if ( warnings )
+		warnings->emplace_back(std::move(msg));
+	else
+		thread->Warning(msg.c_str());
+	}
+
 std::string Formatter::Render(const threading::Value::addr_t& addr)
 	{
 	if ( addr.family == IPv4 )
@@ -55,7 +82,7 @@ TransportProto Formatter::ParseProto(const std::string &proto) const
 	else if ( proto == "icmp" )
 		return TRANSPORT_ICMP;
 
-	thread->Warning(thread->Fmt("Tried to parse invalid/unknown protocol: %s", proto.c_str()));
+	Warning("Tried to parse invalid/unknown protocol: %s", proto.c_str());
 
 	return TRANSPORT_UNKNOWN;
 	}
@@ -72,7 +99,7 @@ threading::Value::addr_t Formatter::ParseAddr(const std::string &s) const
 
 		if ( inet_aton(s.c_str(), &(val.in.in4)) <= 0 )
 			{
-			thread->Warning(thread->Fmt("Bad address: %s", s.c_str()));
+			Warning("Bad address: %s", s.c_str());
 			memset(&val.in.in4.s_addr, 0, sizeof(val.in.in4.s_addr));
 			}
 		}
@@ -85,7 +112,7 @@ threading::Value::addr_t Formatter::ParseAddr(const std::string &s) const
 			clean_s = s.substr(1, s.length() - 2);
 		if ( inet_pton(AF_INET6, clean_s.c_str(), val.in.in6.s6_addr) <= 0 )
 			{
-			thread->Warning(thread->Fmt("Bad address: %s", clean_s.c_str()));
+			Warning("Bad address: %s", clean_s.c_str());
 			memset(val.in.in6.s6_addr, 0, sizeof(val.in.in6.s6_addr));
 			}
 		}
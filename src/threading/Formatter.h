@@ -3,6 +3,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "Type.h"
 #include "SerialTypes.h"
@@ -152,6 +153,17 @@ public:
 	 */
 	Value::addr_t ParseAddr(const std::string &addr) const;
 
+	/**
+	 * Makes the formatter collect its warnings in a vector instead of
+	 * reporting them via the thread. This allows helper threads to use
+	 * a formatter instance of their own, as they must not send messages
+	 * on the thread's behalf.
+	 *
+	 * @param buf The vector to append warnings to, or null to report
+	 * them via the thread again.
+	 */
+	void SetWarningBuffer(std::vector<std::string>* buf)	{ warnings = buf; }
+
 protected:
 	/**
 	 * Returns the thread associated with the formatter via the
@@ -159,8 +171,15 @@ protected:
 	 */
 	MsgThread* GetThread() const	{ return thread; }
 
+	/**
+	 * Reports a warning via the thread, or appends it to the buffer
+	 * set with SetWarningBuffer().
+	 */
+	void Warning(const char* format, ...) const __attribute__((format(printf, 2, 3)));
+
 private:
 	MsgThread* thread;
+	std::vector<std::string>* warnings = nullptr;
 };
 
 } // namespace zeek::threading
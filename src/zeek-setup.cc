@@ -60,6 +60,7 @@ extern "C" {
 #include "zeekygen/Manager.h"
 #include "iosource/Manager.h"
 #include "broker/Manager.h"
+#include "telemetry/Manager.h"
 
 #include "binpac_zeek.h"
 #include "module_util.h"
@@ -121,6 +122,7 @@ zeek::Broker::Manager*& broker_mgr = zeek::broker_mgr;
 zeek::Supervisor* zeek::supervisor_mgr = nullptr;
 zeek::detail::trigger::Manager* zeek::detail::trigger_mgr = nullptr;
 zeek::detail::trigger::Manager*& trigger_mgr = zeek::detail::trigger_mgr;
+zeek::telemetry::Manager* zeek::telemetry_mgr = nullptr;
 
 std::vector<std::string> zeek::detail::zeek_script_prefixes;
 std::vector<std::string>& zeek_script_prefixes = zeek::detail::zeek_script_prefixes;
@@ -336,7 +338,8 @@ static void terminate_bro()
 	delete zeekygen_mgr;
 	delete analyzer_mgr;
 	delete file_mgr;
-	// broker_mgr, timer_mgr, and supervisor are deleted via iosource_mgr
+	// broker_mgr, timer_mgr, telemetry_mgr, and supervisor are deleted via
+	// iosource_mgr
 	delete iosource_mgr;
 	delete event_registry;
 	delete log_mgr;
@@ -579,6 +582,7 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	dns_mgr->SetDir(".state");
 
 	iosource_mgr = new iosource::Manager();
+	telemetry_mgr = new telemetry::Manager();
 	event_registry = new EventRegistry();
 	analyzer_mgr = new analyzer::Manager();
 	log_mgr = new logging::Manager();
@@ -676,6 +680,7 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	plugin_mgr->InitPostScript();
 	zeekygen_mgr->InitPostScript();
 	broker_mgr->InitPostScript();
+	telemetry_mgr->InitPostScript();
 	timer_mgr->InitPostScript();
 	event_mgr.InitPostScript();
 